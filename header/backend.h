@@ -0,0 +1,112 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file backend.h
+ * \brief Operations a backend provides to the eigensolver
+ *
+ * The solver only sees blocks of vectors through opaque handles, stored in
+ * the memory of the backend (device buffers for OpenCL, host arrays for the
+ * CPU). A block holds \a count column vectors of \a length values, a vector
+ * is a column of a block and a scalar one of its values: the Hessenberg
+ * matrix and the norms stay in the memory of the backend between the
+ * operations producing and consuming them.
+ */
+
+#ifndef _BACKEND_H
+#define _BACKEND_H
+
+#include "define.h"
+
+/// \brief Stream of \a solverBackend::set_stream() waiting for all the others
+#define BACKEND_MAIN_STREAM -1
+
+/// \brief Column \a col of a block
+typedef struct backendVec{
+    void *block;
+    int  col;
+}backendVec;
+
+/// \brief Value at row \a row of column \a col of a block
+typedef struct backendScalar{
+    void *block;
+    int  col;
+    int  row;
+}backendScalar;
+
+/// \brief Function table of a backend, every operation takes \a state first
+typedef struct solverBackend{
+    /// Name of the backend, also the key of the SpMV tuning cache
+    const char        *name;
+    /// State of the backend passed to every operation
+    void              *state;
+    /// Number of rows of the matrix and of the vectors held by this rank
+    int               n;
+    /// First row held by this rank
+    int               rowStart;
+    /// Fingerprint of the sparsity pattern held by this rank, see \a matrix_fingerprint()
+    unsigned long long fingerprint;
+    /// Number of SpMV kernels
+    int               num_variants;
+    /// Names of the SpMV kernels
+    const char *const *variant_names;
+    /// Least bytes moved by one SpMV of the rows of this rank: the matrix, x and y once each
+    double            spmvBytes;
+    /// Floating point operations of one SpMV of the rows of this rank
+    double            spmvFlops;
+
+    /// Allocate \a count vectors of \a length values set to zero
+    void   *(*create_block)(void *state, int length, int count);
+    /// Allocate a block like \a create_block(), whose first columns may be kept in host memory
+    /// if the device is full. Its columns may only be the vectors of the operations and the
+    /// \a A of \a gemm() (may be NULL)
+    void   *(*create_basis)(void *state, int length, int count);
+    /// Free a block of \a create_block() or \a create_basis()
+    void    (*free_block)(void *state, void *block);
+    /// Copy host values into a vector
+    void    (*write_vector)(void *state, backendVec x, const real_t *values);
+    /// Copy a vector to the host
+    void    (*read_vector)(void *state, backendVec x, real_t *values);
+    /// Read a scalar on the host, waiting for the operations writing it
+    real_t  (*read_scalar)(void *state, backendScalar s);
+
+    /// y := A x, vectors of \a n values
+    void    (*spmv)(void *state, backendVec x, backendVec y);
+    /// r := ||x||, reduced over the ranks sharing the matrix
+    void    (*nrm2)(void *state, backendScalar r, backendVec x);
+    /// y := y + sign * alpha * x
+    void    (*axpy)(void *state, backendScalar alpha, real_t sign, backendVec x, backendVec y);
+    /// h := q.w then w := w - h * q, the dot product reduced over the ranks sharing the matrix
+    void    (*dot_axpy)(void *state, backendScalar h, backendVec q, backendVec w);
+    /// nrm := ||x|| then x := x / nrm
+    void    (*normalize)(void *state, backendScalar nrm, backendVec x);
+    /// C := A B, the first length(B) columns and length(C) rows of \a A are used
+    void    (*gemm)(void *state, void *A, void *B, void *C);
+    /// Orthonormalize the columns of a block of replicated vectors
+    void    (*orthonormalize)(void *state, void *block);
+
+    /// Split the vectors into \a count segments, rows [offsets[g], offsets[g + 1]) of a block-diagonal
+    /// matrix whose diagonal blocks are solved together, for the segmented operations below. A single rank
+    void    (*set_segments)(void *state, int count, const int *offsets);
+    /// dot_axpy() on each segment g, its h at row h.row + g * stride of column h.col
+    void    (*seg_dot_axpy)(void *state, backendScalar h, int stride, backendVec q, backendVec w);
+    /// normalize() on each segment g, its norm at row nrm.row + g * stride; a zero segment stays zero
+    void    (*seg_normalize)(void *state, backendScalar nrm, int stride, backendVec x);
+    /// C := A B on each segment g, B holding the reduced vectors of segment g in its rows
+    /// [g L, (g + 1) L) with L = length(B) / count, the first L columns of \a A are used
+    void    (*seg_gemm)(void *state, void *A, void *B, void *C);
+
+    /// Select a SpMV kernel, EXIT_FAILURE keeping the previous one if it does not suit the matrix
+    int     (*set_spmv_variant)(void *state, int variant);
+    /// Run the next operations on \a stream, concurrently with the other streams until
+    /// BACKEND_MAIN_STREAM is selected again and waits for them (may be NULL). Only
+    /// spmv, nrm2, axpy and the reads may leave the main stream, the fused kernels
+    /// share their scratch memory. A backend whose spmv has scratch memory as well
+    /// keeps every stream on the main one
+    void    (*set_stream)(void *state, int stream);
+    /// Wait for the pending operations, to time them
+    void    (*finish)(void *state);
+    /// Print the communication statistics since the last call, or of the run if \a total (may be NULL)
+    void    (*report)(void *state, const char *label, int total);
+    /// Release the state and the matrix
+    void    (*free)(void *state);
+}solverBackend;
+#endif
@@ -0,0 +1,55 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_backend.h
+ * \brief Backend running the solver on an OpenCL device with clSPARSE and the custom kernels
+ *
+ */
+
+#ifndef _CL_BACKEND_H
+#define _CL_BACKEND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#include "define.h"
+#include "backend.h"
+#include "solver.h"
+#include "executable_options.h"
+#include "matrix_reader.h"
+#include "cl_utils.h"
+#include "cl_kernels.h"
+#include "cl_spmv.h"
+#include "gram_schmidt.h"
+#include "dist_matrix.h"
+#include "spmv_tune.h"
+#include "stencil.h"
+
+/** \brief Select the device of this rank, upload its rows of \a mat and fill \a backend
+ *
+ * The rows of \a mat given by \a rowOffsets (blocks of the same size if NULL)
+ * are distributed over \a ctx->solver_comm, then \a mat is released with
+ * \a free_Matrix() unless \a ctx->keepMatrix. Collective over \a ctx->solver_comm.
+ */
+void cl_backend_init(
+    solverBackend       *backend,
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *rowOffsets,
+    const solverContext *ctx);
+
+/** \brief Hold the session kept by \a cl_backend_init() between the solves
+ *
+ * The first solve selects the device of \a solverContext::devices, creates
+ * the context and the queues, compiles the kernels and sets clSPARSE up. The
+ * later ones, of any holder, only upload their matrix, and reuse the device
+ * blocks of the previous solve of the same sizes; the ones they do not reuse
+ * are released once the basis is planned. The kernels and clSPARSE being set
+ * up once per process, the holders share a single session.
+ */
+void cl_backend_acquire();
+
+/** \brief Release the session of \a cl_backend_acquire(), closed with its last holder
+ */
+void cl_backend_release();
+#endif
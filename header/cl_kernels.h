@@ -0,0 +1,258 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_kernels.h
+ * \brief Custom OpenCL kernels for the operations clSPARSE does not provide
+ *
+ */
+
+#ifndef _CL_KERNELS_H
+#define _CL_KERNELS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#include "clSPARSE.h"
+#include "clSPARSE-error.h"
+#include "define.h"
+#include "timing.h"
+
+/// \brief Work-items per row of \a cl_kernel_spmv_csr_vector(), VECTOR_LANES in the kernel source
+#define CSR_VECTOR_LANES 32
+
+/** \brief Compile the custom kernels for \a device, called by \a cl_init()
+ */
+void cl_kernels_init(
+    cl_context   context,
+    cl_device_id device);
+
+/** \brief Release the kernels created by \a cl_kernels_init()
+ */
+void cl_kernels_free();
+
+/** \brief Work-group size of the custom kernels on the device of \a cl_kernels_init()
+ */
+size_t cl_kernels_work_group_size();
+
+/** \brief Account the execution time of the kernels launched since the last call to their phase
+ *
+ * Waits for them. Nothing is kept unless \a timing_enabled().
+ */
+void cl_kernels_collect_timings();
+
+/** \brief Keep the event of the last call to clSPARSE on \a control, enqueued on \a queue, as the kernel \a name
+ *
+ * Called after the calls to clSPARSE, whose kernels have no event otherwise.
+ * Nothing is kept unless \a timing_enabled().
+ */
+void cl_kernels_clsparse_event(
+    cl_command_queue queue,
+    clsparseControl  control,
+    const char       *name);
+
+/** \brief Sum the reductions of \a cl_kernel_dot_axpy() and \a cl_kernel_normalize() across \a comm
+ *
+ * Used when the vectors are distributed by rows, MPI_COMM_SELF by default.
+ */
+void cl_kernels_set_comm(
+    MPI_Comm comm);
+
+/** \brief dst[i] := src[idx[i]] for the \a dst->num_values entries of \a dst
+ */
+cl_int cl_kernel_gather(
+    cl_command_queue    queue,
+    cldenseVector       *dst,
+    cl_mem              idx,
+    const cldenseVector *src);
+
+/** \brief dst[idx[i]] += src[i] for the \a src->num_values entries of \a src
+ *
+ * The indices must be distinct.
+ */
+cl_int cl_kernel_scatter_add(
+    cl_command_queue    queue,
+    cldenseVector       *dst,
+    cl_mem              idx,
+    const cldenseVector *src);
+
+/** \brief y := y + sign * alpha * x with \a alpha read on the device
+ *
+ * A \a sign of -1 gives the axpy with a negated device scalar without any
+ * scalar kernel to negate it first.
+ */
+cl_int cl_kernel_axpy(
+    cl_command_queue     queue,
+    cldenseVector        *y,
+    const clsparseScalar *alpha,
+    real_t               sign,
+    const cldenseVector  *x);
+
+/** \brief Orthogonalization step h := q.w then w := w - h * q
+ *
+ * Two launches: the per work-group partial dot products, then a kernel
+ * reducing them, storing \a h and updating \a w.
+ */
+cl_int cl_kernel_dot_axpy(
+    cl_command_queue    queue,
+    clsparseScalar      *h,
+    const cldenseVector *q,
+    cldenseVector       *w);
+
+/** \brief Normalization in place nrm := ||x|| then x := x / nrm
+ *
+ * Two launches, same scheme as \a cl_kernel_dot_axpy(). The norm is kept in
+ * \a nrm, which may point into the Hessenberg matrix.
+ */
+cl_int cl_kernel_normalize(
+    cl_command_queue queue,
+    clsparseScalar   *nrm,
+    cldenseVector    *x);
+
+/** \brief Gram matrix G = V^T V of a column-major block of vectors, in one launch
+ *
+ * \a G must hold \a V->num_cols x \a V->num_cols values, it is written
+ * row-major and fully (both triangles).
+ */
+cl_int cl_kernel_gram(
+    cl_command_queue queue,
+    cldenseMatrix    *V,
+    cl_mem           G);
+
+/** \brief In place right triangular solve V := V R^-1, in one launch
+ *
+ * \a R is the row-major upper triangular \a V->num_cols x \a V->num_cols factor.
+ */
+cl_int cl_kernel_trsm(
+    cl_command_queue queue,
+    cldenseMatrix    *V,
+    cl_mem           R);
+
+/** \brief C := A B[firstRow : firstRow + inner, :] for column-major blocks
+ *
+ * The first \a inner columns and \a C->num_rows rows of \a A are used.
+ */
+cl_int cl_kernel_gemm(
+    cl_command_queue    queue,
+    const cldenseMatrix *A,
+    const cldenseMatrix *B,
+    cl_uint             firstRow,
+    cl_uint             inner,
+    cldenseMatrix       *C);
+
+/** \brief C := C + a B[row, :], the first \a C->num_rows values of \a a are used
+ */
+cl_int cl_kernel_ger_row(
+    cl_command_queue    queue,
+    const cldenseVector *a,
+    const cldenseMatrix *B,
+    cl_uint             row,
+    cldenseMatrix       *C);
+
+/** \brief \a cl_kernel_dot_axpy() on each segment g of rows [offsets[g], offsets[g + 1]), its h at \a h + g * \a stride
+ *
+ * One launch, one work-group per segment, reduced on this rank only.
+ */
+cl_int cl_kernel_seg_dot_axpy(
+    cl_command_queue    queue,
+    cl_mem              offsets,
+    cl_uint             count,
+    clsparseScalar      *h,
+    cl_uint             stride,
+    const cldenseVector *q,
+    cldenseVector       *w);
+
+/** \brief \a cl_kernel_normalize() on each segment, in one launch like \a cl_kernel_seg_dot_axpy()
+ *
+ * A zero segment is left as it is, with a zero norm.
+ */
+cl_int cl_kernel_seg_normalize(
+    cl_command_queue queue,
+    cl_mem           offsets,
+    cl_uint          count,
+    clsparseScalar   *nrm,
+    cl_uint          stride,
+    cldenseVector    *x);
+
+/** \brief \a cl_kernel_gemm() with the rows of B of segment s = segment[r] for row r of C
+ *
+ * Row r of C is A[r, :] B[s * segLength + firstRow : s * segLength + firstRow + inner, :].
+ */
+cl_int cl_kernel_seg_gemm(
+    cl_command_queue    queue,
+    cl_mem              segment,
+    const cldenseMatrix *A,
+    const cldenseMatrix *B,
+    cl_uint             firstRow,
+    cl_uint             inner,
+    cl_uint             segLength,
+    cldenseMatrix       *C);
+
+/** \brief \a cl_kernel_ger_row() with the row of B of segment segment[r] for row r of C, as \a cl_kernel_seg_gemm()
+ */
+cl_int cl_kernel_seg_ger_row(
+    cl_command_queue    queue,
+    cl_mem              segment,
+    const cldenseVector *a,
+    const cldenseMatrix *B,
+    cl_uint             row,
+    cl_uint             segLength,
+    cldenseMatrix       *C);
+
+/** \brief y := A x with one work-item per row
+ */
+cl_int cl_kernel_spmv_csr_scalar(
+    cl_command_queue        queue,
+    const clsparseCsrMatrix *A,
+    const cldenseVector     *x,
+    cldenseVector           *y);
+
+/** \brief y := A x with \a CSR_VECTOR_LANES work-items per row
+ *
+ * \return CL_INVALID_WORK_GROUP_SIZE if the device work-groups are smaller than that
+ */
+cl_int cl_kernel_spmv_csr_vector(
+    cl_command_queue        queue,
+    const clsparseCsrMatrix *A,
+    const cldenseVector     *x,
+    cldenseVector           *y);
+
+/** \brief y := A x splitting the merge of the row ends and the non-zeros evenly, \a items per work-item
+ *
+ * \a carryRow and \a carryVal hold \a nThreads values, with \a nThreads
+ * large enough to cover the \a num_rows + \a num_nonzeros items.
+ */
+cl_int cl_kernel_spmv_merge_path(
+    cl_command_queue        queue,
+    const clsparseCsrMatrix *A,
+    const cldenseVector     *x,
+    cldenseVector           *y,
+    cl_uint                 items,
+    cl_uint                 nThreads,
+    cl_mem                  carryRow,
+    cl_mem                  carryVal);
+
+/** \brief y := A x for a sliced ELLPACK matrix of slices of \a C rows
+ *
+ * Slice s holds its entries column-major from offsets[s] to offsets[s+1],
+ * padded with zeros to its longest row.
+ */
+cl_int cl_kernel_spmv_sell(
+    cl_command_queue    queue,
+    cl_uint             nRow,
+    cl_uint             C,
+    cl_mem              offsets,
+    cl_mem              cols,
+    cl_mem              vals,
+    const cldenseVector *x,
+    cldenseVector       *y);
+
+/** \brief y := A x for the matrix-free operator \a op, see \a stencil.h
+ *
+ * One work-item per point of the grid, the work-groups along its lines.
+ */
+cl_int cl_kernel_spmv_stencil(
+    cl_command_queue      queue,
+    const stencilOperator *op,
+    const cldenseVector   *x,
+    cldenseVector         *y);
+#endif
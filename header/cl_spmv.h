@@ -0,0 +1,98 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_spmv.h
+ * \brief Interchangeable sparse matrix-vector product kernels for a CSR matrix on device
+ *
+ * No kernel is the fastest for every sparsity pattern: the adaptive kernel of
+ * clSPARSE, one work-item per row, a group of work-items per row, an even
+ * split of the merge of the row ends with the non-zeros, or a sliced ELLPACK
+ * copy of the matrix. \a spmv_autotune() picks one per matrix.
+ */
+
+#ifndef _CL_SPMV_H
+#define _CL_SPMV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "clSPARSE.h"
+#include "clSPARSE-error.h"
+#include "define.h"
+#include "cl_utils.h"
+#include "cl_kernels.h"
+
+/// \brief Rows per slice of the sliced ELLPACK format
+#define SELL_SLICE 32
+/// \brief Merge items (rows and non-zeros) per work-item of the merge-path product
+#define MERGE_ITEMS 64
+
+/// \brief Sparse matrix-vector product kernels
+typedef enum clSpmvVariant_t{
+    /// clSPARSE csrmv, adaptive
+    CL_SPMV_CLSPARSE,
+    /// One work-item per row
+    CL_SPMV_CSR_SCALAR,
+    /// CSR_VECTOR_LANES work-items per row
+    CL_SPMV_CSR_VECTOR,
+    /// Even split of the merge of the row ends with the non-zeros
+    CL_SPMV_MERGE_PATH,
+    /// Sliced ELLPACK copy of the matrix
+    CL_SPMV_SELL,
+    CL_SPMV_NUM_VARIANTS
+}clSpmvVariant_t;
+
+/// \brief Names of the variants, indexed by \a clSpmvVariant_t
+extern const char *const cl_spmv_variant_names[CL_SPMV_NUM_VARIANTS];
+
+/// \brief CSR matrix on device and the data of its selected product kernel
+typedef struct clSpmvMatrix{
+    /// Matrix, kept for every variant
+    clsparseCsrMatrix *csr;
+    /// Selected kernel
+    clSpmvVariant_t   variant;
+    /// Merge-path: number of work-items
+    cl_uint           mergeThreads;
+    /// Merge-path: last row of each work-item
+    cl_mem            carryRow;
+    /// Merge-path: partial sum of the last row of each work-item
+    cl_mem            carryVal;
+    /// Sliced ELLPACK: first entry of each slice
+    cl_mem            sellOffsets;
+    /// Sliced ELLPACK: column of each entry
+    cl_mem            sellCols;
+    /// Sliced ELLPACK: value of each entry
+    cl_mem            sellVals;
+}clSpmvMatrix;
+
+/** \brief Wrap \a csr with the clSPARSE kernel selected
+ */
+void cl_spmv_init(
+    clSpmvMatrix      *m,
+    clsparseCsrMatrix *csr);
+
+/** \brief Select the product kernel of \a m and build the data it needs
+ *
+ * \return EXIT_FAILURE, keeping the previous kernel, if the kernel does not
+ *         suit the matrix or the device
+ */
+int cl_spmv_set_variant(
+    clSpmvMatrix     *m,
+    clSpmvVariant_t  variant,
+    cl_context       context,
+    cl_command_queue queue);
+
+/** \brief y := A x with the selected kernel
+ */
+void cl_spmv(
+    clSpmvMatrix        *m,
+    const cldenseVector *x,
+    cldenseVector       *y,
+    cl_command_queue    queue,
+    clsparseControl     control);
+
+/** \brief Free the data of the selected kernel, not the wrapped matrix
+ */
+void cl_spmv_free(
+    clSpmvMatrix *m);
+#endif
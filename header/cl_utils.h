@@ -10,13 +10,67 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mpi.h>
 
 #include "clSPARSE.h"
 #include "clSPARSE-error.h"
 #include "define.h"
+#include "cl_kernels.h"
+#include "spmv_tune.h"
+
+/// \brief CSR matrix split between the owned columns and the ghost columns
+typedef struct splitCsrMatrix{
+    /// Entries in the owned columns, every row
+    clsparseCsrMatrix interior;
+    /// Entries in the ghost columns, boundary rows only, columns numbered from 0
+    clsparseCsrMatrix boundary;
+    /// Local index of each row of \a boundary
+    cl_mem            boundaryRows;
+    /// Number of rows of \a boundary
+    int               nBoundary;
+}splitCsrMatrix;
+
+/// \brief Bytes of the pinned staging buffers of the matrix upload
+#ifndef UPLOAD_CHUNK
+#define UPLOAD_CHUNK (4 << 20)
+#endif
+
+/// \brief Number of command queues of a \a clQueuePool
+#ifndef QUEUE_POOL_SIZE
+#define QUEUE_POOL_SIZE 4
+#endif
+
+/// \brief In-order command queues running independent work next to a main queue
+typedef struct clQueuePool{
+    /// Number of queues
+    int                  count;
+    /// Queues
+    cl_command_queue     *queues;
+    /// clSPARSE control of each queue
+    clsparseCreateResult *controls;
+}clQueuePool;
+
+/// \brief OpenCL device found by \a cl_list_devices()
+typedef struct clDeviceInfo{
+    /// Platform of the device
+    cl_platform_id platform;
+    /// Device
+    cl_device_id   device;
+    /// Index in the list
+    int            index;
+    /// CL_DEVICE_TYPE of the device
+    cl_device_type type;
+    /// Global memory, in bytes
+    cl_ulong       memory;
+    /// Number of compute units
+    cl_uint        computeUnits;
+    /// Name of the device
+    char           name[128];
+}clDeviceInfo;
 
-/// \brief Vector with one value constant to one
-extern cldenseVector  one_V;
 /// \brief Scalar with constant value to one
 extern clsparseScalar  one_S;
 /// \brief Scalar with constant value to zero
@@ -24,14 +78,37 @@ extern clsparseScalar  zero_S;
 /// \brief Scalar with constant value to minus one
 extern clsparseScalar minusOne_S;
 
-/** \brief Initialize the OpenCL structures to use with the first available GPU
+/** \brief Find the devices of every platform
+ *
+ * The GPUs and accelerators come first, then the CPUs, each by decreasing
+ * memory then compute units. \a list is allocated.
+ *
+ * \return the number of devices
+ */
+int cl_list_devices(
+    clDeviceInfo **list);
+
+/** \brief Print the devices found by \a cl_list_devices() with their index
+ */
+void cl_print_devices(
+    const clDeviceInfo *list,
+    int                count);
+
+/** \brief Initialize the OpenCL structures on the device of this rank
+ *
+ * The ranks of \a node_comm are assigned round robin to the GPUs and
+ * accelerators (to every device if there are none), or to the indices of
+ * \a cl_list_devices() given in the comma-separated \a selection if not
+ * NULL. The selected device is (*devices)[0].
  */
 void cl_init(
 	cl_platform_id       **platforms,
 	cl_device_id         **devices,
 	cl_context           *context,
 	cl_command_queue     *queue,
-    clsparseCreateResult *createResult);
+    clsparseCreateResult *createResult,
+    MPI_Comm             node_comm,
+    const char           *selection);
 
 /** \brief Free the OpenCL structures created with \a cl_init()
  */
@@ -51,11 +128,92 @@ void cl_init_matrix(
     cl_command_queue    queue,
     clsparseControl     control);
 
+/** \brief Initialize the interior and boundary parts of a CSR matrix from a CSR matrix on host
+ *
+ * The columns below \a nOwned are owned and go in the interior part. The
+ * rows referencing other columns also get a boundary part holding only
+ * those entries, so the interior product can run before the ghost values
+ * are known.
+ *
+ * The parts are sent by chunks of UPLOAD_CHUNK bytes through pinned staging
+ * buffers while the next rows are split, or written in place on a device
+ * sharing the host memory.
+ */
+void cl_init_matrix_split(
+    csrMatrix*          host_mat,
+    int                 nOwned,
+    splitCsrMatrix*     d_mat,
+    cl_context          context,
+    cl_command_queue    queue,
+    clsparseControl     control);
+
+/** \brief Free a matrix created by \a cl_init_matrix_split()
+ */
+void cl_free_matrix_split(
+        splitCsrMatrix*  d_mat);
+
 /** \brief Free the clsparse CSR Matrix
  */
 void cl_free_matrix(
         clsparseCsrMatrix*  d_mat);
 
+/** \brief Allocate \a count device vectors of \a length values as the columns of one block
+ *
+ * The vectors are sub-buffers of \a block, whose leading dimension is padded
+ * so every column starts on an address aligned for \a device.
+ */
+cl_int cl_init_vector_block(
+    cl_context    context,
+    cl_device_id  device,
+    unsigned      length,
+    unsigned      count,
+    cldenseMatrix *block,
+    cldenseVector *vectors);
+
+/** \brief Free a block allocated by \a cl_init_vector_block()
+ */
+void cl_free_vector_block(
+    cldenseMatrix *block,
+    cldenseVector *vectors);
+
+/** \brief Build \a source for \a device, reusing the binary of a previous run if possible
+ *
+ * The binaries are kept in \a SIMULTITE_KERNEL_CACHE if set, else in
+ * ~/.cache/simultite, one file per device, driver version, build options and
+ * source. A binary the driver rejects is rebuilt from source and replaced.
+ * Exits on build errors, printing the log.
+ */
+cl_program cl_build_program(
+    cl_context       context,
+    cl_device_id     device,
+    const char       *source,
+    const char       *options);
+
+/** \brief Create \a count queues on \a device, each with its clSPARSE control
+ */
+void cl_init_queue_pool(
+    cl_context       context,
+    cl_device_id     device,
+    int              count,
+    clQueuePool      *pool);
+
+/** \brief Make the queues of \a pool wait for the commands enqueued so far on \a queue
+ */
+void cl_queue_pool_fork(
+    clQueuePool      *pool,
+    cl_command_queue queue);
+
+/** \brief Make \a queue wait for the commands enqueued so far on the queues of \a pool
+ */
+void cl_queue_pool_join(
+    clQueuePool      *pool,
+    cl_command_queue queue);
+
+/** \brief Release the queues of \a pool
+ */
+void cl_free_queue_pool(
+    clQueuePool      *pool);
+
 /** \brief Print the clsparseCsrMatrix
  */
 void cl_print_matrix(
@@ -0,0 +1,29 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cpu_backend.h
+ * \brief Backend running the solver on the host with the OpenMP kernels, without OpenCL
+ *
+ */
+
+#ifndef _CPU_BACKEND_H
+#define _CPU_BACKEND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "define.h"
+#include "backend.h"
+#include "cpu_kernels.h"
+#include "spmv_tune.h"
+#include "stencil.h"
+
+/** \brief Fill \a backend with the host kernels for the whole matrix \a mat
+ *
+ * \a mat is only read and must outlive the backend, the distributed mode is
+ * not supported. A matrix-free \a mat has the single kernel "stencil".
+ */
+void cpu_backend_init(
+    solverBackend   *backend,
+    const csrMatrix *mat);
+#endif
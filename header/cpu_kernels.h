@@ -0,0 +1,171 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cpu_kernels.h
+ * \brief Host kernels of the CPU backend, parallelized with OpenMP
+ *
+ * The vectors are plain arrays of \a real_t. The reductions are accumulated
+ * in double whatever the precision of the solver.
+ */
+
+#ifndef _CPU_KERNELS_H
+#define _CPU_KERNELS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "define.h"
+#include "dense_utils.h"
+
+/// \brief Rows per slice of \a cpuSellMatrix, one vector register of doubles on AVX-512
+#define CPU_SELL_SLICE 8
+
+/// \brief Sliced ELLPACK copy of a CSR matrix, see \a cl_kernel_spmv_sell()
+typedef struct cpuSellMatrix{
+    int    nRow;
+    int    nSlices;
+    /// First entry of each slice (\a nSlices + 1 values)
+    int    *offsets;
+    int    *cols;
+    real_t *vals;
+}cpuSellMatrix;
+
+/** \brief y := A x, rows scheduled dynamically and the entries of a row vectorized
+ */
+void cpu_spmv(
+    const csrMatrix *A,
+    const real_t    *x,
+    real_t          *y);
+
+/** \brief y := A x, rows split statically and summed sequentially
+ */
+void cpu_spmv_scalar(
+    const csrMatrix *A,
+    const real_t    *x,
+    real_t          *y);
+
+/** \brief y := A x, the merge of the row ends and the non-zeros split evenly between the threads
+ */
+void cpu_spmv_merge(
+    const csrMatrix *A,
+    const real_t    *x,
+    real_t          *y);
+
+/** \brief Build the sliced ELLPACK copy of \a A
+ *
+ * \return EXIT_FAILURE if the padding exceeds SELL_MAX_PADDING times the non-zeros
+ */
+int cpu_sell_init(
+    const csrMatrix *A,
+    cpuSellMatrix   *S);
+
+/** \brief Free a matrix built by \a cpu_sell_init()
+ */
+void cpu_sell_free(
+    cpuSellMatrix *S);
+
+/** \brief y := S x
+ */
+void cpu_spmv_sell(
+    const cpuSellMatrix *S,
+    const real_t        *x,
+    real_t              *y);
+
+/** \brief y := A x for the matrix-free operator \a op, see \a stencil.h
+ */
+void cpu_spmv_stencil(
+    const stencilOperator *op,
+    const real_t          *x,
+    real_t                *y);
+
+/** \brief C := A B for column-major matrices, A is \a m x \a k and B is \a k x \a nc
+ */
+void cpu_gemm(
+    int          m,
+    int          k,
+    int          nc,
+    const real_t *A,
+    int          lda,
+    const real_t *B,
+    int          ldb,
+    real_t       *C,
+    int          ldc);
+
+/** \brief C := A B on each segment g of rows [offsets[g], offsets[g + 1]), with rows [g k, (g + 1) k) of B
+ *
+ * The segments are shared between the threads, each one being summed by one.
+ */
+void cpu_seg_gemm(
+    int          count,
+    const int    *offsets,
+    int          k,
+    int          nc,
+    const real_t *A,
+    int          lda,
+    const real_t *B,
+    int          ldb,
+    real_t       *C,
+    int          ldc);
+
+/** \brief h[g stride] := q.w then w := w - h[g stride] q on each segment g of rows [offsets[g], offsets[g + 1])
+ */
+void cpu_seg_dot_axpy(
+    int          count,
+    const int    *offsets,
+    real_t       *h,
+    int          stride,
+    const real_t *q,
+    real_t       *w);
+
+/** \brief nrm[g stride] := ||x|| then x := x / nrm[g stride] on each segment g, a zero segment is left as it is
+ */
+void cpu_seg_normalize(
+    int          count,
+    const int    *offsets,
+    real_t       *nrm,
+    int          stride,
+    real_t       *x);
+
+/** \brief Dot product of \a x and \a y
+ */
+double cpu_dot(
+    int          n,
+    const real_t *x,
+    const real_t *y);
+
+/** \brief 2-norm of \a x
+ */
+double cpu_nrm2(
+    int          n,
+    const real_t *x);
+
+/** \brief y := y + alpha * x
+ */
+void cpu_axpy(
+    int          n,
+    real_t       alpha,
+    const real_t *x,
+    real_t       *y);
+
+/** \brief x := alpha * x
+ */
+void cpu_scale(
+    int          n,
+    real_t       alpha,
+    real_t       *x);
+
+/** \brief Orthonormalize the columns of the column-major \a m x \a n block \a V
+ *
+ * CholQR2 like \a gram_schmidt(), falling back to TSQR when the block is too
+ * ill-conditioned for the Cholesky factorization of its Gram matrix.
+ */
+void cpu_orthonormalize(
+    real_t *V,
+    int    m,
+    int    n,
+    int    ld);
+#endif
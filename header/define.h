@@ -3,6 +3,9 @@
  * \file define.h
  * \brief Defines the constant values used by the program and whether to use floats or doubles.
  *
+ * The solver and its backends are compiled once per precision, \a real_t
+ * being double in the copy built with DOUBLE_PRECISION, see \a precision.h.
+ * The rest of the program is compiled once and must not use \a real_t.
  */
 
 #ifndef _DEFINE_H_
@@ -14,25 +17,94 @@
 #ifndef MAX_TOL
 #define MAX_TOL 1e-8
 #endif
+#ifndef ENSEMBLE_PERIOD
+#define ENSEMBLE_PERIOD 10
+#endif
+#ifndef ENSEMBLE_LAG_RATIO
+#define ENSEMBLE_LAG_RATIO 100.0
+#endif
+#ifndef SPMV_TUNE_REPS
+#define SPMV_TUNE_REPS 10
+#endif
+#ifndef SPMV_TUNE_MIN_ROWS
+#define SPMV_TUNE_MIN_ROWS 16384
+#endif
+#ifndef STREAM_LENGTH
+#define STREAM_LENGTH (1 << 24)
+#endif
+#ifndef STREAM_REPS
+#define STREAM_REPS 10
+#endif
+#ifndef SELL_MAX_PADDING
+#define SELL_MAX_PADDING 3
+#endif
+#ifndef REFINE_KRYLOV
+#define REFINE_KRYLOV 8
+#endif
+#ifndef PRECISION_STALL_PERIODS
+#define PRECISION_STALL_PERIODS 5
+#endif
+#ifndef PRECISION_STALL_ROUNDINGS
+#define PRECISION_STALL_ROUNDINGS 100
+#endif
+#ifndef BATCH_PACK_ROWS
+#define BATCH_PACK_ROWS (1 << 20)
+#endif
+#ifndef WARM_START_TOL
+#define WARM_START_TOL 1e-3
+#endif
 
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 
+#include <float.h>
+
 #ifdef DOUBLE_PRECISION
 typedef double real_t;
+#define REAL_EPSILON DBL_EPSILON
+#define MPI_REAL_T MPI_DOUBLE
 #else
 typedef float real_t;
+#define REAL_EPSILON FLT_EPSILON
+#define MPI_REAL_T MPI_FLOAT
 #endif
 
 #define SEED 1
 
+/// \brief Constant coefficient stencil on a structured grid, applied without storing its matrix (see \a stencil.h)
+typedef struct stencilOperator{
+    /// Points along x, y and z, row i being the point (i % nx, (i / nx) % ny, i / (nx ny))
+    int    nx;
+    int    ny;
+    int    nz;
+    /// Coefficient of the point itself
+    double center;
+    /// Coefficient of both neighbours along x, y and z
+    double coeffs[3];
+}stencilOperator;
+
+/// \brief Sparse matrix in the CSR format, with its values in either or both precisions
 typedef struct csrMatrix{
     int*    rows;
     int*    cols;
-    real_t* vals;
+    /// Values in single precision, NULL unless requested from the reader
+    float*  svals;
+    /// Values in double precision, NULL unless requested from the reader
+    double* dvals;
     int     nNz;
     int     nRow;
     int     nCol;
+    /// Operator applied instead of the entries, which are all NULL, if not NULL
+    const stencilOperator* stencil;
 }csrMatrix;
 
+/// \brief Values of a \a csrMatrix in the precision of \a real_t, NULL for a pattern
+#ifdef DOUBLE_PRECISION
+#define CSR_VALS(mat) ((mat)->dvals)
+#else
+#define CSR_VALS(mat) ((mat)->svals)
+#endif
+
+#include "precision.h"
+
 
 #endif
@@ -0,0 +1,64 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file dense_utils.h
+ * \brief Small dense linear algebra on host used by the block orthonormalization and the refinement
+ *
+ * All the matrices are stored in double precision whatever the precision of
+ * the solver, they are at most \a num x \a kryl so the cost is negligible.
+ */
+
+#ifndef _DENSE_UTILS_H
+#define _DENSE_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/** \brief Cholesky factorization G = R^T R of a symmetric positive definite matrix
+ *
+ * \a G is a row-major \a n x \a n matrix, only its upper triangle is read.
+ * \a R receives the row-major upper triangular factor (lower part set to zero).
+ *
+ * \return EXIT_FAILURE if a pivot is not strictly positive (rank deficient block)
+ */
+int dense_cholesky(
+    const double *G,
+    double       *R,
+    int          n);
+
+/** \brief Estimate of the 2-norm condition number of a triangular factor
+ *
+ * Ratio of the largest to the smallest diagonal entry of \a R, which is a
+ * lower bound of the condition number of the block that produced it.
+ */
+double dense_triangular_cond(
+    const double *R,
+    int          n);
+
+/** \brief Tall and Skinny QR: overwrite \a V with an orthonormal basis of its columns
+ *
+ * \a V is a column-major \a m x \a n matrix of leading dimension \a ld with
+ * m >= n. The rows are split into blocks of at least \a n rows, each block is
+ * factorized with Householder reflections and the stacked R factors are
+ * factorized again, so the result is orthonormal to working precision even
+ * for numerically rank deficient blocks.
+ */
+void dense_tsqr(
+    double *V,
+    int    m,
+    int    n,
+    int    ld);
+
+/** \brief Solve the square system A x = b in place with Gaussian elimination and partial pivoting
+ *
+ * \a A is a row-major \a n x \a n matrix, overwritten by its factors, \a b
+ * is overwritten by the solution. A zero pivot is replaced by \a tiny, so a
+ * singular shifted matrix still gives a step of inverse iteration.
+ */
+void dense_lu_solve(
+    double *A,
+    double *b,
+    int    n,
+    double tiny);
+#endif
@@ -0,0 +1,184 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file dist_matrix.h
+ * \brief Row-partitioned CSR matrix shared by the ranks of a communicator
+ *
+ * Each rank owns a contiguous block of rows and the matching entries of every
+ * vector. The columns of the local rows are renumbered: the owned columns come
+ * first, followed by the ghost columns owned by other ranks, sorted by global
+ * index. A sparse matrix-vector product exchanges the ghost values with
+ * point-to-point messages to the neighbouring ranks only, while the product of
+ * the owned columns runs on the device. The entries of the ghost columns are
+ * added once the ghost values arrived.
+ *
+ * With a communicator of one rank it is a plain \a clsparseCsrMatrix and no
+ * communication happens, which is how the ensemble mode runs. A matrix-free
+ * operator (see \a stencil.h) needs a communicator of one rank, nothing is
+ * uploaded and its kernel is the product.
+ */
+
+#ifndef _DIST_MATRIX_H
+#define _DIST_MATRIX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "clSPARSE.h"
+#include "clSPARSE-error.h"
+#include "define.h"
+#include "cl_utils.h"
+#include "cl_kernels.h"
+#include "cl_spmv.h"
+
+/// \brief Row-partitioned matrix and its halo exchange plan
+typedef struct distCsrMatrix{
+    /// Ranks sharing the matrix
+    MPI_Comm          comm;
+    /// Number of ranks in \a comm
+    int               num_ranks;
+    /// Rank in \a comm
+    int               rank;
+    /// Matrix-free operator applied instead of the local rows, the exchange plan is empty
+    const stencilOperator *stencil;
+    /// Number of rows of the whole matrix
+    int               nGlobal;
+    /// First global row of each rank (\a num_ranks + 1 values)
+    int               *rowOffsets;
+    /// First global row owned by this rank
+    int               rowStart;
+    /// Number of rows owned by this rank
+    int               nLocal;
+    /// Number of remote columns referenced by the local rows
+    int               nGhost;
+    /// Global index of each ghost column
+    int               *ghostCols;
+    /// Number of local entries in a ghost column
+    int               nRemoteNz;
+    /// Local rows split between the owned and the ghost columns
+    splitCsrMatrix    local;
+    /// Product kernel of the interior part of \a local
+    clSpmvMatrix      interiorSpmv;
+    /// Number of values sent to each rank
+    int               *sendCounts;
+    /// Offset of the values sent to each rank in \a hostSend
+    int               *sendDispls;
+    /// Number of ghost values received from each rank
+    int               *recvCounts;
+    /// Offset of the values received from each rank in \a hostRecv
+    int               *recvDispls;
+    /// Total number of values sent
+    int               nSend;
+    /// Local indices of the values to send, on device
+    cl_mem            sendIdx;
+    /// Values to send gathered on device
+    cldenseVector     sendBuf;
+    /// Host staging of the sent values
+    real_t            *hostSend;
+    /// Host staging of the received ghost values
+    real_t            *hostRecv;
+    /// Received ghost values on device, input of the boundary product
+    cldenseVector     ghostBuf;
+    /// Result of the boundary product, added to the boundary rows
+    cldenseVector     yBoundary;
+    /// Requests of the pending sends and receives
+    MPI_Request       *requests;
+    /// Time spent exchanging ghost values since the last report, in seconds
+    double            exchangeTime;
+    /// Part of \a exchangeTime not hidden behind the interior product
+    double            exposedTime;
+    /// Number of exchanges since the last report
+    int               nExchanges;
+    /// \a exchangeTime accumulated over the whole run
+    double            totalExchangeTime;
+    /// \a exposedTime accumulated over the whole run
+    double            totalExposedTime;
+}distCsrMatrix;
+
+/** \brief Split \a n rows in contiguous blocks, return the first row of \a rank
+ */
+int dist_row_start(
+    int n,
+    int num_ranks,
+    int rank);
+
+/** \brief Build the local part of the matrix and the exchange plan, then upload it
+ *
+ * \a host_mat is the whole matrix, each rank keeps its block of rows only.
+ * \a rowOffsets gives the first row of each rank (see \a partition_matrix()),
+ * blocks of the same size are used if it is NULL. Collective over \a comm.
+ */
+void dist_init_matrix(
+    csrMatrix*        host_mat,
+    distCsrMatrix*    dm,
+    MPI_Comm          comm,
+    const int*        rowOffsets,
+    cl_context        context,
+    cl_command_queue  queue,
+    clsparseControl   control);
+
+/** \brief Print the rows, halo sizes and bytes exchanged per product of each rank
+ *
+ * Collective over the communicator of \a dm, printed by its rank 0.
+ */
+void dist_print_halo(
+    distCsrMatrix*    dm);
+
+/** \brief Print the exchange time and the fraction hidden behind computation since the last call
+ *
+ * The worst rank is reported. The totals of the run are printed instead if
+ * \a total is set. Collective over the communicator of \a dm, printed by its rank 0.
+ */
+void dist_print_overlap(
+    distCsrMatrix*    dm,
+    const char*       label,
+    int               total);
+
+/** \brief Select the kernel of the interior product, see \a cl_spmv_set_variant()
+ */
+int dist_set_spmv_variant(
+    distCsrMatrix*    dm,
+    clSpmvVariant_t   variant,
+    cl_context        context,
+    cl_command_queue  queue);
+
+/** \brief Forget the exchange times measured so far, the totals of the run included
+ */
+void dist_reset_overlap(
+    distCsrMatrix*    dm);
+
+/** \brief Free the matrix and the buffers of the exchange plan
+ */
+void dist_free_matrix(
+    distCsrMatrix*    dm);
+
+/** \brief y := A x, exchanging the ghost values of \a x during the interior product
+ */
+void dist_spmv(
+    distCsrMatrix*    dm,
+    cldenseVector*    x,
+    cldenseVector*    y,
+    cl_command_queue  queue,
+    clsparseControl   control);
+
+/** \brief Global dot product of two distributed vectors into \a result
+ */
+void dist_dot(
+    distCsrMatrix*    dm,
+    clsparseScalar*   result,
+    cldenseVector*    x,
+    cldenseVector*    y,
+    cl_command_queue  queue,
+    clsparseControl   control);
+
+/** \brief Global 2-norm of a distributed vector into \a result
+ */
+void dist_nrm2(
+    distCsrMatrix*    dm,
+    clsparseScalar*   result,
+    cldenseVector*    x,
+    cl_command_queue  queue,
+    clsparseControl   control);
+#endif
@@ -0,0 +1,106 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file ensemble.h
+ * \brief Convergence monitoring of the multi-start ensemble
+ *
+ * Every \a period iterations the ranks of the ensemble post a non-blocking
+ * MINLOC reduction of their error estimate, and collect it \a period
+ * iterations later. The decisions only depend on the reduced value, so every
+ * rank takes them at the same iteration: the whole ensemble stops as soon as
+ * the best start has converged, and the starts lagging far behind it stop
+ * computing before that.
+ */
+
+#ifndef _ENSEMBLE_H
+#define _ENSEMBLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <mpi.h>
+
+#include "define.h"
+
+/// \brief State of a rank of the ensemble
+typedef enum ensembleState_t{
+    /// Still iterating
+    ENSEMBLE_RUNNING,
+    /// Too far behind the best start, does not compute any more
+    ENSEMBLE_LAGGING,
+    /// The best start converged, every rank leaves the loop
+    ENSEMBLE_STOP
+}ensembleState_t;
+
+/// \brief Error estimate and the rank it comes from, layout of MPI_DOUBLE_INT
+typedef struct ensembleEstimate{
+    double value;
+    int    rank;
+}ensembleEstimate;
+
+/// \brief Pending reduction and decisions of the ensemble
+typedef struct ensembleMonitor{
+    /// Ranks of the ensemble
+    MPI_Comm          comm;
+    /// Iterations between two reductions
+    int               period;
+    /// A start stops when its estimate exceeds \a lagRatio times the best one, or than MAX_TOL
+    double            lagRatio;
+    /// Number of calls to \a ensemble_update()
+    int               iteration;
+    /// Request of the reduction in flight
+    MPI_Request       request;
+    /// Whether a reduction was posted and not collected yet
+    int               pending;
+    /// Estimate of this rank sent in the reduction in flight
+    ensembleEstimate  local;
+    /// Result of the last collected reduction
+    ensembleEstimate  best;
+    /// State of this rank
+    ensembleState_t   state;
+    /// Whether this rank stopped computing before the ensemble did
+    int               lagged;
+    /// Number of reductions without the best estimate halving before stopping, 0 to never stop early
+    int               stallPeriods;
+    /// Best estimate from which the stall counts, the rounding level of the precision
+    double            stallFloor;
+    /// Best estimate when it last halved, and the reductions since
+    double            stallBest;
+    int               stallCount;
+    /// Whether the ensemble stopped because the best estimate stalled above MAX_TOL
+    int               stalled;
+}ensembleMonitor;
+
+/** \brief Start monitoring the ensemble \a comm
+ */
+void ensemble_init(
+    ensembleMonitor *mon,
+    MPI_Comm        comm,
+    int             period,
+    double          lagRatio);
+
+/** \brief Stop the ensemble once the best estimate, below \a floor, did not halve for \a periods reductions
+ *
+ * The decision only depends on the reduced value, so all the ranks take it
+ * together. Used to give up a precision that cannot reach MAX_TOL: \a floor
+ * is its rounding level, above which a slow convergence is not a stall.
+ */
+void ensemble_stop_on_stall(
+    ensembleMonitor *mon,
+    int             periods,
+    double          floor);
+
+/** \brief Account for one iteration with the current error \a estimate and return the state of the rank
+ *
+ * Must be called at every iteration by every rank of the ensemble, lagging
+ * ones included, until it returns ENSEMBLE_STOP. The estimate of a lagging
+ * rank is ignored.
+ */
+ensembleState_t ensemble_update(
+    ensembleMonitor *mon,
+    double          estimate);
+
+/** \brief Collect the reduction still in flight, if the loop ended on its iteration count
+ */
+void ensemble_finish(
+    ensembleMonitor *mon);
+#endif
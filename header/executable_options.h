@@ -16,6 +16,20 @@
 #include <errno.h>
 #include <mpi.h>
 
+#include "partition.h"
+#include "solver.h"
+#include "stencil.h"
+
+/// \brief Precisions of the solver
+typedef enum precision_t{
+    /// Single precision
+    PRECISION_SINGLE,
+    /// Double precision
+    PRECISION_DOUBLE,
+    /// Single precision, then double precision if the error stalls above MAX_TOL
+    PRECISION_AUTO
+}precision_t;
+
 /// \brief Structure of command line options for the executable
 struct CommandLineOptions_t
 {
@@ -27,6 +41,30 @@ struct CommandLineOptions_t
     unsigned long long num;
     /// Size of the Krylov Subspace
     unsigned long long kryl;
+    /// Number of ranks sharing one matrix distributed by rows (1: ensemble only)
+    unsigned long long dist;
+    /// Partitioning of the rows between the ranks sharing one matrix
+    partitionMethod_t  partition;
+    /// Comma-separated indices of the devices assigned to the ranks of a node, NULL for all of them
+    char     *devices;
+    /// Print the devices and exit
+    int      listDevices;
+    /// Implementation of the solver
+    backend_t backend;
+    /// Precision of the solver
+    precision_t precision;
+    /// Maximal number of refinement steps of each eigenpair in double precision, 0 to skip it
+    unsigned long long refine;
+    /// Prefix of the per-rank JSON timing reports, NULL to skip the timings
+    char     *timing;
+    /// Prefix of the per-rank Chrome traces, NULL to skip the trace
+    char     *trace;
+    /// Matrix-free operator solved instead of reading \a infilePath, NULL to read it
+    stencilOperator *stencil;
+    /// File listing the Matrix Market files solved one per process in batch mode, NULL to solve one matrix
+    char     *batch;
+    /// File of the eigenvectors the solve starts from, if it exists, and to which it writes its own, NULL for random starts
+    char     *warmStart;
 };
 
 typedef struct CommandLineOptions_t CommandLineOptions_t;
@@ -34,6 +72,22 @@ typedef struct CommandLineOptions_t CommandLineOptions_t;
 /// \brief Global variable of the parameters of the program
 extern CommandLineOptions_t commandLineOptions;
 
+/** \brief Parse the name of a backend
+ *
+ * \return EXIT_FAILURE if the name is unknown or the backend was not built
+ */
+int backend_from_name(
+    const char *name,
+    backend_t  *backend);
+
+/** \brief Parse the name of a precision: single, double or auto
+ *
+ * \return EXIT_FAILURE if the name is unknown
+ */
+int precision_from_name(
+    const char  *name,
+    precision_t *precision);
+
 /// \brief Fill the \a CommandLineOption global variable with the given arguments
 void parse_argument(
 	int   argc,
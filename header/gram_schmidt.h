@@ -1,7 +1,7 @@
 /** 
  * \author Daumen Anton and Nicolas Derumigny
  * \file gram_schmidt.h
- * \brief Gram-Schmidt process on GPU using clSPARSE library
+ * \brief Orthonormalization of a block of vectors on GPU
  *
  */
 
@@ -15,26 +15,46 @@
 #include "clSPARSE-error.h"
 
 #include "cl_utils.h"
+#include "cl_kernels.h"
+#include "dense_utils.h"
+
+/// \brief Buffers of \a gram_schmidt() for the blocks of \a n columns, kept from one call to the next
+typedef struct gramSchmidtWork{
+	/// Number of columns, 0 until \a gram_schmidt_init_work()
+	int     n;
+	/// Gram matrix and Cholesky factor on the device
+	cl_mem  G;
+	cl_mem  R;
+	/// Their host copies, in the precision of the block then in double precision
+	real_t  *host;
+	double  *Gd;
+	double  *Rd;
+}gramSchmidtWork;
+
+/** \brief Allocate the buffers of \a work for blocks of \a n columns
+ *
+ * \return the status of the first device allocation that failed, CL_SUCCESS otherwise
+ */
+cl_int gram_schmidt_init_work(
+	gramSchmidtWork  *work,
+	cl_context       context,
+	int              n);
+
+/** \brief Release the buffers of \a work, which may be uninitialized if zeroed
+ */
+void gram_schmidt_free_work(
+	gramSchmidtWork  *work);
 
+/** \brief Orthonormalize the columns of the block \a V in place
+ *
+ * Uses CholQR2: the Gram matrix V^T V is computed in one kernel, factorized
+ * on host and V is updated with one triangular solve kernel, twice. Blocks too
+ * ill-conditioned for the Cholesky factorization are handled by TSQR. \a work
+ * holds the buffers for the columns of \a V.
+ */
 void gram_schmidt(
-	cldenseVector   *eigenVectors,
-	unsigned        numberOfVector,
-	cl_context      *context,
-	clsparseControl control);
-
-clsparseStatus clsparseScalarSinv(
-	clsparseScalar  *scalar,
-	clsparseControl control);
-
-clsparseStatus clsparseScalarDinv(
-	clsparseScalar  *scalar,
-	clsparseControl control);
-
-clsparseStatus clsparseScalarDopos(
-	clsparseScalar *scalar,
-	clsparseControl control);
-
-clsparseStatus clsparseScalarSopos(
-	clsparseScalar *scalar,
-	clsparseControl control);
+	cldenseMatrix    *V,
+	gramSchmidtWork  *work,
+	cl_command_queue queue);
+
 #endif
@@ -0,0 +1,60 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file matrix_gen.h
+ * \brief Test matrices generated in memory, for the benchmarks
+ *
+ * The matrices are built in the same \a csrMatrix as the reader fills, with
+ * the values in the precisions requested. Their pattern and values only
+ * depend on the parameters and the seed, so every rank and every commit
+ * generates the same matrix.
+ */
+
+#ifndef _MATRIX_GEN_H
+#define _MATRIX_GEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "define.h"
+
+/// \brief Families of generated matrices
+typedef enum matrixKind_t{
+    /// 5-point Laplacian on a square grid
+    MATRIX_LAPLACE_2D,
+    /// 7-point Laplacian on a cubic grid
+    MATRIX_LAPLACE_3D,
+    /// Uniformly random columns, the same number per row
+    MATRIX_RANDOM,
+    /// Band around the diagonal, values decaying away from it
+    MATRIX_BANDED,
+    /// Random columns with row lengths following a power law
+    MATRIX_POWER_LAW,
+    MATRIX_KINDS
+}matrixKind_t;
+
+/** \brief Name of a family of matrices, as printed by the benchmarks
+ */
+const char *matrix_kind_name(
+    matrixKind_t kind);
+
+/** \brief Generate a matrix of about \a n rows of the family \a kind
+ *
+ * The Laplacians round \a n to the nearest square or cube and ignore
+ * \a nnzPerRow, the other families have \a nnzPerRow non-zeros per row on
+ * average, the diagonal included. \a precisions is MATRIX_SINGLE and/or
+ * MATRIX_DOUBLE (see \a matrix_reader.h). Free the matrix with \a free_Matrix()
+ * and MPI_WIN_NULL.
+ *
+ * \return EXIT_FAILURE if the parameters are invalid or the memory is exhausted
+ */
+int generate_matrix(
+    csrMatrix    *mat,
+    matrixKind_t kind,
+    int          n,
+    int          nnzPerRow,
+    unsigned     seed,
+    int          precisions);
+#endif
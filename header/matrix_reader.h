@@ -13,11 +13,13 @@
 #include <string.h>
 #include <mpi.h>
 
-#include "clSPARSE.h"
-#include "clSPARSE-error.h"
 #include "define.h"
 #include "../lib/header/mmio.h"
 
+/// \brief Flags of the precisions of the values kept by the reader
+#define MATRIX_SINGLE 1
+#define MATRIX_DOUBLE 2
+
 /**
  * \brief Open the Matrix Market file and read it.
  */
@@ -25,14 +27,58 @@ int read_Matrix(
     /// Name of the file to open
     const char* filename,
     ///Sparse Matrix in the CSR format
+    csrMatrix*  mat,
+    /// MATRIX_SINGLE and/or MATRIX_DOUBLE, whether to fill \a svals and \a dvals
+    int         precisions);
+
+/**
+ * \brief Read the sizes of the Matrix Market file into \a nRow, \a nCol and \a nNz of \a mat, without its entries.
+ */
+int read_Matrix_size(
+    /// Name of the file to open
+    const char* filename,
+    ///Sparse Matrix in the CSR format, only its sizes are set
     csrMatrix*  mat);
 
+/**
+ * \brief Open the Matrix Market file and read it once per node into a shared-memory window.
+ *
+ * Collective over \a node_comm, whose ranks must share memory. Rank 0 of
+ * \a node_comm reads the file into the window, the others map the same
+ * arrays and must only read them. The host memory used by the matrix is then
+ * the same whatever the number of ranks on the node.
+ */
+int read_Matrix_shared(
+    /// Name of the file to open
+    const char* filename,
+    ///Sparse Matrix in the CSR format, its arrays point into the window
+    csrMatrix*  mat,
+    /// Ranks of the node
+    MPI_Comm    node_comm,
+    /// Window holding the arrays of the matrix
+    MPI_Win*    win,
+    /// MATRIX_SINGLE and/or MATRIX_DOUBLE, whether to fill \a svals and \a dvals
+    int         precisions);
+
+/**
+ * \brief Free a matrix read by \a read_Matrix() (\a win is MPI_WIN_NULL) or \a read_Matrix_shared()
+ *
+ * Collective over the ranks of the node for a shared matrix.
+ */
+void free_Matrix(
+    ///Sparse Matrix in the CSR format
+    csrMatrix*  mat,
+    /// Window holding the arrays of the matrix or MPI_WIN_NULL
+    MPI_Win*    win);
+
 /**
  * \brief Read the values of a Matrix Market file line.
  *
  * If val is passed as 'NULL' then the function assumes that each line containsonly 2 values.
  *
  * If both row and col are passed as 'NULL' then the line is read but ignored.
+ *
+ * The value is stored in those of \a sval and \a dval that are not 'NULL'.
  */
 int get_line(
     /// File the line will be read from
@@ -43,8 +89,10 @@ int get_line(
     int* row,
     /// Array where the column indices will be stored
     int* col,
-    /// Array where the value will be stored
-    real_t* val);
+    /// Array where the value will be stored in single precision
+    float*  sval,
+    /// Array where the value will be stored in double precision
+    double* dval);
 
 /**
  * \brief Print a csrMatrix struct
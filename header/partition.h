@@ -0,0 +1,65 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file partition.h
+ * \brief Graph partitioning of the rows of a matrix distributed over several ranks
+ *
+ * The rows are renumbered so that the rows of each part are contiguous, part
+ * \a p being owned by rank \a p of the distributed matrix. Minimizing the
+ * edge-cut of the symmetrized sparsity graph minimizes the number of ghost
+ * values exchanged at each sparse matrix-vector product.
+ */
+
+#ifndef _PARTITION_H
+#define _PARTITION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "define.h"
+
+/// \brief Partitioning algorithms
+typedef enum partitionMethod_t{
+    /// METIS, else Scotch, else the built-in multilevel partitioner
+    PARTITION_AUTO,
+    /// Contiguous blocks of rows of the same size, no renumbering
+    PARTITION_BLOCK,
+    /// Built-in multilevel recursive bisection
+    PARTITION_MULTILEVEL,
+    /// METIS k-way partitioning (requires HAVE_METIS)
+    PARTITION_METIS,
+    /// Scotch partitioning (requires HAVE_SCOTCH)
+    PARTITION_SCOTCH
+}partitionMethod_t;
+
+/** \brief Parse the name of a partitioning method
+ *
+ * \return EXIT_FAILURE if the name is unknown or the library was not available at build time
+ */
+int partition_method_from_name(
+    const char        *name,
+    partitionMethod_t *method);
+
+/** \brief Partition the rows of \a mat in \a nParts and renumber them in place
+ *
+ * The partition is computed by rank 0 of \a comm and broadcast, every rank
+ * then applies the symmetric permutation to its copy of \a mat. If \a mat
+ * is shared by the ranks of a node (\a win is not MPI_WIN_NULL, see
+ * \a read_Matrix_shared()), the ranks of the window must all call this
+ * function and rank 0 of the window applies it alone.
+ *
+ * \a perm receives the new index of each original row and \a rowOffsets the
+ * first row of each part (\a nParts + 1 values).
+ *
+ * \return the edge-cut of the partition
+ */
+long long partition_matrix(
+    csrMatrix         *mat,
+    int               nParts,
+    partitionMethod_t method,
+    MPI_Comm          comm,
+    int               *perm,
+    int               *rowOffsets,
+    MPI_Win           win);
+#endif
@@ -0,0 +1,127 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file precision.h
+ * \brief Names of the functions compiled once per precision
+ *
+ * The solver, its backends and their kernels are built twice into the
+ * executable, with and without DOUBLE_PRECISION. Their external names get
+ * the suffix _d or _s here so both copies link together, while the code
+ * keeps calling them by their plain name in either precision. The code
+ * compiled once sees the _s names, and picks the copy of the solver with
+ * \a solve_s() or \a solve_d().
+ */
+
+#ifndef _PRECISION_H
+#define _PRECISION_H
+
+#ifdef DOUBLE_PRECISION
+#define PRECISION_NAME(name) name##_d
+#else
+#define PRECISION_NAME(name) name##_s
+#endif
+
+// solver.c
+#define solve                      PRECISION_NAME(solve)
+#define solve_packed               PRECISION_NAME(solve_packed)
+#define solver_acquire             PRECISION_NAME(solver_acquire)
+#define solver_release             PRECISION_NAME(solver_release)
+
+// spmv_tune.c
+#define fnv1a                      PRECISION_NAME(fnv1a)
+#define matrix_fingerprint         PRECISION_NAME(matrix_fingerprint)
+#define spmv_autotune              PRECISION_NAME(spmv_autotune)
+#define stream_bandwidth           PRECISION_NAME(stream_bandwidth)
+
+// cpu_kernels.c, cpu_backend.c
+#define cpu_axpy                   PRECISION_NAME(cpu_axpy)
+#define cpu_dot                    PRECISION_NAME(cpu_dot)
+#define cpu_gemm                   PRECISION_NAME(cpu_gemm)
+#define cpu_nrm2                   PRECISION_NAME(cpu_nrm2)
+#define cpu_orthonormalize         PRECISION_NAME(cpu_orthonormalize)
+#define cpu_scale                  PRECISION_NAME(cpu_scale)
+#define cpu_seg_dot_axpy           PRECISION_NAME(cpu_seg_dot_axpy)
+#define cpu_seg_gemm               PRECISION_NAME(cpu_seg_gemm)
+#define cpu_seg_normalize          PRECISION_NAME(cpu_seg_normalize)
+#define cpu_sell_free              PRECISION_NAME(cpu_sell_free)
+#define cpu_sell_init              PRECISION_NAME(cpu_sell_init)
+#define cpu_spmv                   PRECISION_NAME(cpu_spmv)
+#define cpu_spmv_merge             PRECISION_NAME(cpu_spmv_merge)
+#define cpu_spmv_scalar            PRECISION_NAME(cpu_spmv_scalar)
+#define cpu_spmv_sell              PRECISION_NAME(cpu_spmv_sell)
+#define cpu_spmv_stencil           PRECISION_NAME(cpu_spmv_stencil)
+#define cpu_backend_init           PRECISION_NAME(cpu_backend_init)
+
+// cl_utils.c
+#define cl_build_program           PRECISION_NAME(cl_build_program)
+#define cl_free                    PRECISION_NAME(cl_free)
+#define cl_free_matrix             PRECISION_NAME(cl_free_matrix)
+#define cl_free_matrix_split       PRECISION_NAME(cl_free_matrix_split)
+#define cl_free_queue_pool         PRECISION_NAME(cl_free_queue_pool)
+#define cl_free_vector_block       PRECISION_NAME(cl_free_vector_block)
+#define cl_init                    PRECISION_NAME(cl_init)
+#define cl_init_matrix             PRECISION_NAME(cl_init_matrix)
+#define cl_init_matrix_split       PRECISION_NAME(cl_init_matrix_split)
+#define cl_init_queue_pool         PRECISION_NAME(cl_init_queue_pool)
+#define cl_init_vector_block       PRECISION_NAME(cl_init_vector_block)
+#define cl_list_devices            PRECISION_NAME(cl_list_devices)
+#define cl_print_devices           PRECISION_NAME(cl_print_devices)
+#define cl_print_matrix            PRECISION_NAME(cl_print_matrix)
+#define cl_queue_pool_fork         PRECISION_NAME(cl_queue_pool_fork)
+#define cl_queue_pool_join         PRECISION_NAME(cl_queue_pool_join)
+#define minusOne_S                 PRECISION_NAME(minusOne_S)
+#define one_S                      PRECISION_NAME(one_S)
+#define zero_S                     PRECISION_NAME(zero_S)
+
+// gram_schmidt.c
+#define gram_schmidt               PRECISION_NAME(gram_schmidt)
+#define gram_schmidt_free_work     PRECISION_NAME(gram_schmidt_free_work)
+#define gram_schmidt_init_work     PRECISION_NAME(gram_schmidt_init_work)
+
+// cl_kernels.c
+#define cl_kernel_axpy             PRECISION_NAME(cl_kernel_axpy)
+#define cl_kernel_dot_axpy         PRECISION_NAME(cl_kernel_dot_axpy)
+#define cl_kernel_gather           PRECISION_NAME(cl_kernel_gather)
+#define cl_kernel_gemm             PRECISION_NAME(cl_kernel_gemm)
+#define cl_kernel_ger_row          PRECISION_NAME(cl_kernel_ger_row)
+#define cl_kernel_gram             PRECISION_NAME(cl_kernel_gram)
+#define cl_kernel_normalize        PRECISION_NAME(cl_kernel_normalize)
+#define cl_kernel_scatter_add      PRECISION_NAME(cl_kernel_scatter_add)
+#define cl_kernel_seg_dot_axpy     PRECISION_NAME(cl_kernel_seg_dot_axpy)
+#define cl_kernel_seg_gemm         PRECISION_NAME(cl_kernel_seg_gemm)
+#define cl_kernel_seg_ger_row      PRECISION_NAME(cl_kernel_seg_ger_row)
+#define cl_kernel_seg_normalize    PRECISION_NAME(cl_kernel_seg_normalize)
+#define cl_kernel_spmv_csr_scalar  PRECISION_NAME(cl_kernel_spmv_csr_scalar)
+#define cl_kernel_spmv_csr_vector  PRECISION_NAME(cl_kernel_spmv_csr_vector)
+#define cl_kernel_spmv_merge_path  PRECISION_NAME(cl_kernel_spmv_merge_path)
+#define cl_kernel_spmv_sell        PRECISION_NAME(cl_kernel_spmv_sell)
+#define cl_kernel_spmv_stencil     PRECISION_NAME(cl_kernel_spmv_stencil)
+#define cl_kernel_trsm             PRECISION_NAME(cl_kernel_trsm)
+#define cl_kernels_clsparse_event  PRECISION_NAME(cl_kernels_clsparse_event)
+#define cl_kernels_collect_timings PRECISION_NAME(cl_kernels_collect_timings)
+#define cl_kernels_free            PRECISION_NAME(cl_kernels_free)
+#define cl_kernels_init            PRECISION_NAME(cl_kernels_init)
+#define cl_kernels_set_comm        PRECISION_NAME(cl_kernels_set_comm)
+#define cl_kernels_work_group_size PRECISION_NAME(cl_kernels_work_group_size)
+
+// cl_spmv.c
+#define cl_spmv                    PRECISION_NAME(cl_spmv)
+#define cl_spmv_free               PRECISION_NAME(cl_spmv_free)
+#define cl_spmv_init               PRECISION_NAME(cl_spmv_init)
+#define cl_spmv_set_variant        PRECISION_NAME(cl_spmv_set_variant)
+#define cl_spmv_variant_names      PRECISION_NAME(cl_spmv_variant_names)
+
+// dist_matrix.c, cl_backend.c
+#define dist_dot                   PRECISION_NAME(dist_dot)
+#define dist_free_matrix           PRECISION_NAME(dist_free_matrix)
+#define dist_init_matrix           PRECISION_NAME(dist_init_matrix)
+#define dist_nrm2                  PRECISION_NAME(dist_nrm2)
+#define dist_print_halo            PRECISION_NAME(dist_print_halo)
+#define dist_print_overlap         PRECISION_NAME(dist_print_overlap)
+#define dist_reset_overlap         PRECISION_NAME(dist_reset_overlap)
+#define dist_row_start             PRECISION_NAME(dist_row_start)
+#define dist_set_spmv_variant      PRECISION_NAME(dist_set_spmv_variant)
+#define dist_spmv                  PRECISION_NAME(dist_spmv)
+#define cl_backend_acquire         PRECISION_NAME(cl_backend_acquire)
+#define cl_backend_init            PRECISION_NAME(cl_backend_init)
+#define cl_backend_release         PRECISION_NAME(cl_backend_release)
+#endif
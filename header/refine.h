@@ -0,0 +1,104 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file refine.h
+ * \brief Refinement in double precision of the eigenpairs found by the solver
+ *
+ * The solver may run in single precision, which cannot reach \a MAX_TOL.
+ * Each of its eigenvectors is then refined on the host against the matrix
+ * read in double precision: a step builds an Arnoldi basis of
+ * \a REFINE_KRYLOV vectors from the current vector, finds the eigenpair of
+ * the small Hessenberg matrix nearest the Rayleigh quotient theta of the
+ * vector with inverse iterations shifted by theta followed by Rayleigh
+ * quotient iterations, and takes its Ritz vector, or the vector of the basis
+ * minimizing ||A x - theta x|| when its residual is lower. Each pair thus
+ * stays with the eigenvalue the solver found, without assuming a symmetric
+ * matrix. The
+ * steps stop once the residual ||A x - theta x|| is below \a MAX_TOL |theta|,
+ * or at the first step that does not lower it or whose theta moves from the
+ * starting one by more than \a REFINE_DRIFT starting residuals, which is undone.
+ *
+ * The rows are distributed like the vectors of the solver, the whole vector
+ * is gathered before each product.
+ *
+ * Only double precision is used here, so it is compiled once for both
+ * copies of the solver.
+ */
+
+#ifndef _REFINE_H
+#define _REFINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <mpi.h>
+
+#include "define.h"
+#include "dense_utils.h"
+#include "stencil.h"
+
+/// \brief Rows of the matrix in double precision owned by a rank
+typedef struct refineMatrix{
+    /// Ranks sharing the matrix
+    MPI_Comm comm;
+    /// Number of rows of the whole matrix
+    int      nGlobal;
+    /// First global row owned by this rank
+    int      rowStart;
+    /// Number of rows owned by this rank
+    int      nLocal;
+    /// Matrix-free operator applied instead of the local rows, which are NULL
+    const stencilOperator *stencil;
+    /// Local rows with global column indices
+    int      *rows;
+    int      *cols;
+    double   *vals;
+    /// Number of rows and first row of each rank of \a comm
+    int      *counts;
+    int      *displs;
+    /// Whole vector gathered before a product
+    double   *full;
+}refineMatrix;
+
+/// \brief Outcome of the refinement of one eigenpair
+typedef struct refineResult{
+    /// Rayleigh quotient of the refined vector
+    double eigenvalue;
+    /// ||A x - theta x|| of the vector of the solver, with its own Rayleigh quotient
+    double initialResidual;
+    /// ||A x - theta x|| of the refined vector
+    double residual;
+    /// Number of steps done
+    int    steps;
+    /// Whether \a residual is below \a MAX_TOL |\a eigenvalue|
+    int    converged;
+}refineResult;
+
+/** \brief Copy the rows [\a rowOffsets[r], \a rowOffsets[r+1]) of \a mat owned by rank r of \a comm
+ *
+ * The values are taken from \a mat->dvals if it was read, from \a mat->svals
+ * else. A matrix-free \a mat is applied in double precision instead. \a rowOffsets may be NULL for blocks of the same size. Collective
+ * over \a comm.
+ */
+void refine_init(
+    refineMatrix    *rm,
+    const csrMatrix *mat,
+    const int       *rowOffsets,
+    MPI_Comm        comm);
+
+/** \brief Refine the local part \a x of an eigenvector in place, at most \a maxSteps steps
+ *
+ * \a x is normalized, its residual never grows. Collective over the
+ * communicator of \a rm.
+ */
+refineResult refine_pair(
+    refineMatrix *rm,
+    double       *x,
+    int          maxSteps);
+
+/** \brief Free the rows of \a refine_init()
+ */
+void refine_free(
+    refineMatrix *rm);
+#endif
@@ -0,0 +1,217 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file simultite.h
+ * \brief C API of libsimultite: a solver handle loading and solving matrices one after the other
+ *
+ * A handle splits its communicator as SimultIte does: \a dist ranks share
+ * one matrix distributed by rows, the groups solve it from different starts
+ * and keep the best one. The first solve on OpenCL selects the devices,
+ * creates the contexts and compiles the kernels, which the later solves of
+ * the handle reuse with the device blocks of the same sizes, until
+ * \a simultite_free() of the last handle of the process: the handles of a
+ * process share them, on the devices of the first one to solve.
+ *
+ * Each handle keeps its own options, several of them may be used in turn.
+ * MPI must be initialized by the caller, and every function is
+ * collective over the communicator of the handle, but for the loads and
+ * solves of a handle in \a batch mode, which are local to each rank.
+ */
+
+#ifndef _SIMULTITE_H
+#define _SIMULTITE_H
+
+#include <mpi.h>
+
+#include "define.h"
+#include "executable_options.h"
+
+/// \brief Parameters of a solver handle, see \a simultite_default_options()
+typedef struct simultiteOptions{
+    /// Number of eigenpairs
+    int               num;
+    /// Size of the Krylov subspace, at least \a num
+    int               kryl;
+    /// Ranks sharing one matrix distributed by rows, 1 for the ensemble only
+    int               dist;
+    /// Renumbering of the rows between the ranks sharing a matrix
+    partitionMethod_t partition;
+    backend_t         backend;
+    precision_t       precision;
+    /// Comma-separated indices of the devices of the ranks of a node, NULL for all of them
+    const char        *devices;
+    /// Maximal number of refinement steps of each eigenpair in double precision, 0 to skip it
+    int               refine;
+    /// Keep the host matrix once uploaded to solve it again, else it must be loaded before each solve
+    int               keepMatrix;
+    /// Each rank loads and solves its own matrices from a single start, \a dist must be 1, see \a simultite_load_files()
+    int               batch;
+}simultiteOptions;
+
+/// \brief Outcome of \a simultite_solve()
+typedef struct simultiteStatus{
+    /// Sum of the residual norms of the start of this rank, HUGE_VAL if it was dropped
+    double error;
+    /// Least error of the starts
+    double bestError;
+    /// Whether the start of this rank gave \a bestError, the first one of them on a tie
+    int    isBest;
+    /// Rank among the ranks sharing the matrix
+    int    solverRank;
+    /// Whether the run ended in double precision
+    int    solvedDouble;
+    /// Size of the matrix solved
+    int    nRow;
+    int    nNz;
+}simultiteStatus;
+
+/// \brief Solver handle, see \a simultite_create()
+typedef struct simultiteSolver simultiteSolver;
+
+/** \brief Fill \a options with the defaults of SimultIte, \a num and \a kryl left to 0
+ */
+void simultite_default_options(
+    simultiteOptions *options);
+
+/** \brief Create a handle over the ranks of \a comm
+ *
+ * \return NULL if the options are invalid
+ */
+simultiteSolver *simultite_create(
+    MPI_Comm               comm,
+    const simultiteOptions *options);
+
+/** \brief Read the Matrix Market file \a path, once per node, as the matrix of the next solves
+ *
+ * \return EXIT_FAILURE if it could not be read
+ */
+int simultite_load_file(
+    simultiteSolver *solver,
+    const char      *path);
+
+/** \brief Read the first of the \a count Matrix Market files \a paths as the diagonal blocks of one matrix, solved together
+ *
+ * For the handles in \a batch mode. The files are taken in order until
+ * their rows would exceed BATCH_PACK_ROWS, one file at least; \a *consumed
+ * receives their number and \a loaded[i] whether file i of them could be
+ * read, the others being skipped. The next \a simultite_solve() runs each
+ * operation for all the matrices at once (\a solve_packed() of solver.h), in single
+ * precision unless \a precision is PRECISION_DOUBLE, and
+ * \a simultite_matrix_eigenpairs() gives the results of each of them.
+ *
+ * \return EXIT_FAILURE if none of them could be read
+ */
+int simultite_load_files(
+    simultiteSolver   *solver,
+    int               count,
+    const char *const *paths,
+    int               *consumed,
+    int               *loaded);
+
+/** \brief Copy the square matrix of \a nRow rows in CSR format as the matrix of the next solves
+ *
+ * Every rank passes the whole matrix: \a rows has \a nRow + 1 offsets into
+ * \a cols and \a values, whose column indices start at 0 and increase
+ * along each row.
+ *
+ * \return EXIT_FAILURE if the arrays are not a valid matrix
+ */
+int simultite_load_csr(
+    simultiteSolver *solver,
+    int             nRow,
+    const int       *rows,
+    const int       *cols,
+    const double    *values);
+
+/** \brief Use the matrix-free operator \a op for the next solves, see \a stencil.h
+ *
+ * \return EXIT_FAILURE if the handle distributes the matrices
+ */
+int simultite_load_stencil(
+    simultiteSolver       *solver,
+    const stencilOperator *op);
+
+/** \brief Solve the matrix loaded last
+ *
+ * \return EXIT_FAILURE if no matrix was loaded
+ */
+int simultite_solve(
+    simultiteSolver *solver,
+    simultiteStatus *status);
+
+/** \brief Eigenpairs of the last solve, from the start of this rank, on the rows it holds
+ *
+ * \a vectors holds the eigenvectors one after the other, each of \a *nRows
+ * values for the rows [\a *rowStart, \a *rowStart + \a *nRows) of the
+ * matrix, renumbered by \a simultite_permutation(). The arrays belong to the
+ * handle and are valid until the next load or solve.
+ *
+ * \return the number of eigenpairs, 0 if the start of this rank was dropped or
+ * the matrices were packed by \a simultite_load_files()
+ */
+int simultite_eigenpairs(
+    const simultiteSolver *solver,
+    const double          **values,
+    const double          **vectors,
+    int                   *rowStart,
+    int                   *nRows);
+
+/** \brief Eigenpairs and error of the matrix \a index, in the order of the files read, of the last solve of \a simultite_load_files()
+ *
+ * \a vectors holds the eigenvectors of its \a *nRows rows one after the
+ * other, valid as the arrays of \a simultite_eigenpairs().
+ *
+ * \return the number of eigenpairs, 0 if there is no such matrix
+ */
+int simultite_matrix_eigenpairs(
+    const simultiteSolver *solver,
+    int                   index,
+    const double          **values,
+    const double          **vectors,
+    int                   *nRows,
+    double                *error);
+
+/** \brief Start the next solve of the matrix loaded last from \a count vectors, such as the eigenvectors of a previous matrix
+ *
+ * The vectors that are eigenvectors of the matrix, up to WARM_START_TOL,
+ * are added to the random start of the Arnoldi process, and the subspace
+ * iteration starts from their coordinates in the Arnoldi basis. Each
+ * vector has the \a nRow values of the matrix, in the row order it was
+ * loaded in. The next load forgets them.
+ *
+ * \return EXIT_FAILURE if no matrix is loaded, or several were packed
+ */
+int simultite_set_start(
+    simultiteSolver *solver,
+    int             count,
+    const double    *vectors);
+
+/** \brief \a simultite_set_start() from a file written by \a simultite_write_vectors()
+ *
+ * \return EXIT_FAILURE if the file cannot be read or its vectors do not have the size of the matrix
+ */
+int simultite_read_start(
+    simultiteSolver *solver,
+    const char      *path);
+
+/** \brief Write the eigenvectors of the best start of the last solve to \a path
+ *
+ * The file holds the number of rows and of vectors as two native ints,
+ * then the vectors one after the other as native doubles, in the row order
+ * of the matrix loaded. Collective over the ranks sharing the matrix.
+ *
+ * \return EXIT_FAILURE on the rank that could not write the file, and for packed matrices
+ */
+int simultite_write_vectors(
+    const simultiteSolver *solver,
+    const char            *path);
+
+/** \brief New index of each row of the matrix loaded last, NULL if the rows were not renumbered
+ */
+const int *simultite_permutation(
+    const simultiteSolver *solver);
+
+/** \brief Release the matrix, the results, the communicators and the devices of the handle
+ */
+void simultite_free(
+    simultiteSolver *solver);
+#endif
@@ -0,0 +1,179 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file solver.h
+ * \brief Eigensolver running on the backend selected by the options
+ *
+ * The Arnoldi projection, the simultaneous iteration on the Hessenberg matrix,
+ * the recovery of the eigenvectors and their residuals are written once
+ * against the function table of \a backend.h.
+ */
+
+#ifndef _SOLVER_H
+#define _SOLVER_H
+
+#include <mpi.h>
+
+#include "define.h"
+
+/// \brief Implementations of the solver
+typedef enum backend_t{
+    /// clSPARSE and custom kernels on an OpenCL device (requires HAVE_OPENCL)
+    BACKEND_OPENCL,
+    /// OpenMP kernels on the host
+    BACKEND_CPU
+}backend_t;
+
+/// \brief Eigenpairs of a solve, on the rows held by this rank
+typedef struct solverResult{
+    /// Number of eigenpairs, 0 if the start was dropped by the ensemble
+    int    num;
+    /// Rows [\a rowStart, \a rowStart + \a n) of the matrix held by this rank
+    int    rowStart;
+    int    n;
+    /// Rayleigh quotients of the eigenvectors, the refined eigenvalues of the pairs converged by \a solverContext::refine
+    double *values;
+    /// \a num eigenvectors of \a n values one after the other
+    double *vectors;
+    /// Number of matrices of a \a solve_packed(), 0 for \a solve(). Matrix g then has the values
+    /// [g num, (g + 1) num) and the \a num vectors of its rows one after the other from
+    /// \a vectors + num offsets[g], its error being \a errors[g]
+    int    count;
+    double *errors;
+}solverResult;
+
+/// \brief Ranks and communicators of one rank of the solver
+typedef struct solverContext{
+    /// Rank in the communicator of the run, rank 0 prints the reports
+    int      my_rank;
+    /// Seed of the Arnoldi start vector, one per rank
+    unsigned seedQ;
+    /// Seed of the reduced vectors, the same for the ranks sharing a matrix
+    unsigned seedY;
+    /// Ranks sharing one matrix distributed by rows
+    MPI_Comm solver_comm;
+    /// Rank in \a solver_comm
+    int      solver_rank;
+    /// Ranks holding the same rows for different starts
+    MPI_Comm ensemble_comm;
+    /// Ranks of the node
+    MPI_Comm node_comm;
+    /// Whether the host matrix must be kept for a later solve
+    int      keepMatrix;
+    /// Stop once the error of the ensemble did not halve for that many periods, 0 to never stop early
+    int      stallPeriods;
+    /// Eigenpairs of the solve, allocated by \a solve(), NULL to skip them
+    solverResult *result;
+    /// \a startCount vectors of \a mat->nRow values in the row order of \a mat to start from, NULL for random starts
+    const double *start;
+    int          startCount;
+    /// SpMV kernel of the previous solve, -1 for none, updated by \a solve(); NULL to tune each matrix
+    int          *spmvVariant;
+    /// Number of eigenpairs and size of the Krylov subspace, at least \a num
+    int          num;
+    int          kryl;
+    /// Maximal number of refinement steps of each eigenpair in double precision, 0 to skip it
+    int          refine;
+    backend_t    backend;
+    /// Comma-separated indices of the devices of the ranks of a node, NULL for all of them
+    const char   *devices;
+}solverContext;
+
+/** \brief Run the solver on the backend of \a ctx
+ *
+ * The OpenCL backend distributes the rows of \a mat given by \a rowOffsets
+ * (blocks of the same size if NULL) and releases \a mat with \a free_Matrix()
+ * once uploaded unless \a ctx->keepMatrix, the CPU backend reads the whole of
+ * \a mat. The values of \a mat in the precision of the copy must have been
+ * read. Collective over the communicators of \a ctx.
+ *
+ * \a stalled is set if the run stopped because the error stalled, see
+ * \a solverContext::stallPeriods.
+ *
+ * \return the sum of the residual norms of the eigenvectors, of the refined
+ * ones for the pairs \a ctx->refine converged (see \a refine.h), HUGE_VAL if the
+ * start was dropped by the ensemble
+ */
+double solve(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *rowOffsets,
+    const solverContext *ctx,
+    int                 *stalled);
+
+/** \brief Solve the \a count diagonal blocks of the block-diagonal \a mat together, block g being its rows [offsets[g], offsets[g + 1])
+ *
+ * Each operation of the Arnoldi projection, of the recovery and of the
+ * residuals is done for all the blocks at once, with the segmented
+ * operations of the backend: the launches do not grow with the number of
+ * blocks. The simultaneous iteration then runs on the host in double
+ * precision on the Hessenberg matrix of each block, read once. Each block
+ * starts as \a solve() of the block alone, the result has one error per
+ * block. Local to the rank, \a mat is released as by \a solve().
+ *
+ * \return the sum of the errors of the blocks
+ */
+double solve_packed(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *offsets,
+    int                 count,
+    const solverContext *ctx);
+
+/** \brief Hold what the backends keep between the solves, until the matching \a solver_release()
+ *
+ * The OpenCL context, kernels and buffers are opened by the first solve on
+ * the devices of its \a solverContext::devices, and shared by the solvers
+ * of the process holding them. Local to the rank.
+ */
+void solver_acquire();
+
+/** \brief Release what \a solver_acquire() holds, the OpenCL session once no solver holds it
+ *
+ * Local to the rank. Nothing is kept on the CPU backend.
+ */
+void solver_release();
+
+/// \brief \a solve() in single precision, for the code compiled once
+double solve_s(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *rowOffsets,
+    const solverContext *ctx,
+    int                 *stalled);
+
+/// \brief \a solve() in double precision, for the code compiled once
+double solve_d(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *rowOffsets,
+    const solverContext *ctx,
+    int                 *stalled);
+
+/// \brief \a solve_packed() in single precision, for the code compiled once
+double solve_packed_s(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *offsets,
+    int                 count,
+    const solverContext *ctx);
+
+/// \brief \a solve_packed() in double precision, for the code compiled once
+double solve_packed_d(
+    csrMatrix           *mat,
+    MPI_Win             *matWin,
+    const int           *offsets,
+    int                 count,
+    const solverContext *ctx);
+
+/// \brief \a solver_acquire() of the single precision copy
+void solver_acquire_s();
+
+/// \brief \a solver_acquire() of the double precision copy
+void solver_acquire_d();
+
+/// \brief \a solver_release() of the single precision copy
+void solver_release_s();
+
+/// \brief \a solver_release() of the double precision copy
+void solver_release_d();
+#endif
@@ -0,0 +1,74 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file spmv_tune.h
+ * \brief Selection of the fastest SpMV kernel of a backend for the loaded matrix
+ *
+ * Every kernel of the backend is timed on the local rows of the matrix and
+ * the fastest one is kept. The choice is appended to a cache file, keyed by
+ * a fingerprint of the sparsity pattern, so the next runs on the same matrix
+ * skip the timings. The file is \a SIMULTITE_TUNE_CACHE if set, else
+ * ~/.simultite_spmv_cache. \a SIMULTITE_SPMV forces a kernel by name.
+ */
+
+#ifndef _SPMV_TUNE_H
+#define _SPMV_TUNE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <mpi.h>
+
+#include "define.h"
+#include "backend.h"
+
+/// \brief Initial value of \a fnv1a()
+#define FNV_OFFSET 14695981039346656037ULL
+
+/** \brief Continue the FNV-1a hash \a h with \a size bytes of \a data, start from FNV_OFFSET
+ */
+unsigned long long fnv1a(
+    unsigned long long h,
+    const void         *data,
+    size_t             size);
+
+/** \brief FNV-1a hash of rows [\a firstRow, \a firstRow + \a nRows) of \a mat and of \a salt
+ *
+ * Only the pattern and the precision are hashed, not the values. \a salt
+ * names what else the timings depend on, like the device.
+ */
+unsigned long long matrix_fingerprint(
+    const csrMatrix *mat,
+    int             firstRow,
+    int             nRows,
+    const char      *salt);
+
+/** \brief Select the SpMV kernel of \a backend, from the cache or by timing them all
+ *
+ * Collective over \a comm, the ranks sharing the matrix: they all time the
+ * same kernels and keep the fastest for the slowest rank, unless they all
+ * found their fingerprint in the cache. A matrix of less than
+ * \a SPMV_TUNE_MIN_ROWS rows, whose timings would cost more than they save,
+ * keeps the kernel \a previous of the last matrix instead (-1 for none),
+ * or the first kernel if it does not suit. The timings are printed by rank 0
+ * of \a comm if \a verbose.
+ *
+ * \return the selected kernel
+ */
+int spmv_autotune(
+    solverBackend *backend,
+    MPI_Comm      comm,
+    int           verbose,
+    int           previous);
+
+/** \brief Memory bandwidth of the backend in GB/s, measured STREAM-style with its axpy
+ *
+ * Vectors of \a STREAM_LENGTH values, beyond the caches, are updated
+ * \a STREAM_REPS times, each update reading two vectors and writing one.
+ * The ranks of \a comm run it together, as they share the device during the
+ * solve.
+ */
+double stream_bandwidth(
+    solverBackend *backend,
+    MPI_Comm      comm);
+#endif
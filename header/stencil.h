@@ -0,0 +1,54 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file stencil.h
+ * \brief Matrix-free operators: constant coefficient stencils on structured grids
+ *
+ * A \a csrMatrix whose \a stencil is set has no entries: the backends apply
+ * the stencil instead of a stored matrix, with their own kernel and no
+ * matrix to read, upload or stream. The operator of a grid of nx x ny x nz
+ * points couples each point to its neighbours along the three axes, the
+ * points outside the grid being zero (Dirichlet boundary). A 5-point stencil
+ * is a grid with nz = 1, a 3-point one has ny = nz = 1.
+ *
+ * Compiled once, the kernels of the backends are in their own files.
+ */
+
+#ifndef _STENCIL_H
+#define _STENCIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "define.h"
+
+/// \brief Name of the single SpMV kernel of the backends for a stencil, see \a spmv_tune.h
+extern const char *const stencil_variant_names[1];
+
+/** \brief Parse "nx,ny,nz[,center,cx,cy,cz]" into \a op
+ *
+ * Without the coefficients the operator is the Laplacian: -1 for the
+ * neighbours, twice the number of axes with more than one point at the center.
+ *
+ * \return EXIT_FAILURE if the description is invalid or the grid has more rows than an int holds
+ */
+int stencil_from_string(
+    const char      *spec,
+    stencilOperator *op);
+
+/** \brief Matrix of the operator \a op, without entries: \a nRow, \a nCol and \a nNz only
+ */
+void stencil_matrix(
+    const stencilOperator *op,
+    csrMatrix             *mat);
+
+/** \brief y := A x for the rows [\a first, \a first + \a count) of \a op, \a x being the whole vector
+ */
+void stencil_apply(
+    const stencilOperator *op,
+    int                   first,
+    int                   count,
+    const double          *x,
+    double                *y);
+#endif
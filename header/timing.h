@@ -0,0 +1,236 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file timing.h
+ * \brief Wall clock and device time of the phases of a run, written as JSON
+ *
+ * The phases may be nested: an inner phase pauses the outer one, so every
+ * second is counted in exactly one phase. When the timings are enabled,
+ * the OpenCL queues are created with CL_QUEUE_PROFILING_ENABLE, the custom
+ * kernels keep their event, and the solver waits for the device at the end
+ * of each phase. The kernel time of a phase is then the sum of the
+ * execution times of its kernels, and the rest of its wall time is launch
+ * overhead, idle device and host work. Of a call to clSPARSE, only the
+ * event of its last kernel is available, so it stands for the whole call.
+ *
+ * The solver also accounts the least bytes and the flops of each of its
+ * operations, from the rows, the non-zeros and the precision. Their rates
+ * are compared with the bandwidth of the device measured by
+ * \a stream_bandwidth() in a roofline summary.
+ *
+ * The blocking MPI calls are timed through their PMPI entry points, see
+ * \a mpi_profile.c, and accounted to the phase in progress. The phases of
+ * all the ranks are then reduced into a load imbalance summary: a rank
+ * sharing its device or on a slower node computes longer, while the others
+ * wait for it in the collectives.
+ *
+ * The trace mode also keeps every phase, MPI call, blocking wait of the host
+ * for the device and kernel as an event of a Chrome trace, one row per
+ * kind and per command queue, which Perfetto and chrome://tracing open.
+ * The kernels are placed on the host clock with the smallest gap seen
+ * between the end of the last kernel collected and the host returning from
+ * its wait, see \a timing_trace_clock().
+ *
+ * Compiled once, the state is shared by both copies of the solver.
+ */
+
+#ifndef _TIMING_H
+#define _TIMING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+/// \brief Phases of a run
+typedef enum timingPhase_t{
+    /// Reading the matrix file
+    TIMING_PARSE,
+    /// Renumbering the rows for the distributed mode
+    TIMING_PARTITION,
+    /// Backend setup and upload of the matrix
+    TIMING_UPLOAD,
+    /// Selection of the SpMV kernel
+    TIMING_TUNE,
+    /// Products of the Arnoldi projection
+    TIMING_ARNOLDI_SPMV,
+    /// Orthogonalization and normalization of the Arnoldi projection
+    TIMING_ARNOLDI_ORTHO,
+    /// Simultaneous iteration on the Hessenberg matrix, one call per iteration
+    TIMING_ITERATION,
+    /// Eigenvectors x = Q y
+    TIMING_RECOVERY,
+    /// Residuals of the eigenvectors
+    TIMING_RESIDUAL,
+    /// Refinement in double precision
+    TIMING_REFINE,
+    /// Reductions across the ensemble and the final result
+    TIMING_REDUCTION,
+    TIMING_PHASES
+}timingPhase_t;
+
+/// \brief Longest name of a traced event, longer ones are truncated
+#define TRACE_NAME_LENGTH 40
+/// \brief Command queues with their own row in the trace, the later ones share the last row
+#define TRACE_QUEUES 8
+
+/// \brief Rows of the trace
+typedef enum traceTrack_t{
+    /// Phases of \a timingPhase_t, nested as they are started
+    TRACE_PHASES,
+    /// Blocking MPI calls
+    TRACE_MPI,
+    /// Host waiting for the device: blocking reads, maps and clFinish
+    TRACE_WAITS,
+    /// Kernels of the first command queue, on the device clock
+    TRACE_DEVICE,
+    TRACE_TRACKS = TRACE_DEVICE + TRACE_QUEUES
+}traceTrack_t;
+
+/// \brief Description of the run written with the timings
+typedef struct timingRun{
+    int         rank;
+    int         num_ranks;
+    const char  *matrix;
+    int         nRow;
+    int         nNz;
+    int         num;
+    int         kryl;
+    const char  *backend;
+    const char  *precision;
+    double      error;
+}timingRun;
+
+/** \brief Enable the device timings, before any backend is created
+ */
+void timing_enable();
+
+/** \brief Whether \a timing_enable() was called
+ */
+int timing_enabled();
+
+/** \brief Keep the events of the trace from now on, enabling the timings
+ *
+ * The times of the trace start at this call, to be made by all the ranks
+ * after a barrier so their traces line up.
+ */
+void timing_trace_enable();
+
+/** \brief Whether \a timing_trace_enable() was called
+ */
+int timing_tracing();
+
+/** \brief Keep the event \a name from \a start to \a end, as given by MPI_Wtime(), on the host \a track
+ *
+ * Nothing is kept unless \a timing_tracing().
+ */
+void timing_trace(
+    const char   *name,
+    traceTrack_t track,
+    double       start,
+    double       end);
+
+/** \brief Keep the kernel \a name from \a start to \a end in seconds of the device clock on \a track
+ */
+void timing_trace_device(
+    const char   *name,
+    traceTrack_t track,
+    double       start,
+    double       end);
+
+/** \brief Upper bound of the host clock minus the device clock of \a track, the smallest one is kept
+ */
+void timing_trace_clock(
+    traceTrack_t track,
+    double       offset);
+
+/** \brief Start \a phase, pausing the phase in progress
+ */
+void timing_begin(
+    timingPhase_t phase);
+
+/** \brief End \a phase, which must be the last one started, and resume the previous one
+ */
+void timing_end(
+    timingPhase_t phase);
+
+/** \brief Phase in progress, -1 if none
+ */
+int timing_current();
+
+/** \brief Account \a seconds of kernel execution to \a phase
+ */
+void timing_add_kernel(
+    int    phase,
+    double seconds);
+
+/** \brief Account the least bytes moved and the floating point operations of an operation to the phase in progress
+ *
+ * The rates of a phase divide them by its kernel time if its kernels were
+ * profiled, by its wall time else.
+ */
+void timing_add_work(
+    double bytes,
+    double flops);
+
+/** \brief Account the blocking MPI call \a name, from \a start to \a end, to the phase in progress
+ *
+ * A NULL \a name is not traced, for the polls which are called in a loop.
+ */
+void timing_add_mpi(
+    const char *name,
+    double     start,
+    double     end);
+
+/** \brief Peak bandwidth of the device in GB/s, the ceiling of the roofline summary
+ */
+void timing_set_peak(
+    double gbs);
+
+/** \brief Peak bandwidth set by \a timing_set_peak(), 0 if none, kept by \a timing_reset()
+ */
+double timing_peak();
+
+/** \brief Print the achieved GB/s and GFLOP/s of the phases that did some work next to the peak
+ */
+void timing_print_roofline(
+    FILE *f);
+
+/** \brief Print the min, mean and max over the ranks of \a comm of the wall and MPI times of the phases, on rank 0
+ *
+ * Collective over \a comm, no phase may be in progress.
+ */
+void timing_print_imbalance(
+    FILE     *f,
+    MPI_Comm comm);
+
+/** \brief Wall time of \a phase so far, excluding the phases nested in it
+ */
+double timing_wall(
+    timingPhase_t phase);
+
+/** \brief Number of times \a phase was started
+ */
+long long timing_calls(
+    timingPhase_t phase);
+
+/** \brief Forget the times accounted so far, no phase may be in progress
+ */
+void timing_reset();
+
+/** \brief Write the events kept by \a timing_trace_enable() as a Chrome trace of process \a rank to \a path
+ *
+ * \return EXIT_FAILURE if the file could not be written
+ */
+int timing_write_trace(
+    const char *path,
+    int        rank);
+
+/** \brief Write the timings of this rank and \a run as a JSON object to \a path
+ *
+ * \return EXIT_FAILURE if the file could not be written
+ */
+int timing_write_json(
+    const char      *path,
+    const timingRun *run);
+#endif
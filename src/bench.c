@@ -0,0 +1,230 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file bench.c
+ * \brief Definition of the \a main() function for the simultite_bench executable.
+ *
+ * Solves generated matrices of every family of \a matrix_gen.h over a sweep
+ * of sizes, non-zeros per row, Krylov subspace sizes and numbers of
+ * eigenvalues, and appends one CSV line per configuration. The ranks run
+ * the ensemble mode, as SimultIte without \a -d.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <mpi.h>
+
+#include "executable_options.h"
+#include "matrix_gen.h"
+#include "matrix_reader.h"
+#include "solver.h"
+#include "timing.h"
+
+/// \brief Values of one parameter of the sweep
+typedef struct benchSweep{
+    int count;
+    int values[4];
+}benchSweep;
+
+/// \brief Sweep of the full benchmark, then of the quick one
+static const benchSweep sizes[2]     = {{3, {16384, 131072, 1048576}}, {1, {4096}}};
+static const benchSweep nnzPerRow[2] = {{2, {8, 32}},                  {1, {8}}};
+static const benchSweep kryls[2]     = {{2, {10, 30}},                 {1, {10}}};
+static const benchSweep nums[2]      = {{2, {2, 8}},                   {1, {2}}};
+
+/// \brief Columns of the CSV file
+#define BENCH_HEADER "label,matrix,rows,nonzeros,kryl,num,backend,precision,ranks,iterations,time_s,spmv_gbs,error\n"
+
+/**
+ * \brief Print the usage and exit with \a ret
+ */
+static void usage(
+        const char *name,
+        int        ret)
+{
+    int my_rank; MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    if (my_rank == 0)
+    {
+        fprintf(stderr, "Usage: mpirun -n num_process %s [{-o | --output} file.csv] [{-b | --backend} opencl|cpu] [{-f | --precision} single|double] [{-l | --label} label] [-q | --quick] [-h]\n", name);
+    }
+    MPI_Finalize();
+    exit(ret);
+}
+
+/**
+ * \brief Open \a path for appending, writing the header if it is empty
+ */
+static FILE *open_csv(
+        const char *path)
+{
+    FILE *f = fopen(path, "a");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    if (ftell(f) == 0)
+    {
+        fputs(BENCH_HEADER, f);
+    }
+    return f;
+}
+
+/**
+ * \brief Main Function
+ */
+int main(
+        int  argc,
+        char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    int num_proc; MPI_Comm_size(MPI_COMM_WORLD, &num_proc);
+    int my_rank;  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+    const char *output = "simultite_bench.csv";
+    const char *label  = "";
+    int         quick  = 0;
+    memset(&commandLineOptions, 0, sizeof(commandLineOptions));
+    commandLineOptions.dist      = 1;
+    commandLineOptions.partition = PARTITION_BLOCK;
+    commandLineOptions.devices   = getenv("SIMULTITE_DEVICES");
+    commandLineOptions.precision = PRECISION_SINGLE;
+#ifdef HAVE_OPENCL
+    commandLineOptions.backend   = BACKEND_OPENCL;
+#else
+    commandLineOptions.backend   = BACKEND_CPU;
+#endif
+
+    static struct option long_options[] = {
+        {"output",    required_argument, NULL, 'o'},
+        {"backend",   required_argument, NULL, 'b'},
+        {"precision", required_argument, NULL, 'f'},
+        {"label",     required_argument, NULL, 'l'},
+        {"quick",     no_argument,       NULL, 'q'},
+        {"help",      no_argument,       NULL, 'h'},
+        {0,           0,                 0,    0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:b:f:l:qh", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'o': output = optarg; break;
+            case 'l': label = optarg; break;
+            case 'q': quick = 1; break;
+            case 'b':
+            if (backend_from_name(optarg, &commandLineOptions.backend) != EXIT_SUCCESS) usage(argv[0], EXIT_FAILURE);
+            break;
+            case 'f':
+            if (precision_from_name(optarg, &commandLineOptions.precision) != EXIT_SUCCESS
+                    || commandLineOptions.precision == PRECISION_AUTO) usage(argv[0], EXIT_FAILURE);
+            break;
+            case 'h': usage(argv[0], EXIT_SUCCESS); break;
+            default: usage(argv[0], EXIT_FAILURE); break;
+        }
+    }
+    const int    isDouble  = (commandLineOptions.precision == PRECISION_DOUBLE);
+    const size_t valueSize = isDouble ? sizeof(double) : sizeof(float);
+
+    // The SpMV and the iterations are read from the phases of timing.h, the device is waited for at their end
+    timing_enable();
+
+    FILE *csv = NULL;
+    if (my_rank == 0 && (csv = open_csv(output)) == NULL)
+    {
+        fprintf(stderr, "[ERROR]: bench.c: could not write %s\n", output);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    // Every rank solves alone from its own start, as the ensemble mode of SimultIte
+    MPI_Comm solver_comm, node_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, my_rank, 0, &solver_comm);
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL, &node_comm);
+    solverContext ctx;
+    ctx.my_rank       = my_rank;
+    ctx.seedQ         = SEED + my_rank;
+    ctx.seedY         = SEED + num_proc + my_rank;
+    ctx.solver_comm   = solver_comm;
+    ctx.solver_rank   = 0;
+    ctx.ensemble_comm = MPI_COMM_WORLD;
+    ctx.node_comm     = node_comm;
+    ctx.keepMatrix    = 1;
+    ctx.stallPeriods  = 0;
+    ctx.result        = NULL;
+    ctx.start         = NULL;
+    ctx.startCount    = 0;
+    ctx.spmvVariant   = NULL;
+    ctx.refine        = 0;
+    ctx.backend       = commandLineOptions.backend;
+    ctx.devices       = commandLineOptions.devices;
+    solver_acquire_s();
+    solver_acquire_d();
+
+    for (int kind = 0; kind < MATRIX_KINDS; ++kind)
+    for (int s = 0; s < sizes[quick].count; ++s)
+    for (int d = 0; d < nnzPerRow[quick].count; ++d)
+    {
+        // The Laplacians have a fixed stencil
+        const int laplacian = (kind == MATRIX_LAPLACE_2D || kind == MATRIX_LAPLACE_3D);
+        if (laplacian && d > 0) continue;
+
+        csrMatrix mat;
+        MPI_Win   matWin = MPI_WIN_NULL;
+        int err = generate_matrix(&mat, kind, sizes[quick].values[s], nnzPerRow[quick].values[d], SEED,
+                isDouble ? MATRIX_DOUBLE : MATRIX_SINGLE);
+        MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (err != EXIT_SUCCESS)
+        {
+            free_Matrix(&mat, &matWin);
+            continue;
+        }
+        // Least traffic of one product: the matrix once, x read and y written once
+        const double spmvBytes = (double) mat.nNz * (valueSize + sizeof(int))
+                + (mat.nRow + 1.0) * sizeof(int) + 2.0 * mat.nRow * valueSize;
+
+        for (int k = 0; k < kryls[quick].count; ++k)
+        for (int v = 0; v < nums[quick].count; ++v)
+        {
+            ctx.kryl = kryls[quick].values[k];
+            ctx.num  = nums[quick].values[v];
+            if (ctx.num > ctx.kryl) continue;
+
+            int    stalled;
+            timing_reset();
+            MPI_Barrier(MPI_COMM_WORLD);
+            double start = MPI_Wtime();
+            double error = isDouble ? solve_d(&mat, &matWin, NULL, &ctx, &stalled)
+                                    : solve_s(&mat, &matWin, NULL, &ctx, &stalled);
+            // Time to tolerance, without the selection of the SpMV kernel cached after the first run
+            double    times[2]   = {MPI_Wtime() - start - timing_wall(TIMING_TUNE),
+                                    timing_wall(TIMING_ARNOLDI_SPMV) / timing_calls(TIMING_ARNOLDI_SPMV)};
+            long long iterations = timing_calls(TIMING_ITERATION);
+            MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            MPI_Allreduce(MPI_IN_PLACE, &iterations, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+            MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+
+            if (my_rank == 0)
+            {
+                fprintf(csv, "%s,%s,%d,%d,%d,%d,%s,%s,%d,%lld,%.6f,%.3f,%.6g\n",
+                        label, matrix_kind_name(kind), mat.nRow, mat.nNz,
+                        ctx.kryl, ctx.num,
+                        (ctx.backend == BACKEND_OPENCL) ? "opencl" : "cpu",
+                        isDouble ? "double" : "single", num_proc, iterations,
+                        times[0], spmvBytes / times[1] * 1e-9, error);
+                fflush(csv);
+            }
+        }
+        free_Matrix(&mat, &matWin);
+    }
+
+    if (my_rank == 0)
+    {
+        fclose(csv);
+    }
+    solver_release_s();
+    solver_release_d();
+    MPI_Comm_free(&solver_comm);
+    MPI_Comm_free(&node_comm);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
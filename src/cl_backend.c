@@ -0,0 +1,1005 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_backend.c
+ * \brief Backend running the solver on an OpenCL device with clSPARSE and the custom kernels
+ *
+ */
+
+#include "cl_backend.h"
+
+/// \brief Share of the device memory the planner allocates
+#define DEVICE_MEM_FRACTION 0.9
+/// \brief Most device blocks kept for the next solve
+#define KEPT_BLOCKS 16
+/// \brief Device copies of host columns: the vector orthogonalized, the one used and the next one
+#define STAGES 3
+
+typedef struct clBlock clBlock;
+
+/// \brief Device copy of a column kept in host memory
+typedef struct clStage{
+    /// Device buffer of one column
+    cldenseVector vec;
+    /// Block and column staged, \a block NULL if none
+    clBlock       *block;
+    int           col;
+    /// Upload on the copy queue the next command must wait for, NULL if none
+    cl_event      ready;
+    /// Last command of the solver using \a vec
+    cl_event      used;
+    /// Time of the last use, the oldest stage is reused first
+    unsigned      stamp;
+    /// Whether \a vec is newer than the host copy
+    int           dirty;
+}clStage;
+
+/// \brief Device columns of a block kept for a later solve of the same sizes
+typedef struct clKept{
+    cldenseMatrix mat;
+    cldenseVector *cols;
+    int           length;
+    int           count;
+    /// Solve which freed it
+    unsigned      solve;
+}clKept;
+
+/// \brief OpenCL objects kept from one solve to the next, until the last \a cl_backend_release()
+typedef struct clSession{
+    /// Number of \a cl_backend_acquire() not released
+    int                  holders;
+    /// Whether \a cl_init() was called
+    int                  open;
+    cl_platform_id       *platforms;
+    cl_device_id         *devices;
+    cl_context           context;
+    cl_command_queue     queue;
+    clsparseCreateResult createResult;
+    /// Queues of the streams, \a count 0 until a solve with a single rank per matrix
+    clQueuePool          pool;
+    cl_command_queue     copyQueue;
+    /// Blocks freed by the solves, reused by a later block of the same sizes
+    clKept               kept[KEPT_BLOCKS];
+    int                  nKept;
+    /// Number of solves so far
+    unsigned             solve;
+}clSession;
+
+/// \brief Device, context, compiled kernels and buffers shared by the solves of this precision, the
+///        kernels and clSPARSE being set up once per process
+static clSession session;
+
+/// \brief OpenCL objects of the session and the distributed matrix
+typedef struct clState{
+    cl_platform_id       *platforms;
+    cl_device_id         *devices;
+    cl_context           context;
+    cl_command_queue     queue;
+    clsparseCreateResult createResult;
+    distCsrMatrix        dm;
+    /// Queues of the streams, with a single rank per matrix only
+    clQueuePool          pool;
+    /// Whether the pool runs work not yet joined into \a queue
+    int                  forked;
+    /// Queue of the selected stream
+    cl_command_queue     current;
+    /// clSPARSE control of \a current
+    clsparseControl      control;
+    /// Rank of the run, rank 0 prints the reports
+    int                  rank;
+    /// Device memory the blocks may use, in bytes
+    size_t               budget;
+    /// Device memory used by the matrix and the blocks, in bytes
+    size_t               used;
+    /// Queue uploading the columns kept in host memory
+    cl_command_queue     copyQueue;
+    /// Stages of the host columns, one is filled while the others are used
+    clStage              stage[STAGES];
+    /// Length of the stages, 0 until a block spills
+    int                  stageLength;
+    /// Clock of \a clStage::stamp
+    unsigned             clock;
+    /// Last copy of a stage back to host memory
+    cl_event             writeback;
+    /// Segments of \a set_segments(), their first rows and the segment of each row; 0 until then
+    int                  segments;
+    cl_mem               segOffsets;
+    cl_mem               rowSegment;
+}clState;
+
+/// \brief Block of vectors on the device, see \a cl_init_vector_block()
+struct clBlock{
+    /// Columns \a nHost to \a count on the device
+    cldenseMatrix mat;
+    cldenseVector *cols;
+    int           length;
+    int           count;
+    /// Number of first columns kept in pinned host memory
+    int           nHost;
+    cl_mem        hostBuf;
+    real_t        *host;
+    /// Buffers of its orthonormalization, allocated by the first one
+    gramSchmidtWork gs;
+};
+
+/**
+ * \brief The vector \a x, which must be on the device
+ */
+static cldenseVector *column(
+        backendVec x)
+{
+    clBlock *b = x.block;
+    return b->cols + (x.col - b->nHost);
+}
+
+/**
+ * \brief The scalar \a s, an offset in the buffer of its block
+ */
+static clsparseScalar scalar(
+        backendScalar s)
+{
+    clBlock        *b = s.block;
+    clsparseScalar r;
+    clsparseInitScalar(&r);
+    r.value     = b->mat.values;
+    r.off_value = (size_t) s.col * b->mat.lead_dim + s.row;
+    return r;
+}
+
+/**
+ * \brief Stage holding column \a col of \a b, NULL if none
+ */
+static clStage *find_stage(
+        clState *s,
+        clBlock *b,
+        int     col)
+{
+    for (int i = 0; i < STAGES; ++i)
+    {
+        if (s->stage[i].block == b && s->stage[i].col == col)
+        {
+            return s->stage + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Copy the stage \a st back to its host column if it was written
+ */
+static void write_back(
+        clState *s,
+        clStage *st)
+{
+    if (!st->dirty)
+    {
+        return;
+    }
+    // A written stage was released, after its last use on whichever queue
+    clBlock *b = st->block;
+    clEnqueueReadBuffer(s->current, st->vec.values, CL_FALSE, 0, b->length * sizeof(real_t),
+            b->host + (size_t) st->col * b->length, 1, &st->used, NULL);
+    if (s->writeback != NULL) clReleaseEvent(s->writeback);
+    clEnqueueMarkerWithWaitList(s->current, 0, NULL, &s->writeback);
+    st->dirty = 0;
+}
+
+/**
+ * \brief Copy column \a col of \a b from host memory to the oldest stage on the copy queue
+ *
+ * The column left in the stage is copied back first if it was written. The
+ * copy waits for the last use of the stage and for the pending copies back
+ * to host memory.
+ */
+static clStage *upload(
+        clState *s,
+        clBlock *b,
+        int     col,
+        int     load)
+{
+    clStage *st = s->stage;
+    for (int i = 1; i < STAGES; ++i)
+    {
+        if (s->stage[i].stamp < st->stamp) st = s->stage + i;
+    }
+    if (st->block != NULL) write_back(s, st);
+    st->block = b;
+    st->col   = col;
+    st->stamp = ++s->clock;
+    if (!load)
+    {
+        return st;
+    }
+
+    cl_event wait[2];
+    cl_uint  nWait = 0;
+    if (st->used != NULL) wait[nWait++] = st->used;
+    if (s->writeback != NULL) wait[nWait++] = s->writeback;
+    if (st->ready != NULL) clReleaseEvent(st->ready);
+    clEnqueueWriteBuffer(s->copyQueue, st->vec.values, CL_FALSE, 0, b->length * sizeof(real_t),
+            b->host + (size_t) col * b->length, nWait, wait, &st->ready);
+    clFlush(s->copyQueue);
+    return st;
+}
+
+/**
+ * \brief Device vector of \a x, staged if kept in host memory, with its values if \a load
+ */
+static cldenseVector *acquire(
+        clState    *s,
+        backendVec x,
+        int        load)
+{
+    clBlock *b = x.block;
+    if (x.col >= b->nHost)
+    {
+        return column(x);
+    }
+    clStage *st = find_stage(s, b, x.col);
+    if (st == NULL)
+    {
+        st = upload(s, b, x.col, load);
+    }
+    st->stamp = ++s->clock;
+    if (st->ready != NULL)
+    {
+        clEnqueueBarrierWithWaitList(s->current, 1, &st->ready, NULL);
+        clReleaseEvent(st->ready);
+        st->ready = NULL;
+    }
+    return &st->vec;
+}
+
+/**
+ * \brief End of the use of \a x by the last enqueued command, written by it if \a dirty
+ *
+ * A written stage is only copied back to host memory when it is reused,
+ * read, or by \a cl_backend_normalize() once the vector is complete.
+ */
+static void release(
+        clState    *s,
+        backendVec x,
+        int        dirty)
+{
+    clBlock *b = x.block;
+    if (x.col >= b->nHost)
+    {
+        return;
+    }
+    clStage *st = find_stage(s, b, x.col);
+    st->dirty |= dirty;
+    if (st->used != NULL) clReleaseEvent(st->used);
+    clEnqueueMarkerWithWaitList(s->current, 0, NULL, &st->used);
+}
+
+/**
+ * \brief Start the upload of the column after \a x while \a x is used
+ */
+static void prefetch(
+        clState    *s,
+        backendVec x)
+{
+    clBlock *b = x.block;
+    if (x.col + 1 < b->nHost && find_stage(s, b, x.col + 1) == NULL)
+    {
+        upload(s, b, x.col + 1, 1);
+    }
+}
+
+/**
+ * \brief Index of a kept block of \a count vectors of \a length values, -1 if none
+ */
+static int find_kept(
+        int length,
+        int count)
+{
+    for (int i = 0; count > 0 && i < session.nKept; ++i)
+    {
+        if (session.kept[i].length == length && session.kept[i].count == count)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * \brief Release the kept blocks freed before the solve \a solve
+ */
+static void release_kept(
+        unsigned solve)
+{
+    for (int i = 0; i < session.nKept; )
+    {
+        if (session.kept[i].solve < solve)
+        {
+            cl_free_vector_block(&session.kept[i].mat, session.kept[i].cols);
+            free(session.kept[i].cols);
+            session.kept[i] = session.kept[--session.nKept];
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+/**
+ * \brief Allocate \a count device vectors set to zero, reusing a kept block of the same sizes, exits if they do not fit
+ */
+static void alloc_device_columns(
+        clState *s,
+        clBlock *b,
+        int     count)
+{
+    int kept = find_kept(b->length, count);
+    if (kept >= 0)
+    {
+        b->mat  = session.kept[kept].mat;
+        b->cols = session.kept[kept].cols;
+        session.kept[kept] = session.kept[--session.nKept];
+    }
+    else
+    {
+        b->cols = malloc((count > 0 ? count : 1) * sizeof(cldenseVector));
+        if (count == 0)
+        {
+            cldenseInitMatrix(&b->mat);
+            return;
+        }
+        cl_int cl_status = cl_init_vector_block(s->context, s->devices[0], b->length, count, &b->mat, b->cols);
+        if (cl_status != CL_SUCCESS)
+        {
+            fprintf(stderr, "[CRITICAL ERROR] Could not allocate %d vectors of %d values on the device (status %d)\n",
+                    count, b->length, cl_status);
+            exit(EXIT_FAILURE);
+        }
+    }
+    s->used += (size_t) b->mat.lead_dim * count * sizeof(real_t);
+
+    real_t zero = 0.0;
+    clEnqueueFillBuffer(s->current, b->mat.values, &zero, sizeof(real_t), 0,
+            (size_t) b->mat.lead_dim * count * sizeof(real_t), 0, NULL, NULL);
+}
+
+static void *cl_create_block(
+        void *state,
+        int  length,
+        int  count)
+{
+    clBlock *b = calloc(1, sizeof(clBlock));
+    b->length = length;
+    b->count  = count;
+    alloc_device_columns(state, b, count);
+    return b;
+}
+
+static void *cl_create_basis(
+        void *state,
+        int  length,
+        int  count)
+{
+    clState *s = state;
+    clBlock *b = calloc(1, sizeof(clBlock));
+    b->length = length;
+    b->count  = count;
+    if (find_kept(length, count) >= 0)
+    {
+        alloc_device_columns(s, b, count);
+        return b;
+    }
+    // Allocated last, the blocks of the previous solves not reused by now only take its place
+    release_kept(session.solve);
+
+    // The columns that do not fit stay on the host, the stages on the device replace them
+    size_t column   = (size_t) length * sizeof(real_t);
+    size_t free     = (s->budget > s->used) ? s->budget - s->used : 0;
+    int    resident = (free / column >= (size_t) count) ? count : (int) (free / column);
+    if (resident < count)
+    {
+        resident = (resident > STAGES) ? resident - STAGES : 0;
+        if (free < STAGES * column)
+        {
+            fprintf(stderr, "[CRITICAL ERROR] Not enough device memory for %d vectors of %d values\n", STAGES, length);
+            exit(EXIT_FAILURE);
+        }
+        b->nHost = count - resident;
+
+        cl_int cl_status;
+        b->hostBuf = clCreateBuffer(s->context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                (size_t) b->nHost * column, NULL, &cl_status);
+        double waited = MPI_Wtime();
+        b->host = clEnqueueMapBuffer(s->queue, b->hostBuf, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0,
+                (size_t) b->nHost * column, 0, NULL, NULL, &cl_status);
+        timing_trace("map host block", TRACE_WAITS, waited, MPI_Wtime());
+        if (cl_status != CL_SUCCESS)
+        {
+            fprintf(stderr, "[CRITICAL ERROR] Could not allocate %d vectors of %d values in pinned host memory\n",
+                    b->nHost, length);
+            exit(EXIT_FAILURE);
+        }
+        memset(b->host, 0, (size_t) b->nHost * column);
+
+        if (s->stageLength < length)
+        {
+            for (int i = 0; i < STAGES; ++i)
+            {
+                if (s->stageLength > 0)
+                {
+                    clReleaseMemObject(s->stage[i].vec.values);
+                }
+                clsparseInitVector(&s->stage[i].vec);
+                s->stage[i].vec.values = clCreateBuffer(s->context, CL_MEM_READ_WRITE, column, NULL, &cl_status);
+            }
+            s->stageLength = length;
+        }
+        for (int i = 0; i < STAGES; ++i)
+        {
+            s->stage[i].vec.num_values = length;
+            s->stage[i].block = NULL;
+            s->stage[i].dirty = 0;
+        }
+    }
+    alloc_device_columns(s, b, resident);
+
+    if (s->rank == 0)
+    {
+        printf("P%d: device memory %.1f of %.1f MiB, %d of %d basis vectors in host memory\n", s->rank,
+                s->used / 1048576.0, s->budget / 1048576.0, b->nHost, count);
+    }
+    return b;
+}
+
+static void cl_free_block(
+        void *state,
+        void *block)
+{
+    clState *s = state;
+    clBlock *b = block;
+    clFinish(s->current);
+    gram_schmidt_free_work(&b->gs);
+    if (b->nHost > 0)
+    {
+        clFinish(s->copyQueue);
+        for (int i = 0; i < STAGES; ++i)
+        {
+            if (s->stage[i].block == b)
+            {
+                s->stage[i].block = NULL;
+                s->stage[i].dirty = 0;
+            }
+        }
+        clEnqueueUnmapMemObject(s->queue, b->hostBuf, b->host, 0, NULL, NULL);
+        clFinish(s->queue);
+        clReleaseMemObject(b->hostBuf);
+    }
+    if (b->count > b->nHost)
+    {
+        s->used -= (size_t) b->mat.lead_dim * (b->count - b->nHost) * sizeof(real_t);
+    }
+    // Kept for the next solve unless some of its columns are on the host
+    if (b->nHost == 0 && b->count > 0 && session.nKept < KEPT_BLOCKS)
+    {
+        clKept *k = session.kept + session.nKept++;
+        k->mat    = b->mat;
+        k->cols   = b->cols;
+        k->length = b->length;
+        k->count  = b->count;
+        k->solve  = session.solve;
+        free(b);
+        return;
+    }
+    if (b->count > b->nHost)
+    {
+        cl_free_vector_block(&b->mat, b->cols);
+    }
+    free(b->cols);
+    free(b);
+}
+
+static void cl_write_vector(
+        void         *state,
+        backendVec   x,
+        const real_t *values)
+{
+    clState *s = state;
+    clBlock *b = x.block;
+    if (x.col < b->nHost)
+    {
+        // The host copy is read by the uploads of the copy queue and written by the copies back
+        clFinish(s->copyQueue);
+        clFinish(s->current);
+        memcpy(b->host + (size_t) x.col * b->length, values, b->length * sizeof(real_t));
+        clStage *st = find_stage(s, b, x.col);
+        if (st != NULL)
+        {
+            st->block = NULL;
+            st->dirty = 0;
+        }
+        return;
+    }
+    cldenseVector *v = column(x);
+    clEnqueueWriteBuffer(s->current, v->values, CL_TRUE, 0, v->num_values * sizeof(real_t),
+            values, 0, NULL, NULL);
+}
+
+static void cl_read_vector(
+        void       *state,
+        backendVec x,
+        real_t     *values)
+{
+    clState *s = state;
+    clBlock *b = x.block;
+    double waited = MPI_Wtime();
+    if (x.col < b->nHost)
+    {
+        clStage *st = find_stage(s, b, x.col);
+        if (st != NULL) write_back(s, st);
+        clFinish(s->current);
+        memcpy(values, b->host + (size_t) x.col * b->length, b->length * sizeof(real_t));
+    }
+    else
+    {
+        cldenseVector *v = column(x);
+        clEnqueueReadBuffer(s->current, v->values, CL_TRUE, 0, v->num_values * sizeof(real_t),
+                values, 0, NULL, NULL);
+    }
+    timing_trace("read vector", TRACE_WAITS, waited, MPI_Wtime());
+}
+
+static real_t cl_read_scalar(
+        void          *state,
+        backendScalar s)
+{
+    clsparseScalar r = scalar(s);
+    real_t         value;
+    double         waited = MPI_Wtime();
+    clEnqueueReadBuffer(((clState*) state)->current, r.value, CL_TRUE, r.off_value * sizeof(real_t), sizeof(real_t),
+            &value, 0, NULL, NULL);
+    timing_trace("read scalar", TRACE_WAITS, waited, MPI_Wtime());
+    return value;
+}
+
+static void cl_backend_spmv(
+        void       *state,
+        backendVec x,
+        backendVec y)
+{
+    clState *s = state;
+    cldenseVector *vx = acquire(s, x, 1);
+    cldenseVector *vy = acquire(s, y, 0);
+    dist_spmv(&s->dm, vx, vy, s->current, s->control);
+    release(s, x, 0);
+    release(s, y, 1);
+}
+
+static void cl_backend_nrm2(
+        void          *state,
+        backendScalar r,
+        backendVec    x)
+{
+    clState        *s = state;
+    clsparseScalar result = scalar(r);
+    dist_nrm2(&s->dm, &result, acquire(s, x, 1), s->current, s->control);
+    release(s, x, 0);
+}
+
+static void cl_backend_axpy(
+        void          *state,
+        backendScalar alpha,
+        real_t        sign,
+        backendVec    x,
+        backendVec    y)
+{
+    clState        *s = state;
+    clsparseScalar a  = scalar(alpha);
+    cldenseVector  *vx = acquire(s, x, 1);
+    cldenseVector  *vy = acquire(s, y, 1);
+    cl_kernel_axpy(s->current, vy, &a, sign, vx);
+    release(s, x, 0);
+    release(s, y, 1);
+}
+
+static void cl_backend_dot_axpy(
+        void          *state,
+        backendScalar h,
+        backendVec    q,
+        backendVec    w)
+{
+    clState        *s = state;
+    clsparseScalar coef = scalar(h);
+    cldenseVector  *vw = acquire(s, w, 1);
+    cldenseVector  *vq = acquire(s, q, 1);
+    cl_kernel_dot_axpy(s->current, &coef, vq, vw);
+    release(s, q, 0);
+    release(s, w, 1);
+    // The orthogonalization runs through the basis in order, w keeps its own stage until normalized
+    prefetch(s, q);
+}
+
+static void cl_backend_normalize(
+        void          *state,
+        backendScalar nrm,
+        backendVec    x)
+{
+    clState        *s = state;
+    clsparseScalar norm = scalar(nrm);
+    cl_kernel_normalize(s->current, &norm, acquire(s, x, 1));
+    release(s, x, 1);
+    // The vector is complete, copied back once
+    clStage *st = find_stage(s, x.block, x.col);
+    if (st != NULL) write_back(s, st);
+}
+
+static void cl_backend_gemm(
+        void *state,
+        void *A,
+        void *B,
+        void *C)
+{
+    clState *s = state;
+    clBlock *a = A, *b = B, *c = C;
+    int     inner = b->length;
+
+    // Device columns first, then the columns in host memory one at a time
+    int resident = inner - a->nHost;
+    cl_kernel_gemm(s->current, &a->mat, &b->mat, a->nHost, (resident > 0) ? resident : 0, &c->mat);
+    for (int i = 0; i < a->nHost && i < inner; ++i)
+    {
+        backendVec ai = {A, i};
+        cl_kernel_ger_row(s->current, acquire(s, ai, 1), &b->mat, i, &c->mat);
+        release(s, ai, 0);
+        if (i + 1 < inner) prefetch(s, ai);
+    }
+}
+
+static void cl_backend_orthonormalize(
+        void *state,
+        void *block)
+{
+    clState *s = state;
+    clBlock *b = block;
+    int     n  = b->mat.num_cols;
+    if (b->gs.n != n)
+    {
+        gram_schmidt_free_work(&b->gs);
+        cl_int cl_status = gram_schmidt_init_work(&b->gs, s->context, n);
+        if (cl_status != CL_SUCCESS)
+        {
+            fprintf(stderr, "[CRITICAL ERROR] Could not allocate the Gram matrix of %d vectors on the device (status %d)\n",
+                    n, cl_status);
+            exit(EXIT_FAILURE);
+        }
+    }
+    gram_schmidt(&b->mat, &b->gs, s->current);
+}
+
+static void cl_set_segments(
+        void      *state,
+        int       count,
+        const int *offsets)
+{
+    clState *s = state;
+    int     n  = offsets[count];
+    int     *segment = malloc((n > 0 ? n : 1) * sizeof(int));
+    for (int g = 0; g < count; ++g)
+    {
+        for (int i = offsets[g]; i < offsets[g + 1]; ++i) segment[i] = g;
+    }
+    if (s->segments > 0)
+    {
+        clReleaseMemObject(s->segOffsets);
+        clReleaseMemObject(s->rowSegment);
+    }
+    cl_int cl_status;
+    s->segOffsets = clCreateBuffer(s->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            (count + 1) * sizeof(int), (void*) offsets, &cl_status);
+    if (cl_status == CL_SUCCESS)
+    {
+        s->rowSegment = clCreateBuffer(s->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                (n > 0 ? n : 1) * sizeof(int), segment, &cl_status);
+    }
+    if (cl_status != CL_SUCCESS)
+    {
+        fprintf(stderr, "[CRITICAL ERROR] Could not allocate the offsets of %d segments on the device (status %d)\n",
+                count, cl_status);
+        exit(EXIT_FAILURE);
+    }
+    free(segment);
+    s->segments = count;
+    s->used    += (size_t) (count + 1 + n) * sizeof(int);
+}
+
+static void cl_seg_dot_axpy(
+        void          *state,
+        backendScalar h,
+        int           stride,
+        backendVec    q,
+        backendVec    w)
+{
+    clState        *s = state;
+    clsparseScalar coef = scalar(h);
+    cldenseVector  *vw = acquire(s, w, 1);
+    cldenseVector  *vq = acquire(s, q, 1);
+    cl_kernel_seg_dot_axpy(s->current, s->segOffsets, s->segments, &coef, stride, vq, vw);
+    release(s, q, 0);
+    release(s, w, 1);
+    // As cl_backend_dot_axpy()
+    prefetch(s, q);
+}
+
+static void cl_seg_normalize(
+        void          *state,
+        backendScalar nrm,
+        int           stride,
+        backendVec    x)
+{
+    clState        *s = state;
+    clsparseScalar norm = scalar(nrm);
+    cl_kernel_seg_normalize(s->current, s->segOffsets, s->segments, &norm, stride, acquire(s, x, 1));
+    release(s, x, 1);
+    clStage *st = find_stage(s, x.block, x.col);
+    if (st != NULL) write_back(s, st);
+}
+
+static void cl_seg_gemm(
+        void *state,
+        void *A,
+        void *B,
+        void *C)
+{
+    clState *s = state;
+    clBlock *a = A, *b = B, *c = C;
+    int     inner = b->length / s->segments;
+
+    // Same order as cl_backend_gemm(), the row of B of each segment picked per row of C
+    int resident = inner - a->nHost;
+    cl_kernel_seg_gemm(s->current, s->rowSegment, &a->mat, &b->mat, a->nHost, (resident > 0) ? resident : 0,
+            inner, &c->mat);
+    for (int i = 0; i < a->nHost && i < inner; ++i)
+    {
+        backendVec ai = {A, i};
+        cl_kernel_seg_ger_row(s->current, s->rowSegment, acquire(s, ai, 1), &b->mat, i, inner, &c->mat);
+        release(s, ai, 0);
+        if (i + 1 < inner) prefetch(s, ai);
+    }
+}
+
+static int cl_set_spmv_variant(
+        void *state,
+        int  variant)
+{
+    clState *s = state;
+    int status = dist_set_spmv_variant(&s->dm, variant, s->context, s->current);
+    // The products timed by the autotuner are not part of the run
+    dist_reset_overlap(&s->dm);
+    return status;
+}
+
+static void cl_set_stream(
+        void *state,
+        int  stream)
+{
+    clState *s = state;
+    // The halo buffers of the distributed product are shared, a single queue then,
+    // and so are the carries of the merge-path product
+    if (s->dm.num_ranks > 1
+            || (s->dm.stencil == NULL && s->dm.interiorSpmv.variant == CL_SPMV_MERGE_PATH))
+    {
+        return;
+    }
+    if (stream == BACKEND_MAIN_STREAM)
+    {
+        if (s->forked)
+        {
+            cl_queue_pool_join(&s->pool, s->queue);
+            s->forked = 0;
+        }
+        s->current = s->queue;
+        s->control = s->createResult.control;
+        return;
+    }
+    if (!s->forked)
+    {
+        cl_queue_pool_fork(&s->pool, s->queue);
+        s->forked = 1;
+    }
+    s->current = s->pool.queues[stream % s->pool.count];
+    s->control = s->pool.controls[stream % s->pool.count].control;
+}
+
+static void cl_finish(
+        void *state)
+{
+    double waited = MPI_Wtime();
+    clFinish(((clState*) state)->current);
+    timing_trace("clFinish", TRACE_WAITS, waited, MPI_Wtime());
+    cl_kernels_collect_timings();
+}
+
+static void cl_report(
+        void       *state,
+        const char *label,
+        int        total)
+{
+    clState *s = state;
+    if (s->dm.num_ranks > 1)
+    {
+        dist_print_overlap(&s->dm, label, total);
+    }
+}
+
+static void cl_backend_free(
+        void *state)
+{
+    clState *s = state;
+    clFinish(s->copyQueue);
+    for (int i = 0; i < STAGES; ++i)
+    {
+        if (s->stageLength > 0) clReleaseMemObject(s->stage[i].vec.values);
+        if (s->stage[i].ready != NULL) clReleaseEvent(s->stage[i].ready);
+        if (s->stage[i].used != NULL) clReleaseEvent(s->stage[i].used);
+    }
+    if (s->writeback != NULL) clReleaseEvent(s->writeback);
+    if (s->segments > 0)
+    {
+        clReleaseMemObject(s->segOffsets);
+        clReleaseMemObject(s->rowSegment);
+    }
+    dist_free_matrix(&s->dm);
+    // The blocks of the previous solves this one did not reuse will not be either
+    clFinish(s->queue);
+    release_kept(session.solve);
+    free(s);
+}
+
+void cl_backend_acquire()
+{
+    session.holders++;
+}
+
+void cl_backend_release()
+{
+    if (session.holders > 0 && --session.holders > 0)
+    {
+        return;
+    }
+    if (!session.open)
+    {
+        return;
+    }
+    release_kept(session.solve + 1);
+    clReleaseCommandQueue(session.copyQueue);
+    if (session.pool.count > 0)
+    {
+        cl_free_queue_pool(&session.pool);
+    }
+    cl_free(session.platforms, session.devices, session.context, session.queue, session.createResult);
+    memset(&session, 0, sizeof(session));
+}
+
+void cl_backend_init(
+        solverBackend       *backend,
+        csrMatrix           *mat,
+        MPI_Win             *matWin,
+        const int           *rowOffsets,
+        const solverContext *ctx)
+{
+    clState *s = malloc(sizeof(clState));
+    if (!session.open)
+    {
+        cl_init(&session.platforms, &session.devices, &session.context, &session.queue, &session.createResult,
+                ctx->node_comm, ctx->devices);
+        session.copyQueue = clCreateCommandQueue(session.context, session.devices[0], 0, NULL);
+        session.open      = 1;
+    }
+    session.solve++;
+    s->platforms    = session.platforms;
+    s->devices      = session.devices;
+    s->context      = session.context;
+    s->queue        = session.queue;
+    s->createResult = session.createResult;
+    s->copyQueue    = session.copyQueue;
+
+    double start = MPI_Wtime();
+    dist_init_matrix(mat, &s->dm, ctx->solver_comm, rowOffsets, s->context, s->queue, s->createResult.control);
+    clFinish(s->queue);
+    if (ctx->my_rank == 0)
+    {
+        printf("P%d: matrix uploaded in %.3f ms\n", ctx->my_rank, 1e3 * (MPI_Wtime() - start));
+    }
+    char device[128];
+    clGetDeviceInfo(s->devices[0], CL_DEVICE_NAME, sizeof(device), device, NULL);
+    backend->fingerprint = matrix_fingerprint(mat, s->dm.rowStart, s->dm.nLocal, device);
+    // Only the device copy is used from now on, unless solved again
+    if (!ctx->keepMatrix)
+    {
+        free_Matrix(mat, matWin);
+    }
+    if (s->dm.num_ranks > 1)
+    {
+        dist_print_halo(&s->dm);
+    }
+    cl_kernels_set_comm(ctx->solver_comm);
+    if (ctx->my_rank == 0 && s->dm.stencil == NULL)
+    {
+        cl_print_matrix(&s->dm.local.interior, s->queue);
+    }
+    if (s->dm.num_ranks == 1 && session.pool.count == 0)
+    {
+        cl_init_queue_pool(s->context, s->devices[0], QUEUE_POOL_SIZE, &session.pool);
+    }
+    s->pool    = session.pool;
+    s->forked  = 0;
+    s->current = s->queue;
+    s->control = s->createResult.control;
+    s->rank    = ctx->my_rank;
+
+    // Memory planner: what the matrix and the exchange plan use is not available to the blocks
+    cl_ulong memory;
+    clGetDeviceInfo(s->devices[0], CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &memory, NULL);
+    const char *limit = getenv("SIMULTITE_DEVICE_MEMORY");
+    if (limit != NULL)
+    {
+        memory = (cl_ulong) atol(limit) << 20;
+    }
+    s->budget = (size_t) (DEVICE_MEM_FRACTION * memory);
+    s->used   = (s->dm.stencil != NULL) ? 0
+              : (size_t) (s->dm.local.interior.num_nonzeros + s->dm.nRemoteNz) * (sizeof(int) + sizeof(real_t))
+              + (size_t) (s->dm.nLocal + s->dm.local.nBoundary + 2) * sizeof(int)
+              + (size_t) (s->dm.nSend + s->dm.nGhost + s->dm.local.nBoundary) * sizeof(real_t);
+    s->stageLength = 0;
+    s->clock       = 0;
+    s->writeback   = NULL;
+    s->segments    = 0;
+    for (int i = 0; i < STAGES; ++i)
+    {
+        s->stage[i].block = NULL;
+        s->stage[i].ready = NULL;
+        s->stage[i].used  = NULL;
+        s->stage[i].stamp = 0;
+        s->stage[i].dirty = 0;
+    }
+
+    backend->name             = "opencl";
+    backend->state            = s;
+    backend->n                = s->dm.nLocal;
+    backend->rowStart         = s->dm.rowStart;
+    if (s->dm.stencil != NULL)
+    {
+        csrMatrix op;
+        stencil_matrix(s->dm.stencil, &op);
+        backend->spmvFlops    = 2.0 * op.nNz;
+        backend->spmvBytes    = 2.0 * op.nRow * sizeof(real_t);
+    }
+    else
+    {
+        const double nnz      = (double) s->dm.local.interior.num_nonzeros + s->dm.nRemoteNz;
+        backend->spmvFlops    = 2.0 * nnz;
+        backend->spmvBytes    = nnz * (sizeof(real_t) + sizeof(int)) + (s->dm.nLocal + 1.0) * sizeof(int)
+                              + (2.0 * s->dm.nLocal + s->dm.nGhost) * sizeof(real_t);
+    }
+    backend->num_variants     = (s->dm.stencil != NULL) ? 1 : CL_SPMV_NUM_VARIANTS;
+    backend->variant_names    = (s->dm.stencil != NULL) ? stencil_variant_names : cl_spmv_variant_names;
+    backend->create_block     = cl_create_block;
+    backend->create_basis     = cl_create_basis;
+    backend->free_block       = cl_free_block;
+    backend->write_vector     = cl_write_vector;
+    backend->read_vector      = cl_read_vector;
+    backend->read_scalar      = cl_read_scalar;
+    backend->spmv             = cl_backend_spmv;
+    backend->nrm2             = cl_backend_nrm2;
+    backend->axpy             = cl_backend_axpy;
+    backend->dot_axpy         = cl_backend_dot_axpy;
+    backend->normalize        = cl_backend_normalize;
+    backend->gemm             = cl_backend_gemm;
+    backend->orthonormalize   = cl_backend_orthonormalize;
+    backend->set_segments     = cl_set_segments;
+    backend->seg_dot_axpy     = cl_seg_dot_axpy;
+    backend->seg_normalize    = cl_seg_normalize;
+    backend->seg_gemm         = cl_seg_gemm;
+    backend->set_spmv_variant = cl_set_spmv_variant;
+    backend->set_stream       = cl_set_stream;
+    backend->finish           = cl_finish;
+    backend->report           = cl_report;
+    backend->free             = cl_backend_free;
+}
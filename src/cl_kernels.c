@@ -0,0 +1,1127 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_kernels.c
+ * \brief Custom OpenCL kernels for the operations clSPARSE does not provide
+ *
+ */
+
+#include "cl_kernels.h"
+#include "cl_utils.h"
+
+/// \brief Source of the custom kernels, compiled with -DDOUBLE_PRECISION when needed
+static const char *kernels_source =
+"#ifdef DOUBLE_PRECISION\n"
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+"typedef double real_t;\n"
+"#else\n"
+"typedef float real_t;\n"
+"#endif\n"
+"\n"
+"__kernel void gram(const uint rows, const uint cols, const uint ld,\n"
+"        __global const real_t *V, const ulong offV,\n"
+"        __global real_t *G, __local real_t *scratch)\n"
+"{\n"
+"    const uint i = get_group_id(0);\n"
+"    const uint j = get_group_id(1);\n"
+"    const uint lid = get_local_id(0);\n"
+"    const uint wg = get_local_size(0);\n"
+"    if (j < i) return;\n"
+"    __global const real_t *vi = V + offV + i * ld;\n"
+"    __global const real_t *vj = V + offV + j * ld;\n"
+"    real_t s = 0;\n"
+"    for (uint r = lid; r < rows; r += wg) s += vi[r] * vj[r];\n"
+"    scratch[lid] = s;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint o = wg / 2; o > 0; o >>= 1)\n"
+"    {\n"
+"        if (lid < o) scratch[lid] += scratch[lid + o];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    if (lid == 0)\n"
+"    {\n"
+"        G[i * cols + j] = scratch[0];\n"
+"        G[j * cols + i] = scratch[0];\n"
+"    }\n"
+"}\n"
+"\n"
+"real_t reduce_partials(__global const real_t *partials, const uint np,\n"
+"        __local real_t *scratch)\n"
+"{\n"
+"    const uint lid = get_local_id(0);\n"
+"    scratch[lid] = (lid < np) ? partials[lid] : 0;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint o = get_local_size(0) / 2; o > 0; o >>= 1)\n"
+"    {\n"
+"        if (lid < o) scratch[lid] += scratch[lid + o];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    return scratch[0];\n"
+"}\n"
+"\n"
+"__kernel void partial_dot(const uint n,\n"
+"        __global const real_t *x, const ulong offx,\n"
+"        __global const real_t *y, const ulong offy,\n"
+"        __global real_t *partials, __local real_t *scratch)\n"
+"{\n"
+"    const uint lid = get_local_id(0);\n"
+"    real_t s = 0;\n"
+"    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) s += x[offx + i] * y[offy + i];\n"
+"    scratch[lid] = s;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint o = get_local_size(0) / 2; o > 0; o >>= 1)\n"
+"    {\n"
+"        if (lid < o) scratch[lid] += scratch[lid + o];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    if (lid == 0) partials[get_group_id(0)] = scratch[0];\n"
+"}\n"
+"\n"
+"__kernel void dot_axpy(const uint n,\n"
+"        __global real_t *w, const ulong offw,\n"
+"        __global const real_t *q, const ulong offq,\n"
+"        __global const real_t *partials, const uint np,\n"
+"        __global real_t *h, const ulong offh, __local real_t *scratch)\n"
+"{\n"
+"    const real_t dot = reduce_partials(partials, np, scratch);\n"
+"    if (get_global_id(0) == 0) h[offh] = dot;\n"
+"    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) w[offw + i] -= dot * q[offq + i];\n"
+"}\n"
+"\n"
+"__kernel void normalize(const uint n,\n"
+"        __global real_t *x, const ulong offx,\n"
+"        __global const real_t *partials, const uint np,\n"
+"        __global real_t *nrm, const ulong offn, __local real_t *scratch)\n"
+"{\n"
+"    const real_t norm = sqrt(reduce_partials(partials, np, scratch));\n"
+"    if (get_global_id(0) == 0) nrm[offn] = norm;\n"
+"    const real_t inv = 1 / norm;\n"
+"    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) x[offx + i] *= inv;\n"
+"}\n"
+"\n"
+"__kernel void axpy(const uint n,\n"
+"        __global real_t *y, const ulong offy,\n"
+"        __global const real_t *x, const ulong offx,\n"
+"        __global const real_t *alpha, const ulong offa, const real_t sign)\n"
+"{\n"
+"    const real_t a = sign * alpha[offa];\n"
+"    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) y[offy + i] += a * x[offx + i];\n"
+"}\n"
+"\n"
+"__kernel void gather(const uint n, __global real_t *dst,\n"
+"        __global const int *idx, __global const real_t *src, const ulong offsrc)\n"
+"{\n"
+"    const uint i = get_global_id(0);\n"
+"    if (i < n) dst[i] = src[offsrc + idx[i]];\n"
+"}\n"
+"\n"
+"__kernel void scatter_add(const uint n, __global real_t *dst, const ulong offdst,\n"
+"        __global const int *idx, __global const real_t *src)\n"
+"{\n"
+"    const uint i = get_global_id(0);\n"
+"    if (i < n) dst[offdst + idx[i]] += src[i];\n"
+"}\n"
+"\n"
+"__kernel void trsm(const uint rows, const uint cols, const uint ld,\n"
+"        __global real_t *V, const ulong offV, __global const real_t *R)\n"
+"{\n"
+"    const uint r = get_global_id(0);\n"
+"    if (r >= rows) return;\n"
+"    __global real_t *v = V + offV + r;\n"
+"    for (uint i = 0; i < cols; ++i)\n"
+"    {\n"
+"        real_t acc = v[i * ld];\n"
+"        for (uint j = 0; j < i; ++j) acc -= v[j * ld] * R[j * cols + i];\n"
+"        v[i * ld] = acc / R[i * cols + i];\n"
+"    }\n"
+"}\n"
+"\n"
+"__kernel void gemm(const uint rows, const uint inner,\n"
+"        __global const real_t *A, const uint lda,\n"
+"        __global const real_t *B, const uint offb, const uint ldb,\n"
+"        __global real_t *C, const uint ldc)\n"
+"{\n"
+"    const uint r = get_global_id(0);\n"
+"    const uint c = get_global_id(1);\n"
+"    if (r >= rows) return;\n"
+"    real_t s = 0;\n"
+"    for (uint i = 0; i < inner; ++i) s += A[i * lda + r] * B[c * ldb + offb + i];\n"
+"    C[c * ldc + r] = s;\n"
+"}\n"
+"\n"
+"__kernel void ger_row(const uint rows,\n"
+"        __global const real_t *a, const ulong offa,\n"
+"        __global const real_t *B, const uint row, const uint ldb,\n"
+"        __global real_t *C, const uint ldc)\n"
+"{\n"
+"    const uint r = get_global_id(0);\n"
+"    const uint c = get_global_id(1);\n"
+"    if (r >= rows) return;\n"
+"    C[c * ldc + r] += a[offa + r] * B[c * ldb + row];\n"
+"}\n"
+"\n"
+"real_t reduce_segment(__global const real_t *x, const ulong offx,\n"
+"        __global const real_t *y, const ulong offy, const uint first, const uint last,\n"
+"        __local real_t *scratch)\n"
+"{\n"
+"    const uint lid = get_local_id(0);\n"
+"    real_t s = 0;\n"
+"    for (uint i = first + lid; i < last; i += get_local_size(0)) s += x[offx + i] * y[offy + i];\n"
+"    scratch[lid] = s;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint o = get_local_size(0) / 2; o > 0; o >>= 1)\n"
+"    {\n"
+"        if (lid < o) scratch[lid] += scratch[lid + o];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    return scratch[0];\n"
+"}\n"
+"\n"
+"__kernel void seg_dot_axpy(__global const int *offsets,\n"
+"        __global real_t *w, const ulong offw,\n"
+"        __global const real_t *q, const ulong offq,\n"
+"        __global real_t *h, const ulong offh, const uint stride, __local real_t *scratch)\n"
+"{\n"
+"    const uint g = get_group_id(0);\n"
+"    const uint first = offsets[g];\n"
+"    const uint last = offsets[g + 1];\n"
+"    const real_t dot = reduce_segment(q, offq, w, offw, first, last, scratch);\n"
+"    if (get_local_id(0) == 0) h[offh + g * stride] = dot;\n"
+"    for (uint i = first + get_local_id(0); i < last; i += get_local_size(0)) w[offw + i] -= dot * q[offq + i];\n"
+"}\n"
+"\n"
+"__kernel void seg_normalize(__global const int *offsets,\n"
+"        __global real_t *x, const ulong offx,\n"
+"        __global real_t *nrm, const ulong offn, const uint stride, __local real_t *scratch)\n"
+"{\n"
+"    const uint g = get_group_id(0);\n"
+"    const uint first = offsets[g];\n"
+"    const uint last = offsets[g + 1];\n"
+"    const real_t norm = sqrt(reduce_segment(x, offx, x, offx, first, last, scratch));\n"
+"    if (get_local_id(0) == 0) nrm[offn + g * stride] = norm;\n"
+"    const real_t inv = (norm > 0) ? 1 / norm : 0;\n"
+"    for (uint i = first + get_local_id(0); i < last; i += get_local_size(0)) x[offx + i] *= inv;\n"
+"}\n"
+"\n"
+"__kernel void seg_gemm(const uint rows, const uint inner,\n"
+"        __global const real_t *A, const uint lda, __global const int *segment,\n"
+"        __global const real_t *B, const uint offb, const uint segLength, const uint ldb,\n"
+"        __global real_t *C, const uint ldc)\n"
+"{\n"
+"    const uint r = get_global_id(0);\n"
+"    const uint c = get_global_id(1);\n"
+"    if (r >= rows) return;\n"
+"    __global const real_t *b = B + c * ldb + segment[r] * segLength + offb;\n"
+"    real_t s = 0;\n"
+"    for (uint i = 0; i < inner; ++i) s += A[i * lda + r] * b[i];\n"
+"    C[c * ldc + r] = s;\n"
+"}\n"
+"\n"
+"__kernel void seg_ger_row(const uint rows,\n"
+"        __global const real_t *a, const ulong offa, __global const int *segment,\n"
+"        __global const real_t *B, const uint row, const uint segLength, const uint ldb,\n"
+"        __global real_t *C, const uint ldc)\n"
+"{\n"
+"    const uint r = get_global_id(0);\n"
+"    const uint c = get_global_id(1);\n"
+"    if (r >= rows) return;\n"
+"    C[c * ldc + r] += a[offa + r] * B[c * ldb + segment[r] * segLength + row];\n"
+"}\n"
+"\n"
+"__kernel void spmv_csr_scalar(const uint nRow,\n"
+"        __global const int *rows, __global const int *cols, __global const real_t *vals,\n"
+"        __global const real_t *x, const ulong offx, __global real_t *y, const ulong offy)\n"
+"{\n"
+"    const uint row = get_global_id(0);\n"
+"    if (row >= nRow) return;\n"
+"    real_t s = 0;\n"
+"    for (int k = rows[row]; k < rows[row + 1]; ++k) s += vals[k] * x[offx + cols[k]];\n"
+"    y[offy + row] = s;\n"
+"}\n"
+"\n"
+"#define VECTOR_LANES 32\n"
+"__kernel void spmv_csr_vector(const uint nRow,\n"
+"        __global const int *rows, __global const int *cols, __global const real_t *vals,\n"
+"        __global const real_t *x, const ulong offx, __global real_t *y, const ulong offy,\n"
+"        __local real_t *scratch)\n"
+"{\n"
+"    const uint lid = get_local_id(0);\n"
+"    const uint lane = lid % VECTOR_LANES;\n"
+"    const uint row = get_global_id(0) / VECTOR_LANES;\n"
+"    real_t s = 0;\n"
+"    if (row < nRow)\n"
+"        for (int k = rows[row] + lane; k < rows[row + 1]; k += VECTOR_LANES) s += vals[k] * x[offx + cols[k]];\n"
+"    scratch[lid] = s;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint o = VECTOR_LANES / 2; o > 0; o >>= 1)\n"
+"    {\n"
+"        if (lane < o) scratch[lid] += scratch[lid + o];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    if (lane == 0 && row < nRow) y[offy + row] = scratch[lid];\n"
+"}\n"
+"\n"
+"__kernel void spmv_merge_path(const uint nRow, const uint nNz, const uint items, const uint nThreads,\n"
+"        __global const int *rows, __global const int *cols, __global const real_t *vals,\n"
+"        __global const real_t *x, const ulong offx, __global real_t *y, const ulong offy,\n"
+"        __global uint *carryRow, __global real_t *carryVal)\n"
+"{\n"
+"    const uint t = get_global_id(0);\n"
+"    if (t >= nThreads) return;\n"
+"    const uint total = nRow + nNz;\n"
+"    const uint diag = min(t * items, total);\n"
+"    uint lo = (diag > nNz) ? diag - nNz : 0;\n"
+"    uint hi = min(diag, nRow);\n"
+"    while (lo < hi)\n"
+"    {\n"
+"        const uint mid = (lo + hi) / 2;\n"
+"        if ((uint) rows[mid + 1] <= diag - mid - 1) lo = mid + 1;\n"
+"        else hi = mid;\n"
+"    }\n"
+"    uint i = lo, j = diag - lo;\n"
+"    real_t acc = 0;\n"
+"    for (uint step = 0; step < items && i + j < total; ++step)\n"
+"    {\n"
+"        if (j < (uint) rows[i + 1]) { acc += vals[j] * x[offx + cols[j]]; ++j; }\n"
+"        else { y[offy + i] = acc; acc = 0; ++i; }\n"
+"    }\n"
+"    carryRow[t] = i;\n"
+"    carryVal[t] = acc;\n"
+"}\n"
+"\n"
+"__kernel void spmv_merge_fixup(const uint nRow, const uint nThreads,\n"
+"        __global const uint *carryRow, __global const real_t *carryVal,\n"
+"        __global real_t *y, const ulong offy)\n"
+"{\n"
+"    const uint t = get_global_id(0);\n"
+"    if (t >= nThreads) return;\n"
+"    const uint r = carryRow[t];\n"
+"    if (r >= nRow || (t > 0 && carryRow[t - 1] == r)) return;\n"
+"    real_t s = 0;\n"
+"    for (uint u = t; u < nThreads && carryRow[u] == r; ++u) s += carryVal[u];\n"
+"    y[offy + r] += s;\n"
+"}\n"
+"\n"
+"__kernel void spmv_sell(const uint nRow, const uint C,\n"
+"        __global const int *offsets, __global const int *cols, __global const real_t *vals,\n"
+"        __global const real_t *x, const ulong offx, __global real_t *y, const ulong offy)\n"
+"{\n"
+"    const uint row = get_global_id(0);\n"
+"    if (row >= nRow) return;\n"
+"    const uint s = row / C, r = row % C;\n"
+"    const int begin = offsets[s], width = (offsets[s + 1] - begin) / C;\n"
+"    real_t acc = 0;\n"
+"    for (int j = 0; j < width; ++j) acc += vals[begin + j * C + r] * x[offx + cols[begin + j * C + r]];\n"
+"    y[offy + row] = acc;\n"
+"}\n"
+"\n"
+"__kernel void spmv_stencil(const uint nx, const uint ny, const uint nz,\n"
+"        const real_t c, const real_t cx, const real_t cy, const real_t cz,\n"
+"        __global const real_t *x, const ulong offx, __global real_t *y, const ulong offy)\n"
+"{\n"
+"    const uint i = get_global_id(0), j = get_global_id(1), k = get_global_id(2);\n"
+"    if (i >= nx) return;\n"
+"    const ulong row = ((ulong) k * ny + j) * nx + i, plane = (ulong) nx * ny;\n"
+"    __global const real_t *xr = x + offx + row;\n"
+"    real_t s = c * xr[0];\n"
+"    if (i > 0)      s += cx * xr[-1];\n"
+"    if (i < nx - 1) s += cx * xr[1];\n"
+"    if (j > 0)      s += cy * xr[-(long) nx];\n"
+"    if (j < ny - 1) s += cy * xr[nx];\n"
+"    if (k > 0)      s += cz * xr[-(long) plane];\n"
+"    if (k < nz - 1) s += cz * xr[plane];\n"
+"    y[offy + row] = s;\n"
+"}\n";
+
+/// \brief Maximal number of work-groups of the streaming (BLAS-1) kernels
+#define STREAM_GROUPS 1024
+
+static cl_program program;
+static cl_kernel  gram_kernel;
+static cl_kernel  trsm_kernel;
+static cl_kernel  partial_dot_kernel;
+static cl_kernel  dot_axpy_kernel;
+static cl_kernel  normalize_kernel;
+static cl_kernel  axpy_kernel;
+static cl_kernel  gather_kernel;
+static cl_kernel  scatter_add_kernel;
+static cl_kernel  gemm_kernel;
+static cl_kernel  ger_row_kernel;
+static cl_kernel  seg_dot_axpy_kernel;
+static cl_kernel  seg_normalize_kernel;
+static cl_kernel  seg_gemm_kernel;
+static cl_kernel  seg_ger_row_kernel;
+static cl_kernel  spmv_csr_scalar_kernel;
+static cl_kernel  spmv_csr_vector_kernel;
+static cl_kernel  spmv_merge_path_kernel;
+static cl_kernel  spmv_merge_fixup_kernel;
+static cl_kernel  spmv_sell_kernel;
+static cl_kernel  spmv_stencil_kernel;
+/// \brief Work-group size used by the reduction kernels (power of two)
+static size_t     wg_size;
+/// \brief Per work-group partial sums of \a partial_dot, at most \a wg_size of them
+static cl_mem     partials;
+/// \brief Ranks across which the reductions are summed
+static MPI_Comm   reduce_comm = MPI_COMM_SELF;
+/// \brief Host staging of \a partials for the reductions across ranks
+static real_t     *host_partials;
+/// \brief Events of the launches not collected yet and the phase of each, see \a timing.h
+static cl_event   *profiled;
+static int        *profiledPhases;
+static int        nProfiled;
+static int        maxProfiled;
+/// \brief Row and name of each launch in the trace, and the queue of each row
+static int        *profiledTracks;
+static char       (*profiledNames)[TRACE_NAME_LENGTH];
+static cl_command_queue traceQueues[TRACE_QUEUES];
+static int        nTraceQueues;
+
+static cl_kernel create_kernel(
+        const char *name)
+{
+    cl_int cl_status;
+    cl_kernel kernel = clCreateKernel(program, name, &cl_status);
+    if (cl_status != CL_SUCCESS)
+    {
+        fprintf(stderr, "[CRITICAL ERROR] Could not create kernel %s (status %d)\n", name, cl_status);
+        exit(EXIT_FAILURE);
+    }
+    return kernel;
+}
+
+void cl_kernels_init(
+        cl_context   context,
+        cl_device_id device)
+{
+    cl_int cl_status;
+#ifdef DOUBLE_PRECISION
+    const char *options = "-DDOUBLE_PRECISION";
+#else
+    const char *options = "";
+#endif
+
+    program = cl_build_program(context, device, kernels_source, options);
+
+    gram_kernel = create_kernel("gram");
+    trsm_kernel = create_kernel("trsm");
+    partial_dot_kernel = create_kernel("partial_dot");
+    dot_axpy_kernel = create_kernel("dot_axpy");
+    normalize_kernel = create_kernel("normalize");
+    axpy_kernel = create_kernel("axpy");
+    gather_kernel = create_kernel("gather");
+    scatter_add_kernel = create_kernel("scatter_add");
+    gemm_kernel = create_kernel("gemm");
+    ger_row_kernel = create_kernel("ger_row");
+    seg_dot_axpy_kernel = create_kernel("seg_dot_axpy");
+    seg_normalize_kernel = create_kernel("seg_normalize");
+    seg_gemm_kernel = create_kernel("seg_gemm");
+    seg_ger_row_kernel = create_kernel("seg_ger_row");
+    spmv_csr_scalar_kernel = create_kernel("spmv_csr_scalar");
+    spmv_csr_vector_kernel = create_kernel("spmv_csr_vector");
+    spmv_merge_path_kernel = create_kernel("spmv_merge_path");
+    spmv_merge_fixup_kernel = create_kernel("spmv_merge_fixup");
+    spmv_sell_kernel = create_kernel("spmv_sell");
+    spmv_stencil_kernel = create_kernel("spmv_stencil");
+
+    size_t max_wg;
+    clGetKernelWorkGroupInfo(gram_kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &max_wg, NULL);
+    wg_size = 1;
+    while (wg_size * 2 <= max_wg && wg_size < 256)
+    {
+        wg_size *= 2;
+    }
+
+    partials = clCreateBuffer(context, CL_MEM_READ_WRITE, wg_size * sizeof(real_t), NULL, &cl_status);
+    host_partials = malloc(wg_size * sizeof(real_t));
+}
+
+void cl_kernels_free()
+{
+    clReleaseKernel(gram_kernel);
+    clReleaseKernel(trsm_kernel);
+    clReleaseKernel(partial_dot_kernel);
+    clReleaseKernel(dot_axpy_kernel);
+    clReleaseKernel(normalize_kernel);
+    clReleaseKernel(axpy_kernel);
+    clReleaseKernel(gather_kernel);
+    clReleaseKernel(scatter_add_kernel);
+    clReleaseKernel(gemm_kernel);
+    clReleaseKernel(ger_row_kernel);
+    clReleaseKernel(seg_dot_axpy_kernel);
+    clReleaseKernel(seg_normalize_kernel);
+    clReleaseKernel(seg_gemm_kernel);
+    clReleaseKernel(seg_ger_row_kernel);
+    clReleaseKernel(spmv_csr_scalar_kernel);
+    clReleaseKernel(spmv_csr_vector_kernel);
+    clReleaseKernel(spmv_merge_path_kernel);
+    clReleaseKernel(spmv_merge_fixup_kernel);
+    clReleaseKernel(spmv_sell_kernel);
+    clReleaseKernel(spmv_stencil_kernel);
+    clReleaseMemObject(partials);
+    free(host_partials);
+    clReleaseProgram(program);
+    cl_kernels_collect_timings();
+    free(profiled);
+    free(profiledPhases);
+    free(profiledTracks);
+    free(profiledNames);
+    profiled       = NULL;
+    profiledPhases = NULL;
+    profiledTracks = NULL;
+    profiledNames  = NULL;
+    maxProfiled    = 0;
+    nTraceQueues   = 0;
+}
+
+/**
+ * \brief Row of \a queue in the trace
+ */
+static int queue_track(
+        cl_command_queue queue)
+{
+    for (int i = 0; i < nTraceQueues; ++i)
+    {
+        if (traceQueues[i] == queue) return TRACE_DEVICE + i;
+    }
+    if (nTraceQueues == TRACE_QUEUES)
+    {
+        return TRACE_DEVICE + TRACE_QUEUES - 1;
+    }
+    traceQueues[nTraceQueues] = queue;
+    return TRACE_DEVICE + nTraceQueues++;
+}
+
+/**
+ * \brief Keep \a event of the kernel \a name on \a queue for the timings of the current phase
+ */
+static void keep_event(
+        cl_event         event,
+        cl_command_queue queue,
+        const char       *name)
+{
+    if (nProfiled == maxProfiled)
+    {
+        maxProfiled    = (maxProfiled > 0) ? 2 * maxProfiled : 256;
+        profiled       = realloc(profiled, maxProfiled * sizeof(cl_event));
+        profiledPhases = realloc(profiledPhases, maxProfiled * sizeof(int));
+        profiledTracks = realloc(profiledTracks, maxProfiled * sizeof(int));
+        profiledNames  = realloc(profiledNames, maxProfiled * sizeof(*profiledNames));
+    }
+    profiled[nProfiled]       = event;
+    profiledPhases[nProfiled] = timing_current();
+    profiledTracks[nProfiled] = queue_track(queue);
+    snprintf(profiledNames[nProfiled], TRACE_NAME_LENGTH, "%s", name);
+    nProfiled++;
+}
+
+/**
+ * \brief Enqueue \a kernel, keeping its event for the timings of the current phase if enabled
+ */
+static cl_int launch(
+        cl_command_queue queue,
+        cl_kernel        kernel,
+        cl_uint          dims,
+        const size_t     *global,
+        const size_t     *local)
+{
+    if (!timing_enabled())
+    {
+        return clEnqueueNDRangeKernel(queue, kernel, dims, NULL, global, local, 0, NULL, NULL);
+    }
+    cl_event event;
+    cl_int   cl_status = clEnqueueNDRangeKernel(queue, kernel, dims, NULL, global, local, 0, NULL, &event);
+    if (cl_status == CL_SUCCESS)
+    {
+        char name[TRACE_NAME_LENGTH] = "kernel";
+        if (timing_tracing())
+        {
+            clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+        }
+        keep_event(event, queue, name);
+    }
+    return cl_status;
+}
+
+void cl_kernels_clsparse_event(
+        cl_command_queue queue,
+        clsparseControl  control,
+        const char       *name)
+{
+    cl_event event;
+    if (!timing_enabled() || clsparseGetEvent(control, &event) != clsparseSuccess || event == NULL)
+    {
+        return;
+    }
+    // The control keeps its own reference
+    clRetainEvent(event);
+    keep_event(event, queue, name);
+}
+
+void cl_kernels_collect_timings()
+{
+    double lastEnd[TRACE_TRACKS] = {0.0};
+    for (int i = 0; i < nProfiled; ++i)
+    {
+        cl_ulong start, end;
+        clWaitForEvents(1, profiled + i);
+        clGetEventProfilingInfo(profiled[i], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+        clGetEventProfilingInfo(profiled[i], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+        timing_add_kernel(profiledPhases[i], 1e-9 * (double) (end - start));
+        timing_trace_device(profiledNames[i], profiledTracks[i], 1e-9 * (double) start, 1e-9 * (double) end);
+        if (1e-9 * (double) end > lastEnd[profiledTracks[i]])
+        {
+            lastEnd[profiledTracks[i]] = 1e-9 * (double) end;
+        }
+        clReleaseEvent(profiled[i]);
+    }
+    nProfiled = 0;
+
+    // All the kernels collected are done by now: the host clock is at least their end plus the offset
+    double now = MPI_Wtime();
+    for (int t = TRACE_DEVICE; t < TRACE_TRACKS; ++t)
+    {
+        if (lastEnd[t] > 0.0)
+        {
+            timing_trace_clock(t, now - lastEnd[t]);
+        }
+    }
+}
+
+/**
+ * \brief Number of work-groups of a streaming kernel over \a n values
+ */
+static size_t stream_groups(
+        size_t n,
+        size_t max)
+{
+    size_t groups = (n + wg_size - 1) / wg_size;
+    if (groups > max) groups = max;
+    if (groups == 0) groups = 1;
+    return groups;
+}
+
+/**
+ * \brief First pass of a reduction: per work-group partial sums of x.y into \a partials
+ *
+ * \return the number of partial sums written
+ */
+static cl_uint enqueue_partial_dot(
+        cl_command_queue    queue,
+        const cldenseVector *x,
+        const cldenseVector *y)
+{
+    cl_uint  n    = x->num_values;
+    cl_ulong offx = x->off_values;
+    cl_ulong offy = y->off_values;
+
+    clSetKernelArg(partial_dot_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(partial_dot_kernel, 1, sizeof(cl_mem), &x->values);
+    clSetKernelArg(partial_dot_kernel, 2, sizeof(cl_ulong), &offx);
+    clSetKernelArg(partial_dot_kernel, 3, sizeof(cl_mem), &y->values);
+    clSetKernelArg(partial_dot_kernel, 4, sizeof(cl_ulong), &offy);
+    clSetKernelArg(partial_dot_kernel, 5, sizeof(cl_mem), &partials);
+    clSetKernelArg(partial_dot_kernel, 6, wg_size * sizeof(real_t), NULL);
+
+    size_t groups = stream_groups(n, wg_size);
+    size_t global = groups * wg_size;
+    launch(queue, partial_dot_kernel, 1, &global, &wg_size);
+
+    int num_ranks;
+    MPI_Comm_size(reduce_comm, &num_ranks);
+    if (num_ranks == 1)
+    {
+        return groups;
+    }
+
+    // Sum the partials across the ranks, the consumer kernel then sees one global partial
+    real_t local = 0.0, global_sum;
+    double waited = MPI_Wtime();
+    clEnqueueReadBuffer(queue, partials, CL_TRUE, 0, groups * sizeof(real_t), host_partials, 0, NULL, NULL);
+    timing_trace("read partial sums", TRACE_WAITS, waited, MPI_Wtime());
+    for (size_t i = 0; i < groups; ++i)
+    {
+        local += host_partials[i];
+    }
+    MPI_Allreduce(&local, &global_sum, 1, MPI_REAL_T, MPI_SUM, reduce_comm);
+    clEnqueueWriteBuffer(queue, partials, CL_TRUE, 0, sizeof(real_t), &global_sum, 0, NULL, NULL);
+    return 1;
+}
+
+void cl_kernels_set_comm(
+        MPI_Comm comm)
+{
+    reduce_comm = comm;
+}
+
+cl_int cl_kernel_gather(
+        cl_command_queue    queue,
+        cldenseVector       *dst,
+        cl_mem              idx,
+        const cldenseVector *src)
+{
+    cl_uint  n      = dst->num_values;
+    cl_ulong offsrc = src->off_values;
+
+    clSetKernelArg(gather_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(gather_kernel, 1, sizeof(cl_mem), &dst->values);
+    clSetKernelArg(gather_kernel, 2, sizeof(cl_mem), &idx);
+    clSetKernelArg(gather_kernel, 3, sizeof(cl_mem), &src->values);
+    clSetKernelArg(gather_kernel, 4, sizeof(cl_ulong), &offsrc);
+
+    size_t global = ((n + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, gather_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_scatter_add(
+        cl_command_queue    queue,
+        cldenseVector       *dst,
+        cl_mem              idx,
+        const cldenseVector *src)
+{
+    cl_uint  n      = src->num_values;
+    cl_ulong offdst = dst->off_values;
+
+    clSetKernelArg(scatter_add_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(scatter_add_kernel, 1, sizeof(cl_mem), &dst->values);
+    clSetKernelArg(scatter_add_kernel, 2, sizeof(cl_ulong), &offdst);
+    clSetKernelArg(scatter_add_kernel, 3, sizeof(cl_mem), &idx);
+    clSetKernelArg(scatter_add_kernel, 4, sizeof(cl_mem), &src->values);
+
+    size_t global = ((n + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, scatter_add_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_axpy(
+        cl_command_queue     queue,
+        cldenseVector        *y,
+        const clsparseScalar *alpha,
+        real_t               sign,
+        const cldenseVector  *x)
+{
+    cl_uint  n    = y->num_values;
+    cl_ulong offy = y->off_values;
+    cl_ulong offx = x->off_values;
+    cl_ulong offa = alpha->off_value;
+
+    clSetKernelArg(axpy_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(axpy_kernel, 1, sizeof(cl_mem), &y->values);
+    clSetKernelArg(axpy_kernel, 2, sizeof(cl_ulong), &offy);
+    clSetKernelArg(axpy_kernel, 3, sizeof(cl_mem), &x->values);
+    clSetKernelArg(axpy_kernel, 4, sizeof(cl_ulong), &offx);
+    clSetKernelArg(axpy_kernel, 5, sizeof(cl_mem), &alpha->value);
+    clSetKernelArg(axpy_kernel, 6, sizeof(cl_ulong), &offa);
+    clSetKernelArg(axpy_kernel, 7, sizeof(real_t), &sign);
+
+    size_t global = stream_groups(n, STREAM_GROUPS) * wg_size;
+    return launch(queue, axpy_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_dot_axpy(
+        cl_command_queue    queue,
+        clsparseScalar      *h,
+        const cldenseVector *q,
+        cldenseVector       *w)
+{
+    cl_uint  np   = enqueue_partial_dot(queue, q, w);
+    cl_uint  n    = w->num_values;
+    cl_ulong offw = w->off_values;
+    cl_ulong offq = q->off_values;
+    cl_ulong offh = h->off_value;
+
+    clSetKernelArg(dot_axpy_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(dot_axpy_kernel, 1, sizeof(cl_mem), &w->values);
+    clSetKernelArg(dot_axpy_kernel, 2, sizeof(cl_ulong), &offw);
+    clSetKernelArg(dot_axpy_kernel, 3, sizeof(cl_mem), &q->values);
+    clSetKernelArg(dot_axpy_kernel, 4, sizeof(cl_ulong), &offq);
+    clSetKernelArg(dot_axpy_kernel, 5, sizeof(cl_mem), &partials);
+    clSetKernelArg(dot_axpy_kernel, 6, sizeof(cl_uint), &np);
+    clSetKernelArg(dot_axpy_kernel, 7, sizeof(cl_mem), &h->value);
+    clSetKernelArg(dot_axpy_kernel, 8, sizeof(cl_ulong), &offh);
+    clSetKernelArg(dot_axpy_kernel, 9, wg_size * sizeof(real_t), NULL);
+
+    size_t global = stream_groups(n, STREAM_GROUPS) * wg_size;
+    return launch(queue, dot_axpy_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_normalize(
+        cl_command_queue queue,
+        clsparseScalar   *nrm,
+        cldenseVector    *x)
+{
+    cl_uint  np   = enqueue_partial_dot(queue, x, x);
+    cl_uint  n    = x->num_values;
+    cl_ulong offx = x->off_values;
+    cl_ulong offn = nrm->off_value;
+
+    clSetKernelArg(normalize_kernel, 0, sizeof(cl_uint), &n);
+    clSetKernelArg(normalize_kernel, 1, sizeof(cl_mem), &x->values);
+    clSetKernelArg(normalize_kernel, 2, sizeof(cl_ulong), &offx);
+    clSetKernelArg(normalize_kernel, 3, sizeof(cl_mem), &partials);
+    clSetKernelArg(normalize_kernel, 4, sizeof(cl_uint), &np);
+    clSetKernelArg(normalize_kernel, 5, sizeof(cl_mem), &nrm->value);
+    clSetKernelArg(normalize_kernel, 6, sizeof(cl_ulong), &offn);
+    clSetKernelArg(normalize_kernel, 7, wg_size * sizeof(real_t), NULL);
+
+    size_t global = stream_groups(n, STREAM_GROUPS) * wg_size;
+    return launch(queue, normalize_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_gram(
+        cl_command_queue queue,
+        cldenseMatrix    *V,
+        cl_mem           G)
+{
+    cl_uint  rows = V->num_rows;
+    cl_uint  cols = V->num_cols;
+    cl_uint  ld   = V->lead_dim;
+    cl_ulong off  = V->off_values;
+
+    clSetKernelArg(gram_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(gram_kernel, 1, sizeof(cl_uint), &cols);
+    clSetKernelArg(gram_kernel, 2, sizeof(cl_uint), &ld);
+    clSetKernelArg(gram_kernel, 3, sizeof(cl_mem), &V->values);
+    clSetKernelArg(gram_kernel, 4, sizeof(cl_ulong), &off);
+    clSetKernelArg(gram_kernel, 5, sizeof(cl_mem), &G);
+    clSetKernelArg(gram_kernel, 6, wg_size * sizeof(real_t), NULL);
+
+    size_t global[2] = {wg_size * cols, cols};
+    size_t local[2]  = {wg_size, 1};
+    return launch(queue, gram_kernel, 2, global, local);
+}
+
+cl_int cl_kernel_trsm(
+        cl_command_queue queue,
+        cldenseMatrix    *V,
+        cl_mem           R)
+{
+    cl_uint  rows = V->num_rows;
+    cl_uint  cols = V->num_cols;
+    cl_uint  ld   = V->lead_dim;
+    cl_ulong off  = V->off_values;
+
+    clSetKernelArg(trsm_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(trsm_kernel, 1, sizeof(cl_uint), &cols);
+    clSetKernelArg(trsm_kernel, 2, sizeof(cl_uint), &ld);
+    clSetKernelArg(trsm_kernel, 3, sizeof(cl_mem), &V->values);
+    clSetKernelArg(trsm_kernel, 4, sizeof(cl_ulong), &off);
+    clSetKernelArg(trsm_kernel, 5, sizeof(cl_mem), &R);
+
+    size_t global = ((rows + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, trsm_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_gemm(
+        cl_command_queue    queue,
+        const cldenseMatrix *A,
+        const cldenseMatrix *B,
+        cl_uint             firstRow,
+        cl_uint             inner,
+        cldenseMatrix       *C)
+{
+    cl_uint rows  = C->num_rows;
+    cl_uint lda   = A->lead_dim;
+    cl_uint ldb   = B->lead_dim;
+    cl_uint ldc   = C->lead_dim;
+
+    clSetKernelArg(gemm_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(gemm_kernel, 1, sizeof(cl_uint), &inner);
+    clSetKernelArg(gemm_kernel, 2, sizeof(cl_mem), &A->values);
+    clSetKernelArg(gemm_kernel, 3, sizeof(cl_uint), &lda);
+    clSetKernelArg(gemm_kernel, 4, sizeof(cl_mem), &B->values);
+    clSetKernelArg(gemm_kernel, 5, sizeof(cl_uint), &firstRow);
+    clSetKernelArg(gemm_kernel, 6, sizeof(cl_uint), &ldb);
+    clSetKernelArg(gemm_kernel, 7, sizeof(cl_mem), &C->values);
+    clSetKernelArg(gemm_kernel, 8, sizeof(cl_uint), &ldc);
+
+    size_t global[2] = {((rows + wg_size - 1) / wg_size) * wg_size, C->num_cols};
+    size_t local[2]  = {wg_size, 1};
+    return launch(queue, gemm_kernel, 2, global, local);
+}
+
+cl_int cl_kernel_ger_row(
+        cl_command_queue    queue,
+        const cldenseVector *a,
+        const cldenseMatrix *B,
+        cl_uint             row,
+        cldenseMatrix       *C)
+{
+    cl_uint  rows = C->num_rows;
+    cl_ulong offa = a->off_values;
+    cl_uint  ldb  = B->lead_dim;
+    cl_uint  ldc  = C->lead_dim;
+
+    clSetKernelArg(ger_row_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(ger_row_kernel, 1, sizeof(cl_mem), &a->values);
+    clSetKernelArg(ger_row_kernel, 2, sizeof(cl_ulong), &offa);
+    clSetKernelArg(ger_row_kernel, 3, sizeof(cl_mem), &B->values);
+    clSetKernelArg(ger_row_kernel, 4, sizeof(cl_uint), &row);
+    clSetKernelArg(ger_row_kernel, 5, sizeof(cl_uint), &ldb);
+    clSetKernelArg(ger_row_kernel, 6, sizeof(cl_mem), &C->values);
+    clSetKernelArg(ger_row_kernel, 7, sizeof(cl_uint), &ldc);
+
+    size_t global[2] = {((rows + wg_size - 1) / wg_size) * wg_size, C->num_cols};
+    size_t local[2]  = {wg_size, 1};
+    return launch(queue, ger_row_kernel, 2, global, local);
+}
+
+cl_int cl_kernel_seg_dot_axpy(
+        cl_command_queue    queue,
+        cl_mem              offsets,
+        cl_uint             count,
+        clsparseScalar      *h,
+        cl_uint             stride,
+        const cldenseVector *q,
+        cldenseVector       *w)
+{
+    cl_ulong offw = w->off_values;
+    cl_ulong offq = q->off_values;
+    cl_ulong offh = h->off_value;
+
+    clSetKernelArg(seg_dot_axpy_kernel, 0, sizeof(cl_mem), &offsets);
+    clSetKernelArg(seg_dot_axpy_kernel, 1, sizeof(cl_mem), &w->values);
+    clSetKernelArg(seg_dot_axpy_kernel, 2, sizeof(cl_ulong), &offw);
+    clSetKernelArg(seg_dot_axpy_kernel, 3, sizeof(cl_mem), &q->values);
+    clSetKernelArg(seg_dot_axpy_kernel, 4, sizeof(cl_ulong), &offq);
+    clSetKernelArg(seg_dot_axpy_kernel, 5, sizeof(cl_mem), &h->value);
+    clSetKernelArg(seg_dot_axpy_kernel, 6, sizeof(cl_ulong), &offh);
+    clSetKernelArg(seg_dot_axpy_kernel, 7, sizeof(cl_uint), &stride);
+    clSetKernelArg(seg_dot_axpy_kernel, 8, wg_size * sizeof(real_t), NULL);
+
+    size_t global = count * wg_size;
+    return launch(queue, seg_dot_axpy_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_seg_normalize(
+        cl_command_queue queue,
+        cl_mem           offsets,
+        cl_uint          count,
+        clsparseScalar   *nrm,
+        cl_uint          stride,
+        cldenseVector    *x)
+{
+    cl_ulong offx = x->off_values;
+    cl_ulong offn = nrm->off_value;
+
+    clSetKernelArg(seg_normalize_kernel, 0, sizeof(cl_mem), &offsets);
+    clSetKernelArg(seg_normalize_kernel, 1, sizeof(cl_mem), &x->values);
+    clSetKernelArg(seg_normalize_kernel, 2, sizeof(cl_ulong), &offx);
+    clSetKernelArg(seg_normalize_kernel, 3, sizeof(cl_mem), &nrm->value);
+    clSetKernelArg(seg_normalize_kernel, 4, sizeof(cl_ulong), &offn);
+    clSetKernelArg(seg_normalize_kernel, 5, sizeof(cl_uint), &stride);
+    clSetKernelArg(seg_normalize_kernel, 6, wg_size * sizeof(real_t), NULL);
+
+    size_t global = count * wg_size;
+    return launch(queue, seg_normalize_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_seg_gemm(
+        cl_command_queue    queue,
+        cl_mem              segment,
+        const cldenseMatrix *A,
+        const cldenseMatrix *B,
+        cl_uint             firstRow,
+        cl_uint             inner,
+        cl_uint             segLength,
+        cldenseMatrix       *C)
+{
+    cl_uint rows  = C->num_rows;
+    cl_uint lda   = A->lead_dim;
+    cl_uint ldb   = B->lead_dim;
+    cl_uint ldc   = C->lead_dim;
+
+    clSetKernelArg(seg_gemm_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(seg_gemm_kernel, 1, sizeof(cl_uint), &inner);
+    clSetKernelArg(seg_gemm_kernel, 2, sizeof(cl_mem), &A->values);
+    clSetKernelArg(seg_gemm_kernel, 3, sizeof(cl_uint), &lda);
+    clSetKernelArg(seg_gemm_kernel, 4, sizeof(cl_mem), &segment);
+    clSetKernelArg(seg_gemm_kernel, 5, sizeof(cl_mem), &B->values);
+    clSetKernelArg(seg_gemm_kernel, 6, sizeof(cl_uint), &firstRow);
+    clSetKernelArg(seg_gemm_kernel, 7, sizeof(cl_uint), &segLength);
+    clSetKernelArg(seg_gemm_kernel, 8, sizeof(cl_uint), &ldb);
+    clSetKernelArg(seg_gemm_kernel, 9, sizeof(cl_mem), &C->values);
+    clSetKernelArg(seg_gemm_kernel, 10, sizeof(cl_uint), &ldc);
+
+    size_t global[2] = {((rows + wg_size - 1) / wg_size) * wg_size, C->num_cols};
+    size_t local[2]  = {wg_size, 1};
+    return launch(queue, seg_gemm_kernel, 2, global, local);
+}
+
+cl_int cl_kernel_seg_ger_row(
+        cl_command_queue    queue,
+        cl_mem              segment,
+        const cldenseVector *a,
+        const cldenseMatrix *B,
+        cl_uint             row,
+        cl_uint             segLength,
+        cldenseMatrix       *C)
+{
+    cl_uint  rows = C->num_rows;
+    cl_ulong offa = a->off_values;
+    cl_uint  ldb  = B->lead_dim;
+    cl_uint  ldc  = C->lead_dim;
+
+    clSetKernelArg(seg_ger_row_kernel, 0, sizeof(cl_uint), &rows);
+    clSetKernelArg(seg_ger_row_kernel, 1, sizeof(cl_mem), &a->values);
+    clSetKernelArg(seg_ger_row_kernel, 2, sizeof(cl_ulong), &offa);
+    clSetKernelArg(seg_ger_row_kernel, 3, sizeof(cl_mem), &segment);
+    clSetKernelArg(seg_ger_row_kernel, 4, sizeof(cl_mem), &B->values);
+    clSetKernelArg(seg_ger_row_kernel, 5, sizeof(cl_uint), &row);
+    clSetKernelArg(seg_ger_row_kernel, 6, sizeof(cl_uint), &segLength);
+    clSetKernelArg(seg_ger_row_kernel, 7, sizeof(cl_uint), &ldb);
+    clSetKernelArg(seg_ger_row_kernel, 8, sizeof(cl_mem), &C->values);
+    clSetKernelArg(seg_ger_row_kernel, 9, sizeof(cl_uint), &ldc);
+
+    size_t global[2] = {((rows + wg_size - 1) / wg_size) * wg_size, C->num_cols};
+    size_t local[2]  = {wg_size, 1};
+    return launch(queue, seg_ger_row_kernel, 2, global, local);
+}
+
+/**
+ * \brief Set the arguments shared by the CSR kernels: rows, arrays of \a A, x and y
+ */
+static void set_csr_args(
+        cl_kernel               kernel,
+        const clsparseCsrMatrix *A,
+        const cldenseVector     *x,
+        cldenseVector           *y)
+{
+    cl_uint  nRow = A->num_rows;
+    cl_ulong offx = x->off_values;
+    cl_ulong offy = y->off_values;
+
+    clSetKernelArg(kernel, 0, sizeof(cl_uint), &nRow);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &A->row_pointer);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &A->col_indices);
+    clSetKernelArg(kernel, 3, sizeof(cl_mem), &A->values);
+    clSetKernelArg(kernel, 4, sizeof(cl_mem), &x->values);
+    clSetKernelArg(kernel, 5, sizeof(cl_ulong), &offx);
+    clSetKernelArg(kernel, 6, sizeof(cl_mem), &y->values);
+    clSetKernelArg(kernel, 7, sizeof(cl_ulong), &offy);
+}
+
+cl_int cl_kernel_spmv_csr_scalar(
+        cl_command_queue        queue,
+        const clsparseCsrMatrix *A,
+        const cldenseVector     *x,
+        cldenseVector           *y)
+{
+    set_csr_args(spmv_csr_scalar_kernel, A, x, y);
+
+    size_t global = ((A->num_rows + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, spmv_csr_scalar_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_spmv_csr_vector(
+        cl_command_queue        queue,
+        const clsparseCsrMatrix *A,
+        const cldenseVector     *x,
+        cldenseVector           *y)
+{
+    if (wg_size < CSR_VECTOR_LANES)
+    {
+        return CL_INVALID_WORK_GROUP_SIZE;
+    }
+    set_csr_args(spmv_csr_vector_kernel, A, x, y);
+    clSetKernelArg(spmv_csr_vector_kernel, 8, wg_size * sizeof(real_t), NULL);
+
+    size_t threads = (size_t) A->num_rows * CSR_VECTOR_LANES;
+    size_t global = ((threads + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, spmv_csr_vector_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_spmv_merge_path(
+        cl_command_queue        queue,
+        const clsparseCsrMatrix *A,
+        const cldenseVector     *x,
+        cldenseVector           *y,
+        cl_uint                 items,
+        cl_uint                 nThreads,
+        cl_mem                  carryRow,
+        cl_mem                  carryVal)
+{
+    cl_uint  nRow = A->num_rows;
+    cl_uint  nNz  = A->num_nonzeros;
+    cl_ulong offx = x->off_values;
+    cl_ulong offy = y->off_values;
+
+    clSetKernelArg(spmv_merge_path_kernel, 0, sizeof(cl_uint), &nRow);
+    clSetKernelArg(spmv_merge_path_kernel, 1, sizeof(cl_uint), &nNz);
+    clSetKernelArg(spmv_merge_path_kernel, 2, sizeof(cl_uint), &items);
+    clSetKernelArg(spmv_merge_path_kernel, 3, sizeof(cl_uint), &nThreads);
+    clSetKernelArg(spmv_merge_path_kernel, 4, sizeof(cl_mem), &A->row_pointer);
+    clSetKernelArg(spmv_merge_path_kernel, 5, sizeof(cl_mem), &A->col_indices);
+    clSetKernelArg(spmv_merge_path_kernel, 6, sizeof(cl_mem), &A->values);
+    clSetKernelArg(spmv_merge_path_kernel, 7, sizeof(cl_mem), &x->values);
+    clSetKernelArg(spmv_merge_path_kernel, 8, sizeof(cl_ulong), &offx);
+    clSetKernelArg(spmv_merge_path_kernel, 9, sizeof(cl_mem), &y->values);
+    clSetKernelArg(spmv_merge_path_kernel, 10, sizeof(cl_ulong), &offy);
+    clSetKernelArg(spmv_merge_path_kernel, 11, sizeof(cl_mem), &carryRow);
+    clSetKernelArg(spmv_merge_path_kernel, 12, sizeof(cl_mem), &carryVal);
+
+    size_t global = ((nThreads + wg_size - 1) / wg_size) * wg_size;
+    launch(queue, spmv_merge_path_kernel, 1, &global, &wg_size);
+
+    // Rows crossing the boundary between two threads get the partial sums of the first ones
+    clSetKernelArg(spmv_merge_fixup_kernel, 0, sizeof(cl_uint), &nRow);
+    clSetKernelArg(spmv_merge_fixup_kernel, 1, sizeof(cl_uint), &nThreads);
+    clSetKernelArg(spmv_merge_fixup_kernel, 2, sizeof(cl_mem), &carryRow);
+    clSetKernelArg(spmv_merge_fixup_kernel, 3, sizeof(cl_mem), &carryVal);
+    clSetKernelArg(spmv_merge_fixup_kernel, 4, sizeof(cl_mem), &y->values);
+    clSetKernelArg(spmv_merge_fixup_kernel, 5, sizeof(cl_ulong), &offy);
+    return launch(queue, spmv_merge_fixup_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_spmv_sell(
+        cl_command_queue    queue,
+        cl_uint             nRow,
+        cl_uint             C,
+        cl_mem              offsets,
+        cl_mem              cols,
+        cl_mem              vals,
+        const cldenseVector *x,
+        cldenseVector       *y)
+{
+    cl_ulong offx = x->off_values;
+    cl_ulong offy = y->off_values;
+
+    clSetKernelArg(spmv_sell_kernel, 0, sizeof(cl_uint), &nRow);
+    clSetKernelArg(spmv_sell_kernel, 1, sizeof(cl_uint), &C);
+    clSetKernelArg(spmv_sell_kernel, 2, sizeof(cl_mem), &offsets);
+    clSetKernelArg(spmv_sell_kernel, 3, sizeof(cl_mem), &cols);
+    clSetKernelArg(spmv_sell_kernel, 4, sizeof(cl_mem), &vals);
+    clSetKernelArg(spmv_sell_kernel, 5, sizeof(cl_mem), &x->values);
+    clSetKernelArg(spmv_sell_kernel, 6, sizeof(cl_ulong), &offx);
+    clSetKernelArg(spmv_sell_kernel, 7, sizeof(cl_mem), &y->values);
+    clSetKernelArg(spmv_sell_kernel, 8, sizeof(cl_ulong), &offy);
+
+    size_t global = ((nRow + wg_size - 1) / wg_size) * wg_size;
+    return launch(queue, spmv_sell_kernel, 1, &global, &wg_size);
+}
+
+cl_int cl_kernel_spmv_stencil(
+        cl_command_queue      queue,
+        const stencilOperator *op,
+        const cldenseVector   *x,
+        cldenseVector         *y)
+{
+    cl_uint  n[3] = {op->nx, op->ny, op->nz};
+    real_t   c[4] = {op->center, op->coeffs[0], op->coeffs[1], op->coeffs[2]};
+    cl_ulong offx = x->off_values;
+    cl_ulong offy = y->off_values;
+
+    for (int a = 0; a < 3; ++a) clSetKernelArg(spmv_stencil_kernel, a, sizeof(cl_uint), &n[a]);
+    for (int a = 0; a < 4; ++a) clSetKernelArg(spmv_stencil_kernel, 3 + a, sizeof(real_t), &c[a]);
+    clSetKernelArg(spmv_stencil_kernel, 7, sizeof(cl_mem), &x->values);
+    clSetKernelArg(spmv_stencil_kernel, 8, sizeof(cl_ulong), &offx);
+    clSetKernelArg(spmv_stencil_kernel, 9, sizeof(cl_mem), &y->values);
+    clSetKernelArg(spmv_stencil_kernel, 10, sizeof(cl_ulong), &offy);
+
+    // Work-groups along the lines of the grid, the neighbours along x share their cache lines
+    size_t local[3]  = {wg_size, 1, 1};
+    size_t global[3] = {((n[0] + wg_size - 1) / wg_size) * wg_size, n[1], n[2]};
+    return launch(queue, spmv_stencil_kernel, 3, global, local);
+}
+
+size_t cl_kernels_work_group_size()
+{
+    return wg_size;
+}
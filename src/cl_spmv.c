@@ -0,0 +1,212 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cl_spmv.c
+ * \brief Interchangeable sparse matrix-vector product kernels for a CSR matrix on device
+ *
+ */
+
+#include "cl_spmv.h"
+
+const char *const cl_spmv_variant_names[CL_SPMV_NUM_VARIANTS] = {
+    "clsparse", "csr-scalar", "csr-vector", "merge-path", "sell"
+};
+
+void cl_spmv_init(
+        clSpmvMatrix      *m,
+        clsparseCsrMatrix *csr)
+{
+    m->csr          = csr;
+    m->variant      = CL_SPMV_CLSPARSE;
+    m->mergeThreads = 0;
+    m->carryRow     = NULL;
+    m->carryVal     = NULL;
+    m->sellOffsets  = NULL;
+    m->sellCols     = NULL;
+    m->sellVals     = NULL;
+}
+
+/**
+ * \brief Build the sliced ELLPACK copy of the matrix from its CSR arrays read back from the device
+ */
+static int build_sell(
+        clSpmvMatrix     *m,
+        cl_context       context,
+        cl_command_queue queue)
+{
+    const int nRow    = m->csr->num_rows;
+    const int nNz     = m->csr->num_nonzeros;
+    const int nSlices = (nRow + SELL_SLICE - 1) / SELL_SLICE;
+    cl_int    cl_status;
+
+    int    *rows = malloc((nRow + 1) * sizeof(int));
+    int    *cols = malloc((nNz > 0 ? nNz : 1) * sizeof(int));
+    real_t *vals = malloc((nNz > 0 ? nNz : 1) * sizeof(real_t));
+    clEnqueueReadBuffer(queue, m->csr->row_pointer, CL_TRUE, 0, (nRow + 1) * sizeof(int), rows, 0, NULL, NULL);
+    if (nNz > 0)
+    {
+        clEnqueueReadBuffer(queue, m->csr->col_indices, CL_TRUE, 0, nNz * sizeof(int), cols, 0, NULL, NULL);
+        clEnqueueReadBuffer(queue, m->csr->values, CL_TRUE, 0, nNz * sizeof(real_t), vals, 0, NULL, NULL);
+    }
+
+    int *offsets = malloc((nSlices + 1) * sizeof(int));
+    offsets[0] = 0;
+    for (int s = 0; s < nSlices; ++s)
+    {
+        int width = 0;
+        for (int r = s * SELL_SLICE; r < (s + 1) * SELL_SLICE && r < nRow; ++r)
+        {
+            if (rows[r+1] - rows[r] > width)
+            {
+                width = rows[r+1] - rows[r];
+            }
+        }
+        offsets[s+1] = offsets[s] + width * SELL_SLICE;
+    }
+    const long long nSell = offsets[nSlices];
+    if (nSell - nNz > (long long) SELL_MAX_PADDING * nNz || nSell > INT_MAX)
+    {
+        free(rows);
+        free(cols);
+        free(vals);
+        free(offsets);
+        return EXIT_FAILURE;
+    }
+
+    int    *sellCols = calloc(nSell > 0 ? nSell : 1, sizeof(int));
+    real_t *sellVals = calloc(nSell > 0 ? nSell : 1, sizeof(real_t));
+    for (int r = 0; r < nRow; ++r)
+    {
+        const int s = r / SELL_SLICE;
+        for (int k = rows[r]; k < rows[r+1]; ++k)
+        {
+            const int e = offsets[s] + (k - rows[r]) * SELL_SLICE + r % SELL_SLICE;
+            sellCols[e] = cols[k];
+            sellVals[e] = vals[k];
+        }
+    }
+
+    m->sellOffsets = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            (nSlices + 1) * sizeof(int), offsets, &cl_status);
+    if (cl_status == CL_SUCCESS)
+    {
+        m->sellCols = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                (nSell > 0 ? nSell : 1) * sizeof(int), sellCols, &cl_status);
+    }
+    if (cl_status == CL_SUCCESS)
+    {
+        m->sellVals = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                (nSell > 0 ? nSell : 1) * sizeof(real_t), sellVals, &cl_status);
+    }
+
+    free(rows);
+    free(cols);
+    free(vals);
+    free(offsets);
+    free(sellCols);
+    free(sellVals);
+    if (cl_status != CL_SUCCESS)
+    {
+        fprintf(stderr, "[ERROR]: cl_spmv.c: not enough device memory for the sliced ELLPACK copy (status %d)\n",
+                cl_status);
+        cl_spmv_free(m);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int cl_spmv_set_variant(
+        clSpmvMatrix     *m,
+        clSpmvVariant_t  variant,
+        cl_context       context,
+        cl_command_queue queue)
+{
+    cl_int       cl_status = CL_SUCCESS;
+    clSpmvMatrix next;
+
+    if (variant == m->variant)
+    {
+        return EXIT_SUCCESS;
+    }
+    if (variant == CL_SPMV_CSR_VECTOR && cl_kernels_work_group_size() < CSR_VECTOR_LANES)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Build the data of the new kernel first, the previous one stays usable on failure
+    cl_spmv_init(&next, m->csr);
+    next.variant = variant;
+    if (variant == CL_SPMV_MERGE_PATH)
+    {
+        const long long total = (long long) m->csr->num_rows + m->csr->num_nonzeros;
+        next.mergeThreads = (cl_uint) ((total + MERGE_ITEMS - 1) / MERGE_ITEMS);
+        next.carryRow = clCreateBuffer(context, CL_MEM_READ_WRITE, (next.mergeThreads + 1) * sizeof(cl_uint),
+                NULL, &cl_status);
+        if (cl_status == CL_SUCCESS)
+        {
+            next.carryVal = clCreateBuffer(context, CL_MEM_READ_WRITE, (next.mergeThreads + 1) * sizeof(real_t),
+                    NULL, &cl_status);
+        }
+        if (cl_status != CL_SUCCESS)
+        {
+            cl_spmv_free(&next);
+            return EXIT_FAILURE;
+        }
+    }
+    else if (variant == CL_SPMV_SELL && build_sell(&next, context, queue) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    cl_spmv_free(m);
+    *m = next;
+    return EXIT_SUCCESS;
+}
+
+void cl_spmv(
+        clSpmvMatrix        *m,
+        const cldenseVector *x,
+        cldenseVector       *y,
+        cl_command_queue    queue,
+        clsparseControl     control)
+{
+    switch (m->variant)
+    {
+        case CL_SPMV_CSR_SCALAR:
+            cl_kernel_spmv_csr_scalar(queue, m->csr, x, y);
+            break;
+        case CL_SPMV_CSR_VECTOR:
+            cl_kernel_spmv_csr_vector(queue, m->csr, x, y);
+            break;
+        case CL_SPMV_MERGE_PATH:
+            cl_kernel_spmv_merge_path(queue, m->csr, x, y, MERGE_ITEMS, m->mergeThreads, m->carryRow, m->carryVal);
+            break;
+        case CL_SPMV_SELL:
+            cl_kernel_spmv_sell(queue, m->csr->num_rows, SELL_SLICE, m->sellOffsets, m->sellCols, m->sellVals, x, y);
+            break;
+        default:
+#ifdef DOUBLE_PRECISION
+            clsparseDcsrmv(&one_S, m->csr, x, &zero_S, y, control);
+            cl_kernels_clsparse_event(queue, control, "clsparseDcsrmv");
+#else
+            clsparseScsrmv(&one_S, m->csr, x, &zero_S, y, control);
+            cl_kernels_clsparse_event(queue, control, "clsparseScsrmv");
+#endif
+            break;
+    }
+}
+
+void cl_spmv_free(
+        clSpmvMatrix *m)
+{
+    cl_mem *buffers[5] = {&m->carryRow, &m->carryVal, &m->sellOffsets, &m->sellCols, &m->sellVals};
+    for (int i = 0; i < 5; ++i)
+    {
+        if (*buffers[i] != NULL)
+        {
+            clReleaseMemObject(*buffers[i]);
+            *buffers[i] = NULL;
+        }
+    }
+    m->mergeThreads = 0;
+    m->variant = CL_SPMV_CLSPARSE;
+}
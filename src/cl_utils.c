@@ -7,86 +7,202 @@
 
 #include "cl_utils.h"
 
-cldenseVector  one_V;
 clsparseScalar minusOne_S;
 clsparseScalar one_S;
 clsparseScalar zero_S;
 
-void cl_init(
-		cl_platform_id       **platforms,
-		cl_device_id         **devices,
-		cl_context           *context,
-		cl_command_queue     *queue,
-        clsparseCreateResult *createResult)
+/// \brief Most device indices of a selection
+#define MAX_SELECTED_DEVICES 64
+
+/**
+ * \brief Order of the devices: GPUs and accelerators first, then by decreasing memory and compute units
+ */
+static int compare_devices(
+        const void *a,
+        const void *b)
+{
+    const clDeviceInfo *x = a, *y = b;
+    int xCpu = (x->type & CL_DEVICE_TYPE_CPU) != 0, yCpu = (y->type & CL_DEVICE_TYPE_CPU) != 0;
+
+    if (xCpu != yCpu) return xCpu - yCpu;
+    if (x->memory != y->memory) return (x->memory < y->memory) ? 1 : -1;
+    if (x->computeUnits != y->computeUnits) return (x->computeUnits < y->computeUnits) ? 1 : -1;
+    return x->index - y->index;
+}
+
+int cl_list_devices(
+        clDeviceInfo **list)
 {
-	cl_int cl_status = CL_SUCCESS;
     cl_uint num_platforms = 0;
-    cl_uint num_devices = 0;
+    int     count = 0;
 
-    // Get number of compatible OpenCL platforms
-    cl_status = clGetPlatformIDs(0, NULL, &num_platforms);
+    clGetPlatformIDs(0, NULL, &num_platforms);
+    cl_platform_id *platforms = malloc((num_platforms > 0 ? num_platforms : 1) * sizeof(cl_platform_id));
+    clGetPlatformIDs(num_platforms, platforms, NULL);
 
-    if (num_platforms == 0)
+    *list = NULL;
+    for (cl_uint p = 0; p < num_platforms; ++p)
     {
-        fprintf(stderr, "[CRITICAL ERROR] No OpenCL platforms found.\n");
-        exit(EXIT_FAILURE);
+        cl_uint num_devices = 0;
+        if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &num_devices) != CL_SUCCESS || num_devices == 0)
+        {
+            continue;
+        }
+        cl_device_id *ids = malloc(num_devices * sizeof(cl_device_id));
+        clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, num_devices, ids, NULL);
+
+        *list = realloc(*list, (count + num_devices) * sizeof(clDeviceInfo));
+        for (cl_uint d = 0; d < num_devices; ++d)
+        {
+            clDeviceInfo *info = *list + count;
+            info->platform = platforms[p];
+            info->device   = ids[d];
+            info->index    = count++;
+            clGetDeviceInfo(ids[d], CL_DEVICE_TYPE, sizeof(cl_device_type), &info->type, NULL);
+            clGetDeviceInfo(ids[d], CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &info->memory, NULL);
+            clGetDeviceInfo(ids[d], CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &info->computeUnits, NULL);
+            info->name[0] = '\0';
+            clGetDeviceInfo(ids[d], CL_DEVICE_NAME, sizeof(info->name), info->name, NULL);
+            info->name[sizeof(info->name) - 1] = '\0';
+        }
+        free(ids);
     }
+    free(platforms);
 
-    // Allocate memory for platforms
-    *platforms = (cl_platform_id*) malloc(num_platforms * sizeof(cl_platform_id));
+    qsort(*list, count, sizeof(clDeviceInfo), compare_devices);
+    for (int i = 0; i < count; ++i)
+    {
+        (*list)[i].index = i;
+    }
+    return count;
+}
 
-    // Get platforms
-    cl_status = clGetPlatformIDs(num_platforms, *platforms, NULL);
+void cl_print_devices(
+        const clDeviceInfo *list,
+        int                count)
+{
+    printf("Device  Type         Memory (MiB)  Compute units  Name\n");
+    for (int i = 0; i < count; ++i)
+    {
+        const char *type = (list[i].type & CL_DEVICE_TYPE_GPU) ? "GPU"
+            : (list[i].type & CL_DEVICE_TYPE_ACCELERATOR) ? "Accelerator"
+            : (list[i].type & CL_DEVICE_TYPE_CPU) ? "CPU" : "Other";
+        printf("%6d  %-11s  %12llu  %13u  %s\n", i, type,
+                (unsigned long long) (list[i].memory >> 20), list[i].computeUnits, list[i].name);
+    }
+}
 
-    if (cl_status != CL_SUCCESS)
+/**
+ * \brief Index of the device of the rank \a node_rank of a node
+ *
+ * \a selection is a comma-separated list of device indices assigned round
+ * robin, or NULL to use every GPU and accelerator (every device if there are
+ * none) round robin.
+ */
+static int select_device(
+        const clDeviceInfo *list,
+        int                count,
+        int                node_rank,
+        const char         *selection)
+{
+    if (selection != NULL && *selection != '\0')
     {
-        fprintf(stderr, "[CRITICAL ERROR] Problem with getting platform IDs (status %d)\n", cl_status);
-        free(*platforms);
-        exit(EXIT_FAILURE);
+        int  indices[MAX_SELECTED_DEVICES];
+        int  n = 0;
+        const char *s = selection;
+        while (*s != '\0')
+        {
+            char *end;
+            long v = strtol(s, &end, 10);
+            if (end == s || v < 0 || v >= count || n == MAX_SELECTED_DEVICES)
+            {
+                fprintf(stderr, "[CRITICAL ERROR] Invalid device selection '%s', %d devices found.\n", selection, count);
+                exit(EXIT_FAILURE);
+            }
+            indices[n++] = (int) v;
+            s = (*end == ',') ? end + 1 : end;
+            if (*end != ',' && *end != '\0')
+            {
+                fprintf(stderr, "[CRITICAL ERROR] Invalid device selection '%s', %d devices found.\n", selection, count);
+                exit(EXIT_FAILURE);
+            }
+        }
+        return indices[node_rank % n];
     }
 
-    // Get devices count from first available platform;
-    cl_status = clGetDeviceIDs(*platforms[0], CL_DEVICE_TYPE_GPU, 0, NULL, &num_devices);
+    int accelerators = 0;
+    while (accelerators < count && !(list[accelerators].type & CL_DEVICE_TYPE_CPU))
+    {
+        ++accelerators;
+    }
+    return node_rank % ((accelerators > 0) ? accelerators : count);
+}
 
+void cl_init(
+		cl_platform_id       **platforms,
+		cl_device_id         **devices,
+		cl_context           *context,
+		cl_command_queue     *queue,
+        clsparseCreateResult *createResult,
+        MPI_Comm             node_comm,
+        const char           *selection)
+{
+	cl_int cl_status = CL_SUCCESS;
+    clDeviceInfo *list;
+    int node_rank; MPI_Comm_rank(node_comm, &node_rank);
+
+    // Every rank of a node sees the same devices in the same order
+    int num_devices = cl_list_devices(&list);
     if (num_devices == 0)
     {
-        fprintf(stderr, "[CRITICAL ERROR] No OpenCL GPU devices found on platform 0.\n");
-        free(*platforms);
+        fprintf(stderr, "[CRITICAL ERROR] No OpenCL devices found.\n");
         exit(EXIT_FAILURE);
     }
 
-    // Allocate space for devices
-    *devices = ((cl_device_id*) malloc(num_devices * sizeof(cl_device_id)));
+    int selected = select_device(list, num_devices, node_rank, selection);
+    if (node_rank == 0)
+    {
+        // The assignment only depends on the node rank, the first rank of the node reports it for all
+        int my_rank;   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+        int node_size; MPI_Comm_size(node_comm, &node_size);
+        int *ranks = calloc(num_devices, sizeof(int));
+        for (int r = 0; r < node_size; ++r)
+        {
+            ranks[select_device(list, num_devices, r, selection)]++;
+        }
+        for (int d = 0; d < num_devices; ++d)
+        {
+            if (ranks[d] > 0)
+            {
+                printf("P%d: device %d, %s, %d of the %d ranks of the node\n", my_rank, d, list[d].name, ranks[d],
+                        node_size);
+            }
+        }
+        free(ranks);
+    }
 
-    // Get devices from platform 0;
-    cl_status = clGetDeviceIDs(*platforms[0], CL_DEVICE_TYPE_GPU, num_devices, *devices, NULL);
+    *platforms = malloc(sizeof(cl_platform_id));
+    *devices   = malloc(sizeof(cl_device_id));
+    (*platforms)[0] = list[selected].platform;
+    (*devices)[0]   = list[selected].device;
+    free(list);
 
+    // Get context and queue
+    cl_context_properties properties[] = {CL_CONTEXT_PLATFORM, (cl_context_properties) (*platforms)[0], 0};
+    *context = clCreateContext(properties, 1, *devices, NULL, NULL, &cl_status);
     if (cl_status != CL_SUCCESS)
     {
-        printf("[CRITICAL ERROR] Problem with getting device id from platform.\n");
-        free(*devices);
-        free(*platforms);
+        fprintf(stderr, "[CRITICAL ERROR] Problem with creating the context of device %d (status %d)\n", selected, cl_status);
         exit(EXIT_FAILURE);
     }
+    *queue = clCreateCommandQueue(*context, (*devices)[0], timing_enabled() ? CL_QUEUE_PROFILING_ENABLE : 0, NULL);
 
-    // Get context and queue
-    *context = clCreateContext(NULL, 1, *devices, NULL, NULL, NULL);
-    *queue = clCreateCommandQueue(*context, *devices[0], 0, NULL);
-
-    // Initialize one_V, minusOne_S, one_S and zero_S constant
-
-    clsparseInitVector(&one_V);
-    one_V.values = clCreateBuffer(*context, CL_MEM_READ_ONLY, sizeof(real_t),
-            NULL, &cl_status);
-    one_V.num_values = 1;
-    real_t oneFloat = 1.0f;
-    cl_status = clEnqueueFillBuffer(*queue, one_V.values, &oneFloat, sizeof(real_t),
-            0, sizeof(real_t), 0, NULL, NULL);
+    // Initialize minusOne_S, one_S and zero_S constant
 
     clsparseInitScalar(&one_S);
     one_S.value = clCreateBuffer(*context, CL_MEM_READ_ONLY, sizeof(real_t),
             NULL, &cl_status);
-    oneFloat = 1.0f;
+    real_t oneFloat = 1.0f;
     cl_status = clEnqueueFillBuffer(*queue, one_S.value, &oneFloat, sizeof(real_t),
             0, sizeof(real_t), 0, NULL, NULL);
 
@@ -104,6 +220,8 @@ void cl_init(
     cl_status = clEnqueueFillBuffer(*queue, zero_S.value, &oneFloat, sizeof(real_t),
             0, sizeof(real_t), 0, NULL, NULL);
 
+    cl_kernels_init(*context, (*devices)[0]);
+
     clsparseStatus status = clsparseSetup();
     if (status != clsparseSuccess)
     {
@@ -114,6 +232,9 @@ void cl_init(
     // Create clSPARSE control object it requires queue for kernel execution
     *createResult = clsparseCreateControl(*queue);
     CLSPARSE_V(createResult->status, "Failed to create clsparse control");
+
+    // Do not wait for each clSPARSE kernel, the queue is in order anyway
+    clsparseEnableAsync(createResult->control, CL_TRUE);
 }
 
 void cl_free(
@@ -135,8 +256,11 @@ void cl_free(
         exit(EXIT_FAILURE);
     }
 
+    cl_kernels_free();
+
     // Free OpenCL resources
-    clReleaseMemObject(one_V.values);
+    clReleaseMemObject(one_S.value);
+    clReleaseMemObject(zero_S.value);
     clReleaseMemObject(minusOne_S.value);
     clReleaseCommandQueue(queue);
     clReleaseContext(context);
@@ -164,13 +288,254 @@ void cl_init_matrix(
     d_mat->col_indices = clCreateBuffer(context, CL_MEM_READ_ONLY, d_mat->num_nonzeros * sizeof(clsparseIdx_t), NULL, &cl_status);
     d_mat->row_pointer = clCreateBuffer(context, CL_MEM_READ_ONLY, (d_mat->num_rows + 1) * sizeof(clsparseIdx_t), NULL, &cl_status);
 
-    clEnqueueWriteBuffer(queue, d_mat->values, CL_TRUE, 0, sizeof(real_t) * host_mat->nNz, host_mat->vals, 0, NULL, NULL);
+    clEnqueueWriteBuffer(queue, d_mat->values, CL_TRUE, 0, sizeof(real_t) * host_mat->nNz, CSR_VALS(host_mat), 0, NULL, NULL);
     clEnqueueWriteBuffer(queue, d_mat->col_indices, CL_TRUE, 0, sizeof(int) * host_mat->nNz, host_mat->cols, 0, NULL, NULL);
     clEnqueueWriteBuffer(queue, d_mat->row_pointer, CL_TRUE, 0, sizeof(int) * (host_mat->nRow + 1), host_mat->rows, 0, NULL, NULL);
 
     clsparseCsrMetaCreate(d_mat, control);
 }
 
+/// \brief Device array filled sequentially from the host, see \a writer_init()
+typedef struct clArrayWriter{
+    cl_command_queue queue;
+    /// Destination on the device
+    cl_mem           dst;
+    /// Size of an element in bytes
+    size_t           elem;
+    /// Elements per staging buffer
+    size_t           chunk;
+    /// Elements already sent
+    size_t           sent;
+    /// Elements in the current staging buffer
+    size_t           fill;
+    /// Current staging buffer
+    int              slot;
+    /// Pinned staging buffers and their mapping, \a dst mapped whole if \a direct
+    cl_mem           staging[2];
+    char             *host[2];
+    /// Transfer of each staging buffer still running
+    cl_event         pending[2];
+    /// Whether \a host[0] maps \a dst itself
+    int              direct;
+}clArrayWriter;
+
+/**
+ * \brief Create a device array of \a count elements of \a elem bytes, to be filled by \a writer_push()
+ *
+ * On a device sharing the host memory the array is mapped and written in
+ * place. Otherwise the values go through two pinned staging buffers of
+ * UPLOAD_CHUNK bytes: one is sent while the other is filled.
+ */
+static void writer_init(
+        clArrayWriter    *w,
+        cl_context       context,
+        cl_command_queue queue,
+        size_t           elem,
+        size_t           count,
+        int              unified)
+{
+    cl_int cl_status;
+    size_t bytes = (count > 0 ? count : 1) * elem;
+
+    w->queue  = queue;
+    w->elem   = elem;
+    w->sent   = 0;
+    w->fill   = 0;
+    w->slot   = 0;
+    w->direct = unified;
+    w->pending[0] = w->pending[1] = NULL;
+    w->staging[0] = w->staging[1] = NULL;
+    if (unified)
+    {
+        w->dst = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, bytes, NULL, &cl_status);
+        w->host[0] = clEnqueueMapBuffer(queue, w->dst, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bytes,
+                0, NULL, NULL, &cl_status);
+        w->chunk = (count > 0 ? count : 1);
+        return;
+    }
+    w->dst   = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &cl_status);
+    w->chunk = UPLOAD_CHUNK / elem;
+    for (int i = 0; i < 2; ++i)
+    {
+        w->staging[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, w->chunk * elem,
+                NULL, &cl_status);
+        w->host[i] = clEnqueueMapBuffer(queue, w->staging[i], CL_TRUE, CL_MAP_WRITE, 0, w->chunk * elem,
+                0, NULL, NULL, &cl_status);
+    }
+}
+
+/**
+ * \brief Send the current staging buffer and switch to the other one once its transfer completed
+ */
+static void writer_flush(
+        clArrayWriter *w)
+{
+    if (w->direct || w->fill == 0)
+    {
+        return;
+    }
+    clEnqueueWriteBuffer(w->queue, w->dst, CL_FALSE, w->sent * w->elem, w->fill * w->elem,
+            w->host[w->slot], 0, NULL, &w->pending[w->slot]);
+    clFlush(w->queue);
+    w->sent += w->fill;
+    w->fill  = 0;
+    w->slot ^= 1;
+    if (w->pending[w->slot] != NULL)
+    {
+        clWaitForEvents(1, &w->pending[w->slot]);
+        clReleaseEvent(w->pending[w->slot]);
+        w->pending[w->slot] = NULL;
+    }
+}
+
+/**
+ * \brief Append one element
+ */
+static void writer_push(
+        clArrayWriter *w,
+        const void    *value)
+{
+    if (w->fill == w->chunk)
+    {
+        writer_flush(w);
+    }
+    memcpy(w->host[w->slot] + w->fill * w->elem, value, w->elem);
+    w->fill++;
+}
+
+/**
+ * \brief Send the last elements and release the staging buffers, return the device array
+ */
+static cl_mem writer_finish(
+        clArrayWriter *w)
+{
+    if (w->direct)
+    {
+        clEnqueueUnmapMemObject(w->queue, w->dst, w->host[0], 0, NULL, NULL);
+        return w->dst;
+    }
+    writer_flush(w);
+    for (int i = 0; i < 2; ++i)
+    {
+        if (w->pending[i] != NULL)
+        {
+            clWaitForEvents(1, &w->pending[i]);
+            clReleaseEvent(w->pending[i]);
+        }
+        clEnqueueUnmapMemObject(w->queue, w->staging[i], w->host[i], 0, NULL, NULL);
+        clReleaseMemObject(w->staging[i]);
+    }
+    return w->dst;
+}
+
+void cl_init_matrix_split(
+        csrMatrix*          host_mat,
+        int                 nOwned,
+        splitCsrMatrix*     d_mat,
+        cl_context          context,
+        cl_command_queue    queue,
+        clsparseControl     control)
+{
+    int nRemote = 0, nRows = 0;
+    for (int i = 0; i < host_mat->nRow; ++i)
+    {
+        int remote = 0;
+        for (int k = host_mat->rows[i]; k < host_mat->rows[i+1]; ++k)
+        {
+            if (host_mat->cols[k] >= nOwned) ++remote;
+        }
+        nRemote += remote;
+        nRows   += (remote > 0);
+    }
+
+    cl_device_id device;
+    cl_bool      unified = CL_FALSE;
+    clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+
+    // The arrays are sent by chunks while the next rows are split
+    const int nInterior = host_mat->nNz - nRemote;
+    clArrayWriter iRows, iCols, iVals, bRows, bCols, bVals, bIdx;
+    writer_init(&iRows, context, queue, sizeof(int), host_mat->nRow + 1, unified);
+    writer_init(&iCols, context, queue, sizeof(int), nInterior, unified);
+    writer_init(&iVals, context, queue, sizeof(real_t), nInterior, unified);
+    writer_init(&bRows, context, queue, sizeof(int), nRows + 1, unified);
+    writer_init(&bCols, context, queue, sizeof(int), nRemote, unified);
+    writer_init(&bVals, context, queue, sizeof(real_t), nRemote, unified);
+    writer_init(&bIdx, context, queue, sizeof(int), nRows, unified);
+
+    int ni = 0, nb = 0;
+    writer_push(&iRows, &ni);
+    writer_push(&bRows, &nb);
+    for (int i = 0; i < host_mat->nRow; ++i)
+    {
+        int rowStart = nb;
+        for (int k = host_mat->rows[i]; k < host_mat->rows[i+1]; ++k)
+        {
+            if (host_mat->cols[k] < nOwned)
+            {
+                writer_push(&iCols, &host_mat->cols[k]);
+                writer_push(&iVals, &CSR_VALS(host_mat)[k]);
+                ++ni;
+            }
+            else
+            {
+                int c = host_mat->cols[k] - nOwned;
+                writer_push(&bCols, &c);
+                writer_push(&bVals, &CSR_VALS(host_mat)[k]);
+                ++nb;
+            }
+        }
+        writer_push(&iRows, &ni);
+        if (nb > rowStart)
+        {
+            writer_push(&bIdx, &i);
+            writer_push(&bRows, &nb);
+        }
+    }
+    d_mat->nBoundary = nRows;
+
+    clsparseInitCsrMatrix(&d_mat->interior);
+    d_mat->interior.num_nonzeros = nInterior;
+    d_mat->interior.num_rows     = host_mat->nRow;
+    d_mat->interior.num_cols     = nOwned;
+    d_mat->interior.row_pointer  = writer_finish(&iRows);
+    d_mat->interior.col_indices  = writer_finish(&iCols);
+    d_mat->interior.values       = writer_finish(&iVals);
+    clsparseCsrMetaCreate(&d_mat->interior, control);
+
+    clsparseInitCsrMatrix(&d_mat->boundary);
+    d_mat->boundary.num_nonzeros = nRemote;
+    d_mat->boundary.num_rows     = nRows;
+    d_mat->boundary.num_cols     = host_mat->nCol - nOwned;
+    d_mat->boundary.row_pointer  = writer_finish(&bRows);
+    d_mat->boundary.col_indices  = writer_finish(&bCols);
+    d_mat->boundary.values       = writer_finish(&bVals);
+    d_mat->boundaryRows          = writer_finish(&bIdx);
+    if (nRows > 0)
+    {
+        clsparseCsrMetaCreate(&d_mat->boundary, control);
+    }
+    else
+    {
+        clReleaseMemObject(d_mat->boundary.row_pointer);
+        clReleaseMemObject(d_mat->boundary.col_indices);
+        clReleaseMemObject(d_mat->boundary.values);
+        clReleaseMemObject(d_mat->boundaryRows);
+    }
+}
+
+void cl_free_matrix_split(
+        splitCsrMatrix*  d_mat)
+{
+    cl_free_matrix(&d_mat->interior);
+    if (d_mat->nBoundary > 0)
+    {
+        cl_free_matrix(&d_mat->boundary);
+        clReleaseMemObject(d_mat->boundaryRows);
+    }
+}
+
 void cl_free_matrix(
         clsparseCsrMatrix*  d_mat)
 {
@@ -180,6 +545,61 @@ void cl_free_matrix(
     clReleaseMemObject(d_mat->row_pointer);
 }
 
+cl_int cl_init_vector_block(
+        cl_context    context,
+        cl_device_id  device,
+        unsigned      length,
+        unsigned      count,
+        cldenseMatrix *block,
+        cldenseVector *vectors)
+{
+    cl_int  cl_status;
+    cl_uint align_bits;
+
+    clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &align_bits, NULL);
+    size_t align = (align_bits / 8) / sizeof(real_t);
+    if (align == 0) align = 1;
+
+    cldenseInitMatrix(block);
+    block->num_rows = length;
+    block->num_cols = count;
+    block->lead_dim = ((length + align - 1) / align) * align;
+    block->major = columnMajor;
+    block->values = clCreateBuffer(context, CL_MEM_READ_WRITE, block->lead_dim * count * sizeof(real_t),
+            NULL, &cl_status);
+    if (cl_status != CL_SUCCESS)
+    {
+        return cl_status;
+    }
+
+    cl_buffer_region region;
+    region.size = length * sizeof(real_t);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        clsparseInitVector(vectors+i);
+        region.origin = i * block->lead_dim * sizeof(real_t);
+        (vectors+i)->values = clCreateSubBuffer(block->values, CL_MEM_READ_WRITE,
+                CL_BUFFER_CREATE_TYPE_REGION, &region, &cl_status);
+        (vectors+i)->num_values = length;
+        if (cl_status != CL_SUCCESS)
+        {
+            return cl_status;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+void cl_free_vector_block(
+        cldenseMatrix *block,
+        cldenseVector *vectors)
+{
+    for (unsigned i = 0; i < block->num_cols; ++i)
+    {
+        clReleaseMemObject((vectors+i)->values);
+    }
+    clReleaseMemObject(block->values);
+}
+
 void cl_print_matrix(
         clsparseCsrMatrix*  d_mat,
         cl_command_queue    queue)
@@ -211,3 +631,221 @@ void cl_print_matrix(
     }
     printf("\n");
 }
+
+void cl_init_queue_pool(
+        cl_context       context,
+        cl_device_id     device,
+        int              count,
+        clQueuePool      *pool)
+{
+    pool->count    = count;
+    pool->queues   = malloc(count * sizeof(cl_command_queue));
+    pool->controls = malloc(count * sizeof(clsparseCreateResult));
+    for (int i = 0; i < count; ++i)
+    {
+        pool->queues[i]   = clCreateCommandQueue(context, device, timing_enabled() ? CL_QUEUE_PROFILING_ENABLE : 0, NULL);
+        pool->controls[i] = clsparseCreateControl(pool->queues[i]);
+        CLSPARSE_V(pool->controls[i].status, "Failed to create clsparse control");
+        clsparseEnableAsync(pool->controls[i].control, CL_TRUE);
+    }
+}
+
+void cl_queue_pool_fork(
+        clQueuePool      *pool,
+        cl_command_queue queue)
+{
+    cl_event ready;
+    clEnqueueMarkerWithWaitList(queue, 0, NULL, &ready);
+    for (int i = 0; i < pool->count; ++i)
+    {
+        clEnqueueBarrierWithWaitList(pool->queues[i], 1, &ready, NULL);
+    }
+    clReleaseEvent(ready);
+}
+
+void cl_queue_pool_join(
+        clQueuePool      *pool,
+        cl_command_queue queue)
+{
+    cl_event *done = malloc(pool->count * sizeof(cl_event));
+    for (int i = 0; i < pool->count; ++i)
+    {
+        clEnqueueMarkerWithWaitList(pool->queues[i], 0, NULL, done + i);
+        clFlush(pool->queues[i]);
+    }
+    clEnqueueBarrierWithWaitList(queue, pool->count, done, NULL);
+    for (int i = 0; i < pool->count; ++i)
+    {
+        clReleaseEvent(done[i]);
+    }
+    free(done);
+}
+
+void cl_free_queue_pool(
+        clQueuePool      *pool)
+{
+    for (int i = 0; i < pool->count; ++i)
+    {
+        clFinish(pool->queues[i]);
+        clsparseReleaseControl(pool->controls[i].control);
+        clReleaseCommandQueue(pool->queues[i]);
+    }
+    free(pool->queues);
+    free(pool->controls);
+}
+
+/**
+ * \brief Path of the cached binary of \a source into \a path, EXIT_FAILURE if there is no cache directory
+ */
+static int program_cache_path(
+        cl_device_id device,
+        const char   *source,
+        const char   *options,
+        char         *path,
+        size_t       size)
+{
+    char dir[4096];
+    const char *env = getenv("SIMULTITE_KERNEL_CACHE");
+    if (env != NULL)
+    {
+        snprintf(dir, sizeof(dir), "%s", env);
+    }
+    else
+    {
+        const char *home = getenv("HOME");
+        if (home == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+        mkdir(dir, 0755);
+        snprintf(dir, sizeof(dir), "%s/.cache/simultite", home);
+    }
+    mkdir(dir, 0755);
+
+    char name[256], driver[256];
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+    clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driver), driver, NULL);
+    unsigned long long h = FNV_OFFSET;
+    h = fnv1a(h, name, strlen(name) + 1);
+    h = fnv1a(h, driver, strlen(driver) + 1);
+    h = fnv1a(h, options, strlen(options) + 1);
+    h = fnv1a(h, source, strlen(source));
+    snprintf(path, size, "%s/%016llx.bin", dir, h);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Program built from the binary in \a path, NULL if missing or rejected
+ */
+static cl_program load_program_binary(
+        cl_context   context,
+        cl_device_id device,
+        const char   *options,
+        const char   *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *binary = malloc(size > 0 ? size : 1);
+    size_t length = fread(binary, 1, size, f);
+    fclose(f);
+
+    cl_int binaryStatus, cl_status;
+    const unsigned char *binaries[1] = {binary};
+    cl_program program = clCreateProgramWithBinary(context, 1, &device, &length, binaries,
+            &binaryStatus, &cl_status);
+    free(binary);
+    if (cl_status == CL_SUCCESS && binaryStatus == CL_SUCCESS)
+    {
+        cl_status = clBuildProgram(program, 1, &device, options, NULL, NULL);
+        if (cl_status == CL_SUCCESS)
+        {
+            return program;
+        }
+    }
+    if (program != NULL)
+    {
+        clReleaseProgram(program);
+    }
+    return NULL;
+}
+
+/**
+ * \brief Store the binary of \a program in \a path, written aside then renamed for concurrent ranks
+ */
+static void store_program_binary(
+        cl_program program,
+        const char *path)
+{
+    size_t size;
+    clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &size, NULL);
+    if (size == 0)
+    {
+        return;
+    }
+    unsigned char *binary = malloc(size);
+    unsigned char *binaries[1] = {binary};
+    clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, NULL);
+
+    char tmp[4200];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f != NULL)
+    {
+        size_t written = fwrite(binary, 1, size, f);
+        fclose(f);
+        if (written == size)
+        {
+            rename(tmp, path);
+        }
+        else
+        {
+            remove(tmp);
+        }
+    }
+    free(binary);
+}
+
+cl_program cl_build_program(
+        cl_context       context,
+        cl_device_id     device,
+        const char       *source,
+        const char       *options)
+{
+    char path[4096];
+    int  cached = (program_cache_path(device, source, options, path, sizeof(path)) == EXIT_SUCCESS);
+    if (cached)
+    {
+        cl_program program = load_program_binary(context, device, options, path);
+        if (program != NULL)
+        {
+            return program;
+        }
+    }
+
+    cl_int cl_status;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &cl_status);
+    cl_status = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    if (cl_status != CL_SUCCESS)
+    {
+        size_t logSize;
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+        char *log = malloc(logSize + 1);
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, logSize, log, NULL);
+        log[logSize] = '\0';
+        fprintf(stderr, "[CRITICAL ERROR] Could not build custom kernels (status %d):\n%s\n", cl_status, log);
+        free(log);
+        exit(EXIT_FAILURE);
+    }
+    if (cached)
+    {
+        store_program_binary(program, path);
+    }
+    return program;
+}
@@ -0,0 +1,337 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cpu_backend.c
+ * \brief Backend running the solver on the host with the OpenMP kernels, without OpenCL
+ *
+ */
+
+#include "cpu_backend.h"
+
+/// \brief SpMV kernels of the CPU backend
+enum {CPU_SPMV_CSR_SCALAR, CPU_SPMV_CSR_VECTOR, CPU_SPMV_MERGE_PATH, CPU_SPMV_SELL, CPU_SPMV_NUM_VARIANTS};
+
+static const char *const cpu_variant_names[CPU_SPMV_NUM_VARIANTS] = {
+    "csr-scalar", "csr-vector", "merge-path", "sell"
+};
+
+/// \brief Matrix and selected SpMV kernel
+typedef struct cpuState{
+    const csrMatrix *mat;
+    int             variant;
+    /// Built when the sliced ELLPACK kernel is selected
+    cpuSellMatrix   sell;
+    /// Segments of \a set_segments(), 0 until then
+    int             segments;
+    int             *offsets;
+}cpuState;
+
+/// \brief Column-major block of vectors on the host
+typedef struct cpuBlock{
+    real_t *values;
+    int    length;
+    int    count;
+}cpuBlock;
+
+/**
+ * \brief Values of the vector \a x
+ */
+static real_t *column(
+        backendVec x)
+{
+    cpuBlock *b = x.block;
+    return b->values + (size_t) x.col * b->length;
+}
+
+/**
+ * \brief Address of the scalar \a s
+ */
+static real_t *scalar(
+        backendScalar s)
+{
+    cpuBlock *b = s.block;
+    return b->values + (size_t) s.col * b->length + s.row;
+}
+
+static void *cpu_create_block(
+        void *state,
+        int  length,
+        int  count)
+{
+    (void) state;
+    cpuBlock *b = malloc(sizeof(cpuBlock));
+    b->values = calloc((size_t) length * count, sizeof(real_t));
+    b->length = length;
+    b->count  = count;
+    return b;
+}
+
+static void cpu_free_block(
+        void *state,
+        void *block)
+{
+    (void) state;
+    free(((cpuBlock*) block)->values);
+    free(block);
+}
+
+static void cpu_write_vector(
+        void         *state,
+        backendVec   x,
+        const real_t *values)
+{
+    (void) state;
+    memcpy(column(x), values, ((cpuBlock*) x.block)->length * sizeof(real_t));
+}
+
+static void cpu_read_vector(
+        void       *state,
+        backendVec x,
+        real_t     *values)
+{
+    (void) state;
+    memcpy(values, column(x), ((cpuBlock*) x.block)->length * sizeof(real_t));
+}
+
+static real_t cpu_read_scalar(
+        void          *state,
+        backendScalar s)
+{
+    (void) state;
+    return *scalar(s);
+}
+
+static void cpu_backend_spmv(
+        void       *state,
+        backendVec x,
+        backendVec y)
+{
+    cpuState *s = state;
+    if (s->mat->stencil != NULL)
+    {
+        cpu_spmv_stencil(s->mat->stencil, column(x), column(y));
+        return;
+    }
+    switch (s->variant)
+    {
+        case CPU_SPMV_CSR_SCALAR: cpu_spmv_scalar(s->mat, column(x), column(y)); break;
+        case CPU_SPMV_MERGE_PATH: cpu_spmv_merge(s->mat, column(x), column(y)); break;
+        case CPU_SPMV_SELL:       cpu_spmv_sell(&s->sell, column(x), column(y)); break;
+        default:                  cpu_spmv(s->mat, column(x), column(y)); break;
+    }
+}
+
+static void cpu_backend_nrm2(
+        void          *state,
+        backendScalar r,
+        backendVec    x)
+{
+    (void) state;
+    *scalar(r) = cpu_nrm2(((cpuBlock*) x.block)->length, column(x));
+}
+
+static void cpu_backend_axpy(
+        void          *state,
+        backendScalar alpha,
+        real_t        sign,
+        backendVec    x,
+        backendVec    y)
+{
+    (void) state;
+    cpu_axpy(((cpuBlock*) x.block)->length, sign * *scalar(alpha), column(x), column(y));
+}
+
+static void cpu_backend_dot_axpy(
+        void          *state,
+        backendScalar h,
+        backendVec    q,
+        backendVec    w)
+{
+    (void) state;
+    const int n = ((cpuBlock*) q.block)->length;
+    *scalar(h) = cpu_dot(n, column(q), column(w));
+    cpu_axpy(n, -*scalar(h), column(q), column(w));
+}
+
+static void cpu_backend_normalize(
+        void          *state,
+        backendScalar nrm,
+        backendVec    x)
+{
+    (void) state;
+    const int n = ((cpuBlock*) x.block)->length;
+    *scalar(nrm) = cpu_nrm2(n, column(x));
+    cpu_scale(n, 1.0 / *scalar(nrm), column(x));
+}
+
+static void cpu_backend_gemm(
+        void *state,
+        void *A,
+        void *B,
+        void *C)
+{
+    (void) state;
+    cpuBlock *a = A, *b = B, *c = C;
+    cpu_gemm(c->length, b->length, c->count, a->values, a->length, b->values, b->length, c->values, c->length);
+}
+
+static void cpu_backend_orthonormalize(
+        void *state,
+        void *block)
+{
+    (void) state;
+    cpuBlock *b = block;
+    cpu_orthonormalize(b->values, b->length, b->count, b->length);
+}
+
+static void cpu_set_segments(
+        void      *state,
+        int       count,
+        const int *offsets)
+{
+    cpuState *s = state;
+    free(s->offsets);
+    s->segments = count;
+    s->offsets  = malloc((count + 1) * sizeof(int));
+    memcpy(s->offsets, offsets, (count + 1) * sizeof(int));
+}
+
+static void cpu_seg_backend_dot_axpy(
+        void          *state,
+        backendScalar h,
+        int           stride,
+        backendVec    q,
+        backendVec    w)
+{
+    cpuState *s = state;
+    // A single segment is the whole vector, its rows shared between the threads
+    if (s->segments == 1)
+    {
+        cpu_backend_dot_axpy(state, h, q, w);
+        return;
+    }
+    cpu_seg_dot_axpy(s->segments, s->offsets, scalar(h), stride, column(q), column(w));
+}
+
+static void cpu_seg_backend_normalize(
+        void          *state,
+        backendScalar nrm,
+        int           stride,
+        backendVec    x)
+{
+    cpuState *s = state;
+    if (s->segments == 1)
+    {
+        const int n = ((cpuBlock*) x.block)->length;
+        *scalar(nrm) = cpu_nrm2(n, column(x));
+        cpu_scale(n, (*scalar(nrm) > 0) ? 1.0 / *scalar(nrm) : 0.0, column(x));
+        return;
+    }
+    cpu_seg_normalize(s->segments, s->offsets, scalar(nrm), stride, column(x));
+}
+
+static void cpu_seg_backend_gemm(
+        void *state,
+        void *A,
+        void *B,
+        void *C)
+{
+    cpuState *s = state;
+    cpuBlock *a = A, *b = B, *c = C;
+    if (s->segments == 1)
+    {
+        cpu_backend_gemm(state, A, B, C);
+        return;
+    }
+    cpu_seg_gemm(s->segments, s->offsets, b->length / s->segments, c->count, a->values, a->length,
+            b->values, b->length, c->values, c->length);
+}
+
+static int cpu_set_spmv_variant(
+        void *state,
+        int  variant)
+{
+    cpuState *s = state;
+    if (s->mat->stencil != NULL)
+    {
+        return (variant == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (variant == s->variant)
+    {
+        return EXIT_SUCCESS;
+    }
+    if (variant == CPU_SPMV_SELL && cpu_sell_init(s->mat, &s->sell) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (s->variant == CPU_SPMV_SELL)
+    {
+        cpu_sell_free(&s->sell);
+    }
+    s->variant = variant;
+    return EXIT_SUCCESS;
+}
+
+static void cpu_finish(
+        void *state)
+{
+    (void) state;
+}
+
+static void cpu_free(
+        void *state)
+{
+    cpuState *s = state;
+    if (s->variant == CPU_SPMV_SELL)
+    {
+        cpu_sell_free(&s->sell);
+    }
+    free(s->offsets);
+    free(s);
+}
+
+void cpu_backend_init(
+        solverBackend   *backend,
+        const csrMatrix *mat)
+{
+    cpuState *s = malloc(sizeof(cpuState));
+    s->mat     = mat;
+    s->variant = (mat->stencil != NULL) ? 0 : CPU_SPMV_CSR_VECTOR;
+    s->segments = 0;
+    s->offsets  = NULL;
+
+    backend->name             = "cpu";
+    backend->state            = s;
+    backend->n                = mat->nRow;
+    backend->rowStart         = 0;
+    backend->fingerprint      = matrix_fingerprint(mat, 0, mat->nRow, "cpu");
+    backend->spmvFlops        = 2.0 * mat->nNz;
+    backend->spmvBytes        = 2.0 * mat->nRow * sizeof(real_t);
+    if (mat->stencil == NULL)
+    {
+        backend->spmvBytes   += (double) mat->nNz * (sizeof(real_t) + sizeof(int)) + (mat->nRow + 1.0) * sizeof(int);
+    }
+    backend->num_variants     = (mat->stencil != NULL) ? 1 : CPU_SPMV_NUM_VARIANTS;
+    backend->variant_names    = (mat->stencil != NULL) ? stencil_variant_names : cpu_variant_names;
+    backend->create_block     = cpu_create_block;
+    backend->create_basis     = NULL;
+    backend->free_block       = cpu_free_block;
+    backend->write_vector     = cpu_write_vector;
+    backend->read_vector      = cpu_read_vector;
+    backend->read_scalar      = cpu_read_scalar;
+    backend->spmv             = cpu_backend_spmv;
+    backend->nrm2             = cpu_backend_nrm2;
+    backend->axpy             = cpu_backend_axpy;
+    backend->dot_axpy         = cpu_backend_dot_axpy;
+    backend->normalize        = cpu_backend_normalize;
+    backend->gemm             = cpu_backend_gemm;
+    backend->orthonormalize   = cpu_backend_orthonormalize;
+    backend->set_segments     = cpu_set_segments;
+    backend->seg_dot_axpy     = cpu_seg_backend_dot_axpy;
+    backend->seg_normalize    = cpu_seg_backend_normalize;
+    backend->seg_gemm         = cpu_seg_backend_gemm;
+    backend->set_spmv_variant = cpu_set_spmv_variant;
+    backend->set_stream       = NULL;
+    backend->finish           = cpu_finish;
+    backend->report           = NULL;
+    backend->free             = cpu_free;
+}
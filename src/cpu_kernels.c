@@ -0,0 +1,462 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file cpu_kernels.c
+ * \brief Host kernels of the CPU backend, parallelized with OpenMP
+ *
+ */
+
+#include "cpu_kernels.h"
+
+/// \brief Largest condition number estimate for which CholQR2 is accurate, as in gram_schmidt.c
+#define CHOLQR_MAX_COND (0.5 / sqrt(REAL_EPSILON))
+
+void cpu_spmv(
+        const csrMatrix *A,
+        const real_t    *x,
+        real_t          *y)
+{
+    // Rows have uneven lengths, guided scheduling balances the non-zeros
+    #pragma omp parallel for schedule(guided)
+    for (int i = 0; i < A->nRow; ++i)
+    {
+        real_t sum = 0;
+        #pragma omp simd reduction(+:sum)
+        for (int k = A->rows[i]; k < A->rows[i+1]; ++k)
+        {
+            sum += CSR_VALS(A)[k] * x[A->cols[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+void cpu_spmv_scalar(
+        const csrMatrix *A,
+        const real_t    *x,
+        real_t          *y)
+{
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < A->nRow; ++i)
+    {
+        real_t sum = 0;
+        for (int k = A->rows[i]; k < A->rows[i+1]; ++k)
+        {
+            sum += CSR_VALS(A)[k] * x[A->cols[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+void cpu_spmv_stencil(
+        const stencilOperator *op,
+        const real_t          *x,
+        real_t                *y)
+{
+    const int    nx = op->nx, ny = op->ny, nz = op->nz;
+    const size_t plane = (size_t) nx * ny;
+    const real_t c  = op->center;
+    const real_t cx = op->coeffs[0], cy = op->coeffs[1], cz = op->coeffs[2];
+    // One line of the grid per iteration, its ends peeled so the inner loops vectorize
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int k = 0; k < nz; ++k)
+    {
+        for (int j = 0; j < ny; ++j)
+        {
+            const size_t line = k * plane + (size_t) j * nx;
+            const real_t *xl = x + line;
+            real_t       *yl = y + line;
+            const real_t *below = (j > 0)      ? xl - nx    : NULL;
+            const real_t *above = (j < ny - 1) ? xl + nx    : NULL;
+            const real_t *back  = (k > 0)      ? xl - plane : NULL;
+            const real_t *front = (k < nz - 1) ? xl + plane : NULL;
+            yl[0] = c * xl[0] + ((nx > 1) ? cx * xl[1] : 0);
+            for (int i = 1; i < nx - 1; ++i)
+            {
+                yl[i] = c * xl[i] + cx * (xl[i - 1] + xl[i + 1]);
+            }
+            if (nx > 1) yl[nx - 1] = c * xl[nx - 1] + cx * xl[nx - 2];
+            if (below != NULL) for (int i = 0; i < nx; ++i) yl[i] += cy * below[i];
+            if (above != NULL) for (int i = 0; i < nx; ++i) yl[i] += cy * above[i];
+            if (back  != NULL) for (int i = 0; i < nx; ++i) yl[i] += cz * back[i];
+            if (front != NULL) for (int i = 0; i < nx; ++i) yl[i] += cz * front[i];
+        }
+    }
+}
+
+/**
+ * \brief Number of rows consumed at the \a diag item of the merge of the row ends with the non-zeros
+ */
+static int merge_path_search(
+        long long       diag,
+        const csrMatrix *A)
+{
+    int lo = (diag > A->nNz) ? (int) (diag - A->nNz) : 0;
+    int hi = (diag < A->nRow) ? (int) diag : A->nRow;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (A->rows[mid + 1] <= diag - mid - 1) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void cpu_spmv_merge(
+        const csrMatrix *A,
+        const real_t    *x,
+        real_t          *y)
+{
+    const long long total = (long long) A->nRow + A->nNz;
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    int    *carryRow = malloc(maxThreads * sizeof(int));
+    real_t *carryVal = malloc(maxThreads * sizeof(real_t));
+    int    team      = 1;
+
+    #pragma omp parallel
+    {
+        int t = 0, nt = 1;
+#ifdef _OPENMP
+        t  = omp_get_thread_num();
+        nt = omp_get_num_threads();
+#endif
+        #pragma omp master
+        team = nt;
+
+        const long long items = (total + nt - 1) / nt;
+        const long long begin = (t * items < total) ? t * items : total;
+        const long long end   = (begin + items < total) ? begin + items : total;
+        int    i   = merge_path_search(begin, A);
+        int    j   = (int) (begin - i);
+        real_t acc = 0;
+        for (long long d = begin; d < end; ++d)
+        {
+            if (j < A->rows[i + 1])
+            {
+                acc += CSR_VALS(A)[j] * x[A->cols[j]];
+                ++j;
+            }
+            else
+            {
+                y[i++] = acc;
+                acc = 0;
+            }
+        }
+        carryRow[t] = i;
+        carryVal[t] = acc;
+    }
+
+    // The row a thread stopped in was finished by the next threads
+    for (int t = 0; t < team; ++t)
+    {
+        if (carryRow[t] < A->nRow)
+        {
+            y[carryRow[t]] += carryVal[t];
+        }
+    }
+    free(carryRow);
+    free(carryVal);
+}
+
+int cpu_sell_init(
+        const csrMatrix *A,
+        cpuSellMatrix   *S)
+{
+    S->nRow    = A->nRow;
+    S->nSlices = (A->nRow + CPU_SELL_SLICE - 1) / CPU_SELL_SLICE;
+    S->offsets = malloc((S->nSlices + 1) * sizeof(int));
+    S->cols    = NULL;
+    S->vals    = NULL;
+    S->offsets[0] = 0;
+    long long size = 0;
+    for (int s = 0; s < S->nSlices; ++s)
+    {
+        int width = 0;
+        for (int r = s * CPU_SELL_SLICE; r < (s + 1) * CPU_SELL_SLICE && r < A->nRow; ++r)
+        {
+            if (A->rows[r+1] - A->rows[r] > width)
+            {
+                width = A->rows[r+1] - A->rows[r];
+            }
+        }
+        size += (long long) width * CPU_SELL_SLICE;
+        S->offsets[s+1] = (size > INT_MAX) ? INT_MAX : (int) size;
+    }
+    if (size - A->nNz > (long long) SELL_MAX_PADDING * A->nNz || size > INT_MAX)
+    {
+        cpu_sell_free(S);
+        return EXIT_FAILURE;
+    }
+
+    S->cols = calloc(size > 0 ? size : 1, sizeof(int));
+    S->vals = calloc(size > 0 ? size : 1, sizeof(real_t));
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < A->nRow; ++r)
+    {
+        const int base = S->offsets[r / CPU_SELL_SLICE] + r % CPU_SELL_SLICE;
+        for (int k = A->rows[r]; k < A->rows[r+1]; ++k)
+        {
+            S->cols[base + (k - A->rows[r]) * CPU_SELL_SLICE] = A->cols[k];
+            S->vals[base + (k - A->rows[r]) * CPU_SELL_SLICE] = CSR_VALS(A)[k];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+void cpu_sell_free(
+        cpuSellMatrix *S)
+{
+    free(S->offsets);
+    free(S->cols);
+    free(S->vals);
+    S->offsets = NULL;
+    S->cols    = NULL;
+    S->vals    = NULL;
+}
+
+void cpu_spmv_sell(
+        const cpuSellMatrix *S,
+        const real_t        *x,
+        real_t              *y)
+{
+    #pragma omp parallel for schedule(guided)
+    for (int s = 0; s < S->nSlices; ++s)
+    {
+        const int begin = S->offsets[s];
+        const int width = (S->offsets[s+1] - begin) / CPU_SELL_SLICE;
+        real_t acc[CPU_SELL_SLICE] = {0};
+        for (int j = 0; j < width; ++j)
+        {
+            const int    *c = S->cols + begin + j * CPU_SELL_SLICE;
+            const real_t *v = S->vals + begin + j * CPU_SELL_SLICE;
+            #pragma omp simd
+            for (int r = 0; r < CPU_SELL_SLICE; ++r)
+            {
+                acc[r] += v[r] * x[c[r]];
+            }
+        }
+        for (int r = 0; r < CPU_SELL_SLICE && s * CPU_SELL_SLICE + r < S->nRow; ++r)
+        {
+            y[s * CPU_SELL_SLICE + r] = acc[r];
+        }
+    }
+}
+
+void cpu_gemm(
+        int          m,
+        int          k,
+        int          nc,
+        const real_t *A,
+        int          lda,
+        const real_t *B,
+        int          ldb,
+        real_t       *C,
+        int          ldc)
+{
+    // Blocks of rows, each column of C built from the columns of A like an axpy
+    #pragma omp parallel for schedule(static)
+    for (int r0 = 0; r0 < m; r0 += 256)
+    {
+        const int r1 = (r0 + 256 < m) ? r0 + 256 : m;
+        for (int c = 0; c < nc; ++c)
+        {
+            real_t *Cc = C + (size_t) c * ldc;
+            for (int r = r0; r < r1; ++r)
+            {
+                Cc[r] = 0;
+            }
+            for (int i = 0; i < k; ++i)
+            {
+                const real_t  b  = B[(size_t) c * ldb + i];
+                const real_t *Ai = A + (size_t) i * lda;
+                #pragma omp simd
+                for (int r = r0; r < r1; ++r)
+                {
+                    Cc[r] += b * Ai[r];
+                }
+            }
+        }
+    }
+}
+
+void cpu_seg_gemm(
+        int          count,
+        const int    *offsets,
+        int          k,
+        int          nc,
+        const real_t *A,
+        int          lda,
+        const real_t *B,
+        int          ldb,
+        real_t       *C,
+        int          ldc)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (int g = 0; g < count; ++g)
+    {
+        for (int c = 0; c < nc; ++c)
+        {
+            real_t       *Cc = C + (size_t) c * ldc;
+            const real_t *Bc = B + (size_t) c * ldb + (size_t) g * k;
+            for (int r = offsets[g]; r < offsets[g + 1]; ++r)
+            {
+                Cc[r] = 0;
+            }
+            for (int i = 0; i < k; ++i)
+            {
+                const real_t *Ai = A + (size_t) i * lda;
+                #pragma omp simd
+                for (int r = offsets[g]; r < offsets[g + 1]; ++r)
+                {
+                    Cc[r] += Bc[i] * Ai[r];
+                }
+            }
+        }
+    }
+}
+
+void cpu_seg_dot_axpy(
+        int          count,
+        const int    *offsets,
+        real_t       *h,
+        int          stride,
+        const real_t *q,
+        real_t       *w)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (int g = 0; g < count; ++g)
+    {
+        double dot = 0.0;
+        #pragma omp simd reduction(+:dot)
+        for (int i = offsets[g]; i < offsets[g + 1]; ++i)
+        {
+            dot += (double) q[i] * w[i];
+        }
+        h[(size_t) g * stride] = (real_t) dot;
+        #pragma omp simd
+        for (int i = offsets[g]; i < offsets[g + 1]; ++i)
+        {
+            w[i] -= (real_t) dot * q[i];
+        }
+    }
+}
+
+void cpu_seg_normalize(
+        int          count,
+        const int    *offsets,
+        real_t       *nrm,
+        int          stride,
+        real_t       *x)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (int g = 0; g < count; ++g)
+    {
+        double sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for (int i = offsets[g]; i < offsets[g + 1]; ++i)
+        {
+            sum += (double) x[i] * x[i];
+        }
+        const real_t norm = (real_t) sqrt(sum);
+        const real_t inv  = (norm > 0) ? 1 / norm : 0;
+        nrm[(size_t) g * stride] = norm;
+        #pragma omp simd
+        for (int i = offsets[g]; i < offsets[g + 1]; ++i)
+        {
+            x[i] *= inv;
+        }
+    }
+}
+
+double cpu_dot(
+        int          n,
+        const real_t *x,
+        const real_t *y)
+{
+    double sum = 0.0;
+    #pragma omp parallel for simd reduction(+:sum) schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+        sum += (double) x[i] * y[i];
+    }
+    return sum;
+}
+
+double cpu_nrm2(
+        int          n,
+        const real_t *x)
+{
+    return sqrt(cpu_dot(n, x, x));
+}
+
+void cpu_axpy(
+        int          n,
+        real_t       alpha,
+        const real_t *x,
+        real_t       *y)
+{
+    #pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+void cpu_scale(
+        int          n,
+        real_t       alpha,
+        real_t       *x)
+{
+    #pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+        x[i] *= alpha;
+    }
+}
+
+void cpu_orthonormalize(
+        real_t *V,
+        int    m,
+        int    n,
+        int    ld)
+{
+    double *G = malloc(n * n * sizeof(double));
+    double *R = malloc(n * n * sizeof(double));
+
+    // CholQR2: the second pass restores the orthogonality lost by the first one
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i; j < n; ++j)
+            {
+                G[i*n + j] = G[j*n + i] = cpu_dot(m, V + i*ld, V + j*ld);
+            }
+        }
+
+        if (dense_cholesky(G, R, n) != EXIT_SUCCESS
+                || (pass == 0 && dense_triangular_cond(R, n) > CHOLQR_MAX_COND))
+        {
+            double *work = malloc(ld * n * sizeof(double));
+            for (int i = 0; i < ld * n; ++i) work[i] = V[i];
+            dense_tsqr(work, m, n, ld);
+            for (int i = 0; i < ld * n; ++i) V[i] = work[i];
+            free(work);
+            break;
+        }
+
+        // V := V R^-1, column j only depends on the columns before it
+        for (int j = 0; j < n; ++j)
+        {
+            for (int k = 0; k < j; ++k)
+            {
+                cpu_axpy(m, -R[k*n + j], V + k*ld, V + j*ld);
+            }
+            cpu_scale(m, 1.0 / R[j*n + j], V + j*ld);
+        }
+    }
+
+    free(R);
+    free(G);
+}
@@ -0,0 +1,278 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file dense_utils.c
+ * \brief Small dense linear algebra on host used by the block orthonormalization and the refinement
+ *
+ */
+
+#include "dense_utils.h"
+
+/// \brief Minimal number of rows of a TSQR block
+#define TSQR_BLOCK_ROWS 64
+
+int dense_cholesky(
+        const double *G,
+        double       *R,
+        int          n)
+{
+    memset(R, 0, n * n * sizeof(double));
+
+    for (int i = 0; i < n; ++i)
+    {
+        double pivot = G[i*n + i];
+        for (int k = 0; k < i; ++k)
+        {
+            pivot -= R[k*n + i] * R[k*n + i];
+        }
+        if (!(pivot > 0.0))
+        {
+            return EXIT_FAILURE;
+        }
+        R[i*n + i] = sqrt(pivot);
+
+        for (int j = i + 1; j < n; ++j)
+        {
+            double s = G[i*n + j];
+            for (int k = 0; k < i; ++k)
+            {
+                s -= R[k*n + i] * R[k*n + j];
+            }
+            R[i*n + j] = s / R[i*n + i];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+double dense_triangular_cond(
+        const double *R,
+        int          n)
+{
+    double min = fabs(R[0]), max = fabs(R[0]);
+    for (int i = 1; i < n; ++i)
+    {
+        double d = fabs(R[i*n + i]);
+        if (d < min) min = d;
+        if (d > max) max = d;
+    }
+    return (min > 0.0) ? max / min : INFINITY;
+}
+
+/**
+ * \brief Householder QR of the column-major \a m x \a n matrix \a A (m >= n)
+ *
+ * R is stored in the upper triangle, the reflectors below the diagonal with
+ * an implicit unit first entry, as LAPACK's geqr2 does.
+ */
+static void householder_qr(
+        double *A,
+        int    m,
+        int    n,
+        int    lda,
+        double *tau)
+{
+    for (int k = 0; k < n; ++k)
+    {
+        double *x = A + k*lda;
+        double norm = 0.0;
+        for (int i = k; i < m; ++i)
+        {
+            norm += x[i] * x[i];
+        }
+        norm = sqrt(norm);
+
+        if (norm == 0.0)
+        {
+            tau[k] = 0.0;
+            continue;
+        }
+
+        double alpha = x[k];
+        double beta = (alpha > 0.0) ? -norm : norm;
+        for (int i = k + 1; i < m; ++i)
+        {
+            x[i] /= (alpha - beta);
+        }
+        tau[k] = (beta - alpha) / beta;
+        x[k] = beta;
+
+        // Apply the reflector to the trailing columns
+        for (int j = k + 1; j < n; ++j)
+        {
+            double *a = A + j*lda;
+            double s = a[k];
+            for (int i = k + 1; i < m; ++i)
+            {
+                s += x[i] * a[i];
+            }
+            s *= tau[k];
+            a[k] -= s;
+            for (int i = k + 1; i < m; ++i)
+            {
+                a[i] -= s * x[i];
+            }
+        }
+    }
+}
+
+/**
+ * \brief Form the \a m x \a n explicit Q factor from the output of \a householder_qr()
+ */
+static void householder_form_q(
+        const double *A,
+        int          m,
+        int          n,
+        int          lda,
+        const double *tau,
+        double       *Q,
+        int          ldq)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < m; ++i)
+        {
+            Q[j*ldq + i] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    for (int k = n - 1; k >= 0; --k)
+    {
+        const double *v = A + k*lda;
+        for (int j = k; j < n; ++j)
+        {
+            double *q = Q + j*ldq;
+            double s = q[k];
+            for (int i = k + 1; i < m; ++i)
+            {
+                s += v[i] * q[i];
+            }
+            s *= tau[k];
+            q[k] -= s;
+            for (int i = k + 1; i < m; ++i)
+            {
+                q[i] -= s * v[i];
+            }
+        }
+    }
+}
+
+void dense_tsqr(
+        double *V,
+        int    m,
+        int    n,
+        int    ld)
+{
+    int blockRows = (n > TSQR_BLOCK_ROWS) ? n : TSQR_BLOCK_ROWS;
+    int nb = m / blockRows;
+    if (nb < 1) nb = 1;
+
+    double *W   = malloc(m * n * sizeof(double));
+    double *tau = malloc(nb * n * sizeof(double));
+    for (int j = 0; j < n; ++j)
+    {
+        memcpy(W + j*m, V + j*ld, m * sizeof(double));
+    }
+
+    if (nb == 1)
+    {
+        householder_qr(W, m, n, m, tau);
+        householder_form_q(W, m, n, m, tau, V, ld);
+        free(tau);
+        free(W);
+        return;
+    }
+
+    // Factorize each row block and stack the R factors
+    int    ls  = nb * n;
+    double *S  = calloc(ls * n, sizeof(double));
+    double *Qs = malloc(ls * n * sizeof(double));
+    double *ts = malloc(n * sizeof(double));
+    for (int b = 0; b < nb; ++b)
+    {
+        int start = (b * m) / nb;
+        int rows  = ((b + 1) * m) / nb - start;
+        householder_qr(W + start, rows, n, m, tau + b*n);
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i <= j; ++i)
+            {
+                S[j*ls + b*n + i] = W[j*m + start + i];
+            }
+        }
+    }
+    householder_qr(S, ls, n, ls, ts);
+    householder_form_q(S, ls, n, ls, ts, Qs, ls);
+
+    // V_b = Q_b * Qs_b
+    double *Qb = malloc(((m + nb - 1) / nb + 1) * n * sizeof(double));
+    for (int b = 0; b < nb; ++b)
+    {
+        int start = (b * m) / nb;
+        int rows  = ((b + 1) * m) / nb - start;
+        householder_form_q(W + start, rows, n, m, tau + b*n, Qb, rows);
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i < rows; ++i)
+            {
+                double s = 0.0;
+                for (int k = 0; k < n; ++k)
+                {
+                    s += Qb[k*rows + i] * Qs[j*ls + b*n + k];
+                }
+                V[j*ld + start + i] = s;
+            }
+        }
+    }
+
+    free(Qb);
+    free(ts);
+    free(Qs);
+    free(S);
+    free(tau);
+    free(W);
+}
+
+void dense_lu_solve(
+        double *A,
+        double *b,
+        int    n,
+        double tiny)
+{
+    for (int k = 0; k < n; ++k)
+    {
+        int p = k;
+        for (int i = k + 1; i < n; ++i)
+        {
+            if (fabs(A[i*n + k]) > fabs(A[p*n + k])) p = i;
+        }
+        if (p != k)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                double t = A[k*n + j]; A[k*n + j] = A[p*n + j]; A[p*n + j] = t;
+            }
+            double t = b[k]; b[k] = b[p]; b[p] = t;
+        }
+        if (fabs(A[k*n + k]) < tiny)
+        {
+            A[k*n + k] = (A[k*n + k] < 0.0) ? -tiny : tiny;
+        }
+        for (int i = k + 1; i < n; ++i)
+        {
+            double l = A[i*n + k] / A[k*n + k];
+            for (int j = k + 1; j < n; ++j)
+            {
+                A[i*n + j] -= l * A[k*n + j];
+            }
+            b[i] -= l * b[k];
+        }
+    }
+    for (int k = n - 1; k >= 0; --k)
+    {
+        double s = b[k];
+        for (int j = k + 1; j < n; ++j)
+        {
+            s -= A[k*n + j] * b[j];
+        }
+        b[k] = s / A[k*n + k];
+    }
+}
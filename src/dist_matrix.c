@@ -0,0 +1,451 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file dist_matrix.c
+ * \brief Row-partitioned CSR matrix shared by the ranks of a communicator
+ *
+ */
+
+#include "dist_matrix.h"
+
+/// \brief Tag of the ghost value messages
+#define HALO_TAG 30
+
+int dist_row_start(
+        int n,
+        int num_ranks,
+        int rank)
+{
+    return (int) (((long long) rank * n) / num_ranks);
+}
+
+static int compare_int(
+        const void *a,
+        const void *b)
+{
+    int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+void dist_init_matrix(
+        csrMatrix*        host_mat,
+        distCsrMatrix*    dm,
+        MPI_Comm          comm,
+        const int*        rowOffsets,
+        cl_context        context,
+        cl_command_queue  queue,
+        clsparseControl   control)
+{
+    cl_int cl_status;
+
+    dm->comm = comm;
+    MPI_Comm_size(comm, &dm->num_ranks);
+    MPI_Comm_rank(comm, &dm->rank);
+    dm->nGlobal  = host_mat->nRow;
+    dm->rowOffsets = malloc((dm->num_ranks + 1) * sizeof(int));
+    for (int r = 0; r <= dm->num_ranks; ++r)
+    {
+        dm->rowOffsets[r] = (rowOffsets != NULL) ? rowOffsets[r] : dist_row_start(host_mat->nRow, dm->num_ranks, r);
+    }
+    dm->rowStart = dm->rowOffsets[dm->rank];
+    dm->nLocal   = dm->rowOffsets[dm->rank + 1] - dm->rowStart;
+    dm->stencil  = host_mat->stencil;
+    if (dm->stencil != NULL)
+    {
+        if (dm->num_ranks > 1)
+        {
+            fprintf(stderr, "[CRITICAL ERROR] A matrix-free operator cannot be distributed\n");
+            exit(EXIT_FAILURE);
+        }
+        dm->nGhost = dm->nRemoteNz = dm->nSend = 0;
+        dist_reset_overlap(dm);
+        return;
+    }
+
+    int rowEnd = dm->rowStart + dm->nLocal;
+    int first  = host_mat->rows[dm->rowStart];
+    int nNz    = host_mat->rows[rowEnd] - first;
+
+    // Sorted list of the remote columns referenced by the local rows
+    int *ghosts = malloc((nNz > 0 ? nNz : 1) * sizeof(int));
+    int nGhost = 0;
+    for (int k = first; k < first + nNz; ++k)
+    {
+        int c = host_mat->cols[k];
+        if (c < dm->rowStart || c >= rowEnd)
+        {
+            ghosts[nGhost++] = c;
+        }
+    }
+    dm->nRemoteNz = nGhost;
+    qsort(ghosts, nGhost, sizeof(int), compare_int);
+    int unique = 0;
+    for (int k = 0; k < nGhost; ++k)
+    {
+        if (unique == 0 || ghosts[unique - 1] != ghosts[k])
+        {
+            ghosts[unique++] = ghosts[k];
+        }
+    }
+    dm->nGhost = unique;
+    dm->ghostCols = ghosts;
+
+    // Local rows with renumbered columns
+    csrMatrix local;
+    local.nRow = dm->nLocal;
+    local.nCol = dm->nLocal + dm->nGhost;
+    local.nNz  = nNz;
+    local.stencil = NULL;
+    local.rows = malloc((dm->nLocal + 1) * sizeof(int));
+    local.cols = malloc((nNz > 0 ? nNz : 1) * sizeof(int));
+    CSR_VALS(&local) = CSR_VALS(host_mat) + first;
+    for (int i = 0; i <= dm->nLocal; ++i)
+    {
+        local.rows[i] = host_mat->rows[dm->rowStart + i] - first;
+    }
+    for (int k = 0; k < nNz; ++k)
+    {
+        int c = host_mat->cols[first + k];
+        if (c >= dm->rowStart && c < rowEnd)
+        {
+            local.cols[k] = c - dm->rowStart;
+        }
+        else
+        {
+            int *g = bsearch(&c, dm->ghostCols, dm->nGhost, sizeof(int), compare_int);
+            local.cols[k] = dm->nLocal + (int) (g - dm->ghostCols);
+        }
+    }
+    cl_init_matrix_split(&local, dm->nLocal, &dm->local, context, queue, control);
+    cl_spmv_init(&dm->interiorSpmv, &dm->local.interior);
+    free(local.rows);
+    free(local.cols);
+
+    // Ghosts are sorted by global index, hence grouped by owner
+    dm->sendCounts = calloc(dm->num_ranks, sizeof(int));
+    dm->sendDispls = calloc(dm->num_ranks, sizeof(int));
+    dm->recvCounts = calloc(dm->num_ranks, sizeof(int));
+    dm->recvDispls = calloc(dm->num_ranks, sizeof(int));
+    int owner = 0;
+    for (int k = 0; k < dm->nGhost; ++k)
+    {
+        while (dm->ghostCols[k] >= dm->rowOffsets[owner + 1])
+        {
+            ++owner;
+        }
+        dm->recvCounts[owner]++;
+    }
+    MPI_Alltoall(dm->recvCounts, 1, MPI_INT, dm->sendCounts, 1, MPI_INT, comm);
+    dm->nSend = 0;
+    for (int r = 0; r < dm->num_ranks; ++r)
+    {
+        dm->sendDispls[r] = dm->nSend;
+        dm->nSend += dm->sendCounts[r];
+        if (r > 0)
+        {
+            dm->recvDispls[r] = dm->recvDispls[r-1] + dm->recvCounts[r-1];
+        }
+    }
+
+    int *sendIdx = malloc((dm->nSend > 0 ? dm->nSend : 1) * sizeof(int));
+    MPI_Alltoallv(dm->ghostCols, dm->recvCounts, dm->recvDispls, MPI_INT,
+            sendIdx, dm->sendCounts, dm->sendDispls, MPI_INT, comm);
+    for (int k = 0; k < dm->nSend; ++k)
+    {
+        sendIdx[k] -= dm->rowStart;
+    }
+
+    dm->hostSend = malloc((dm->nSend > 0 ? dm->nSend : 1) * sizeof(real_t));
+    dm->hostRecv = malloc((dm->nGhost > 0 ? dm->nGhost : 1) * sizeof(real_t));
+
+    dm->sendIdx = clCreateBuffer(context, CL_MEM_READ_ONLY, (dm->nSend > 0 ? dm->nSend : 1) * sizeof(int),
+            NULL, &cl_status);
+    if (dm->nSend > 0)
+    {
+        clEnqueueWriteBuffer(queue, dm->sendIdx, CL_TRUE, 0, dm->nSend * sizeof(int), sendIdx, 0, NULL, NULL);
+    }
+    free(sendIdx);
+
+    clsparseInitVector(&dm->sendBuf);
+    dm->sendBuf.values = clCreateBuffer(context, CL_MEM_READ_WRITE, (dm->nSend > 0 ? dm->nSend : 1) * sizeof(real_t),
+            NULL, &cl_status);
+    dm->sendBuf.num_values = dm->nSend;
+
+    clsparseInitVector(&dm->ghostBuf);
+    dm->ghostBuf.values = clCreateBuffer(context, CL_MEM_READ_ONLY, (dm->nGhost > 0 ? dm->nGhost : 1) * sizeof(real_t),
+            NULL, &cl_status);
+    dm->ghostBuf.num_values = dm->nGhost;
+
+    clsparseInitVector(&dm->yBoundary);
+    dm->yBoundary.values = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            (dm->local.nBoundary > 0 ? dm->local.nBoundary : 1) * sizeof(real_t), NULL, &cl_status);
+    dm->yBoundary.num_values = dm->local.nBoundary;
+
+    dm->requests = malloc(2 * dm->num_ranks * sizeof(MPI_Request));
+    dist_reset_overlap(dm);
+}
+
+void dist_print_halo(
+        distCsrMatrix*    dm)
+{
+    int local[4] = {dm->nLocal, dm->nRemoteNz, dm->nGhost, dm->nSend};
+    int *all = NULL;
+    if (dm->rank == 0)
+    {
+        all = malloc(4 * dm->num_ranks * sizeof(int));
+    }
+    MPI_Gather(local, 4, MPI_INT, all, 4, MPI_INT, 0, dm->comm);
+
+    if (dm->rank == 0)
+    {
+        long long total = 0;
+        printf("Rank      Rows  Cut entries  Ghosts recv  Values sent  Bytes/SpMV\n");
+        for (int r = 0; r < dm->num_ranks; ++r)
+        {
+            long long bytes = (long long) (all[4*r+2] + all[4*r+3]) * sizeof(real_t);
+            total += all[4*r+3] * sizeof(real_t);
+            printf("%4d %9d %12d %12d %12d %11lld\n", r, all[4*r], all[4*r+1], all[4*r+2], all[4*r+3], bytes);
+        }
+        printf("Total bytes exchanged per SpMV: %lld\n", total);
+        free(all);
+    }
+}
+
+void dist_print_overlap(
+        distCsrMatrix*    dm,
+        const char*       label,
+        int               total)
+{
+    double local[2], worst[2];
+    int    count = dm->nExchanges;
+
+    if (total)
+    {
+        local[0] = dm->totalExchangeTime;
+        local[1] = dm->totalExposedTime;
+    }
+    else
+    {
+        local[0] = dm->exchangeTime;
+        local[1] = dm->exposedTime;
+    }
+    MPI_Reduce(local, worst, 2, MPI_DOUBLE, MPI_MAX, 0, dm->comm);
+
+    if (dm->rank == 0)
+    {
+        double hidden = (worst[0] > 0.0) ? 100.0 * (1.0 - worst[1] / worst[0]) : 100.0;
+        if (total)
+        {
+            printf("%s: halo exchange %.3f ms, %.3f ms exposed, %.1f%% hidden\n", label,
+                    1e3 * worst[0], 1e3 * worst[1], hidden);
+        }
+        else
+        {
+            printf("%s: %d halo exchanges, %.3f ms, %.3f ms exposed, %.1f%% hidden\n", label, count,
+                    1e3 * worst[0], 1e3 * worst[1], hidden);
+        }
+    }
+    dm->exchangeTime = dm->exposedTime = 0.0;
+    dm->nExchanges = 0;
+}
+
+int dist_set_spmv_variant(
+        distCsrMatrix*    dm,
+        clSpmvVariant_t   variant,
+        cl_context        context,
+        cl_command_queue  queue)
+{
+    if (dm->stencil != NULL)
+    {
+        return (variant == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return cl_spmv_set_variant(&dm->interiorSpmv, variant, context, queue);
+}
+
+void dist_reset_overlap(
+        distCsrMatrix*    dm)
+{
+    dm->exchangeTime = dm->exposedTime = 0.0;
+    dm->totalExchangeTime = dm->totalExposedTime = 0.0;
+    dm->nExchanges = 0;
+}
+
+void dist_free_matrix(
+        distCsrMatrix*    dm)
+{
+    free(dm->rowOffsets);
+    if (dm->stencil != NULL)
+    {
+        return;
+    }
+    cl_spmv_free(&dm->interiorSpmv);
+    cl_free_matrix_split(&dm->local);
+    clReleaseMemObject(dm->sendIdx);
+    clReleaseMemObject(dm->sendBuf.values);
+    clReleaseMemObject(dm->ghostBuf.values);
+    clReleaseMemObject(dm->yBoundary.values);
+    free(dm->requests);
+    free(dm->ghostCols);
+    free(dm->sendCounts);
+    free(dm->sendDispls);
+    free(dm->recvCounts);
+    free(dm->recvDispls);
+    free(dm->hostSend);
+    free(dm->hostRecv);
+}
+
+void dist_spmv(
+        distCsrMatrix*    dm,
+        cldenseVector*    x,
+        cldenseVector*    y,
+        cl_command_queue  queue,
+        clsparseControl   control)
+{
+    if (dm->stencil != NULL)
+    {
+        cl_kernel_spmv_stencil(queue, dm->stencil, x, y);
+        return;
+    }
+    if (dm->num_ranks == 1)
+    {
+        cl_spmv(&dm->interiorSpmv, x, y, queue, control);
+        return;
+    }
+
+    double start = MPI_Wtime();
+    int    nReq  = 0;
+
+    for (int r = 0; r < dm->num_ranks; ++r)
+    {
+        if (dm->recvCounts[r] > 0)
+        {
+            MPI_Irecv(dm->hostRecv + dm->recvDispls[r], dm->recvCounts[r], MPI_REAL_T, r, HALO_TAG,
+                    dm->comm, &dm->requests[nReq++]);
+        }
+    }
+    if (dm->nSend > 0)
+    {
+        cl_kernel_gather(queue, &dm->sendBuf, dm->sendIdx, x);
+        clEnqueueReadBuffer(queue, dm->sendBuf.values, CL_TRUE, 0, dm->nSend * sizeof(real_t),
+                dm->hostSend, 0, NULL, NULL);
+    }
+    for (int r = 0; r < dm->num_ranks; ++r)
+    {
+        if (dm->sendCounts[r] > 0)
+        {
+            MPI_Isend(dm->hostSend + dm->sendDispls[r], dm->sendCounts[r], MPI_REAL_T, r, HALO_TAG,
+                    dm->comm, &dm->requests[nReq++]);
+        }
+    }
+
+    // The owned columns do not need the ghosts, compute them meanwhile
+    cl_spmv(&dm->interiorSpmv, x, y, queue, control);
+    cl_event interiorDone;
+    clEnqueueMarkerWithWaitList(queue, 0, NULL, &interiorDone);
+    clFlush(queue);
+
+    // Poll both sides: the exchange time after the interior product completed is exposed
+    double computed = -1.0;
+    int    arrived  = 0;
+    while (!arrived)
+    {
+        MPI_Testall(nReq, dm->requests, &arrived, MPI_STATUSES_IGNORE);
+        if (computed < 0.0)
+        {
+            cl_int status;
+            clGetEventInfo(interiorDone, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+            if (status == CL_COMPLETE)
+            {
+                computed = MPI_Wtime();
+            }
+        }
+    }
+    double end = MPI_Wtime();
+    clReleaseEvent(interiorDone);
+    timing_trace("halo exchange", TRACE_MPI, start, end);
+
+    dm->exchangeTime      += end - start;
+    dm->totalExchangeTime += end - start;
+    if (computed >= 0.0)
+    {
+        dm->exposedTime      += end - computed;
+        dm->totalExposedTime += end - computed;
+    }
+    dm->nExchanges++;
+
+    if (dm->local.nBoundary > 0)
+    {
+        clEnqueueWriteBuffer(queue, dm->ghostBuf.values, CL_TRUE, 0, dm->nGhost * sizeof(real_t),
+                dm->hostRecv, 0, NULL, NULL);
+#ifdef DOUBLE_PRECISION
+        clsparseDcsrmv(&one_S, &dm->local.boundary, &dm->ghostBuf, &zero_S, &dm->yBoundary, control);
+        cl_kernels_clsparse_event(queue, control, "clsparseDcsrmv");
+#else
+        clsparseScsrmv(&one_S, &dm->local.boundary, &dm->ghostBuf, &zero_S, &dm->yBoundary, control);
+        cl_kernels_clsparse_event(queue, control, "clsparseScsrmv");
+#endif
+        cl_kernel_scatter_add(queue, y, dm->local.boundaryRows, &dm->yBoundary);
+    }
+}
+
+/**
+ * \brief Sum a scalar computed on each rank, squaring it before and taking the root after if \a norm
+ */
+static void allreduce_scalar(
+        distCsrMatrix*    dm,
+        clsparseScalar*   result,
+        int               norm,
+        cl_command_queue  queue)
+{
+    real_t local, global;
+
+    double waited = MPI_Wtime();
+    clEnqueueReadBuffer(queue, result->value, CL_TRUE, result->off_value * sizeof(real_t), sizeof(real_t),
+            &local, 0, NULL, NULL);
+    timing_trace("read scalar", TRACE_WAITS, waited, MPI_Wtime());
+    if (norm) local *= local;
+    MPI_Allreduce(&local, &global, 1, MPI_REAL_T, MPI_SUM, dm->comm);
+    if (norm) global = sqrt(global);
+    clEnqueueWriteBuffer(queue, result->value, CL_TRUE, result->off_value * sizeof(real_t), sizeof(real_t),
+            &global, 0, NULL, NULL);
+}
+
+void dist_dot(
+        distCsrMatrix*    dm,
+        clsparseScalar*   result,
+        cldenseVector*    x,
+        cldenseVector*    y,
+        cl_command_queue  queue,
+        clsparseControl   control)
+{
+#ifdef DOUBLE_PRECISION
+    cldenseDdot(result, x, y, control);
+    cl_kernels_clsparse_event(queue, control, "cldenseDdot");
+#else
+    cldenseSdot(result, x, y, control);
+    cl_kernels_clsparse_event(queue, control, "cldenseSdot");
+#endif
+    if (dm->num_ranks > 1)
+    {
+        allreduce_scalar(dm, result, 0, queue);
+    }
+}
+
+void dist_nrm2(
+        distCsrMatrix*    dm,
+        clsparseScalar*   result,
+        cldenseVector*    x,
+        cl_command_queue  queue,
+        clsparseControl   control)
+{
+#ifdef DOUBLE_PRECISION
+    cldenseDnrm2(result, x, control);
+    cl_kernels_clsparse_event(queue, control, "cldenseDnrm2");
+#else
+    cldenseSnrm2(result, x, control);
+    cl_kernels_clsparse_event(queue, control, "cldenseSnrm2");
+#endif
+    if (dm->num_ranks > 1)
+    {
+        allreduce_scalar(dm, result, 1, queue);
+    }
+}
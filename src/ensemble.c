@@ -0,0 +1,116 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file ensemble.c
+ * \brief Convergence monitoring of the multi-start ensemble
+ *
+ */
+
+#include "ensemble.h"
+
+void ensemble_init(
+        ensembleMonitor *mon,
+        MPI_Comm        comm,
+        int             period,
+        double          lagRatio)
+{
+    mon->comm         = comm;
+    mon->period       = (period > 0) ? period : 1;
+    mon->lagRatio     = lagRatio;
+    mon->iteration    = 0;
+    mon->pending      = 0;
+    mon->state        = ENSEMBLE_RUNNING;
+    mon->lagged       = 0;
+    mon->stallPeriods = 0;
+    mon->stallFloor   = DBL_MAX;
+    mon->stallBest    = DBL_MAX;
+    mon->stallCount   = 0;
+    mon->stalled      = 0;
+    MPI_Comm_rank(comm, &mon->local.rank);
+    mon->local.value  = DBL_MAX;
+    mon->best = mon->local;
+}
+
+/**
+ * \brief Wait for the reduction in flight and update the state from its result
+ */
+static void collect(
+        ensembleMonitor *mon)
+{
+    MPI_Wait(&mon->request, MPI_STATUS_IGNORE);
+    mon->pending = 0;
+    if (mon->best.value < 0.5 * mon->stallBest)
+    {
+        mon->stallBest  = mon->best.value;
+        mon->stallCount = 0;
+    }
+
+    if (mon->best.value < MAX_TOL)
+    {
+        mon->state = ENSEMBLE_STOP;
+    }
+    else if (mon->stallPeriods > 0 && mon->best.value < mon->stallFloor
+            && mon->best.value >= 0.5 * mon->stallBest && ++mon->stallCount >= mon->stallPeriods)
+    {
+        mon->state   = ENSEMBLE_STOP;
+        mon->stalled = 1;
+    }
+    // Floored at MAX_TOL, so that a start is not dropped for missing a best estimate at rounding level
+    else if (mon->state == ENSEMBLE_RUNNING
+            && mon->local.value > mon->lagRatio * ((mon->best.value > MAX_TOL) ? mon->best.value : MAX_TOL))
+    {
+        mon->state = ENSEMBLE_LAGGING;
+        mon->lagged = 1;
+    }
+}
+
+void ensemble_stop_on_stall(
+        ensembleMonitor *mon,
+        int             periods,
+        double          floor)
+{
+    mon->stallPeriods = periods;
+    mon->stallFloor   = floor;
+}
+
+ensembleState_t ensemble_update(
+        ensembleMonitor *mon,
+        double          estimate)
+{
+    mon->iteration++;
+
+    if (mon->pending)
+    {
+        // Let the reduction progress, collected at the next period only
+        int done;
+        MPI_Test(&mon->request, &done, MPI_STATUS_IGNORE);
+    }
+    if (mon->iteration % mon->period != 0)
+    {
+        return mon->state;
+    }
+
+    if (mon->pending)
+    {
+        collect(mon);
+    }
+    if (mon->state == ENSEMBLE_STOP)
+    {
+        return mon->state;
+    }
+    if (mon->state == ENSEMBLE_RUNNING)
+    {
+        mon->local.value = estimate;
+    }
+    MPI_Iallreduce(&mon->local, &mon->best, 1, MPI_DOUBLE_INT, MPI_MINLOC, mon->comm, &mon->request);
+    mon->pending = 1;
+    return mon->state;
+}
+
+void ensemble_finish(
+        ensembleMonitor *mon)
+{
+    if (mon->pending)
+    {
+        collect(mon);
+    }
+}
@@ -9,6 +9,30 @@
 
 CommandLineOptions_t commandLineOptions;
 
+int backend_from_name(
+        const char *name,
+        backend_t  *backend)
+{
+#ifdef HAVE_OPENCL
+    if (strcmp(name, "opencl") == 0) *backend = BACKEND_OPENCL;
+    else
+#endif
+    if (strcmp(name, "cpu") == 0) *backend = BACKEND_CPU;
+    else return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+int precision_from_name(
+        const char  *name,
+        precision_t *precision)
+{
+    if (strcmp(name, "single") == 0)      *precision = PRECISION_SINGLE;
+    else if (strcmp(name, "double") == 0) *precision = PRECISION_DOUBLE;
+    else if (strcmp(name, "auto") == 0)   *precision = PRECISION_AUTO;
+    else return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
 void parse_argument(
 		int   argc,
 		char  *argv[],
@@ -19,16 +43,45 @@ void parse_argument(
 
 	commandLineOptions.sizePath = 0;
 	commandLineOptions.num = 0;
+	commandLineOptions.dist = 1;
+	commandLineOptions.partition = PARTITION_AUTO;
+	commandLineOptions.devices = getenv("SIMULTITE_DEVICES");
+	commandLineOptions.listDevices = 0;
+	commandLineOptions.refine = 0;
+	commandLineOptions.precision = PRECISION_SINGLE;
+	commandLineOptions.timing = NULL;
+	commandLineOptions.trace = NULL;
+	commandLineOptions.stencil = NULL;
+	commandLineOptions.batch = NULL;
+	commandLineOptions.warmStart = NULL;
+#ifdef HAVE_OPENCL
+	commandLineOptions.backend = BACKEND_OPENCL;
+#else
+	commandLineOptions.backend = BACKEND_CPU;
+#endif
 
 	static struct option long_options[]={
 		{"infile", required_argument, NULL, 'i'},
 		{"num",    required_argument, NULL, 'n'},
 		{"kryl",   required_argument, NULL, 'k'},
-		{"help",   no_argument,       NULL, 'h'}
+		{"distributed", required_argument, NULL, 'd'},
+		{"partition", required_argument, NULL, 'p'},
+		{"device", required_argument, NULL, 'g'},
+		{"list-devices", no_argument, NULL, 'l'},
+		{"backend", required_argument, NULL, 'b'},
+		{"refine", required_argument, NULL, 'r'},
+		{"precision", required_argument, NULL, 'f'},
+		{"timing", required_argument, NULL, 't'},
+		{"trace", required_argument, NULL, 'T'},
+		{"stencil", required_argument, NULL, 's'},
+		{"batch", required_argument, NULL, 'B'},
+		{"warm-start", required_argument, NULL, 'w'},
+		{"help",   no_argument,       NULL, 'h'},
+		{0,        0,                 0,    0}
 	};
 
 	int opt;
-	while ((opt = getopt_long(argc, argv, "i:n:k:h", long_options, NULL)) != -1)
+	while ((opt = getopt_long(argc, argv, "i:n:k:d:p:g:lb:r:f:t:T:s:B:w:h", long_options, NULL)) != -1)
 	{
 		switch (opt)
 		{
@@ -57,6 +110,85 @@ void parse_argument(
 			}
 			break;
 
+			case 'd':
+			errno = 0;
+			commandLineOptions.dist = strtoll(optarg, NULL, 10);
+			if (errno || strtoll(optarg, NULL, 10) <= 0)
+			{
+				goto help;
+			}
+			break;
+
+			case 'p':
+			if (partition_method_from_name(optarg, &commandLineOptions.partition) != EXIT_SUCCESS)
+			{
+				if (my_rank == 0)
+					fprintf(stderr, "Unknown or unavailable partitioning method %s\n", optarg);
+				goto help;
+			}
+			break;
+
+			case 'g':
+			commandLineOptions.devices = optarg;
+			break;
+
+			case 'l':
+			commandLineOptions.listDevices = 1;
+			break;
+
+			case 'b':
+			if (backend_from_name(optarg, &commandLineOptions.backend) != EXIT_SUCCESS)
+			{
+				if (my_rank == 0)
+					fprintf(stderr, "Unknown or unavailable backend %s\n", optarg);
+				goto help;
+			}
+			break;
+
+			case 'r':
+			errno = 0;
+			commandLineOptions.refine = strtoll(optarg, NULL, 10);
+			if (errno || strtoll(optarg, NULL, 10) < 0)
+			{
+				goto help;
+			}
+			break;
+
+			case 'f':
+			if (precision_from_name(optarg, &commandLineOptions.precision) != EXIT_SUCCESS)
+			{
+				if (my_rank == 0)
+					fprintf(stderr, "Unknown precision %s\n", optarg);
+				goto help;
+			}
+			break;
+
+			case 't':
+			commandLineOptions.timing = optarg;
+			break;
+
+			case 'T':
+			commandLineOptions.trace = optarg;
+			break;
+
+			case 's':
+			commandLineOptions.stencil = malloc(sizeof(stencilOperator));
+			if (stencil_from_string(optarg, commandLineOptions.stencil) != EXIT_SUCCESS)
+			{
+				if (my_rank == 0)
+					fprintf(stderr, "Invalid stencil %s, expected nx,ny,nz[,center,cx,cy,cz]\n", optarg);
+				goto help;
+			}
+			break;
+
+			case 'B':
+			commandLineOptions.batch = optarg;
+			break;
+
+			case 'w':
+			commandLineOptions.warmStart = optarg;
+			break;
+
 			case 'h':
 			ret = EXIT_SUCCESS;
 			goto help;
@@ -65,12 +197,17 @@ void parse_argument(
 			default:
 			help:
 			if (my_rank == 0)
-				fprintf(stderr, "Usage: mpirun -n num_process %s {-i | --infile} infile {-n | --num} number_of_eigenvalues {-k | --kryl} krylov subspace size [-h]\n", argv[0]);
+				fprintf(stderr, "Usage: mpirun -n num_process %s {{-i | --infile} infile | {-s | --stencil} nx,ny,nz[,center,cx,cy,cz] | {-B | --batch} list} {-n | --num} number_of_eigenvalues {-k | --kryl} krylov subspace size [{-d | --distributed} ranks_per_matrix [{-p | --partition} auto|block|multilevel|metis|scotch]] [{-g | --device} index[,index...]] [-l | --list-devices] [{-b | --backend} opencl|cpu] [{-r | --refine} max_steps] [{-f | --precision} single|double|auto] [{-t | --timing} prefix] [{-T | --trace} prefix] [{-w | --warm-start} file] [-h]\n", argv[0]);
 			exit(ret);
 			break;
 		}
 	}
-	if (commandLineOptions.sizePath == 0 || commandLineOptions.num == 0 || commandLineOptions.kryl == 0)
+	if (commandLineOptions.listDevices)
+	{
+		return;
+	}
+	if ((commandLineOptions.sizePath > 0) + (commandLineOptions.stencil != NULL) + (commandLineOptions.batch != NULL) != 1
+			|| commandLineOptions.num == 0 || commandLineOptions.kryl == 0)
 	{
 		goto help;
 	}
@@ -79,4 +216,35 @@ void parse_argument(
         fprintf(stderr, "Krylov Subspace size must be bigger or equal to the number off eigenvalue requested\n");
         goto help;
     }
+	int num_proc; MPI_Comm_size(MPI_COMM_WORLD, &num_proc);
+	if (num_proc % commandLineOptions.dist != 0)
+	{
+		if (my_rank == 0)
+			fprintf(stderr, "The number of processes must be a multiple of the number of ranks per matrix\n");
+		goto help;
+	}
+	if (commandLineOptions.dist > 1 && commandLineOptions.backend == BACKEND_CPU)
+	{
+		if (my_rank == 0)
+			fprintf(stderr, "The distributed mode requires the OpenCL backend\n");
+		goto help;
+	}
+	if (commandLineOptions.dist > 1 && commandLineOptions.stencil != NULL)
+	{
+		if (my_rank == 0)
+			fprintf(stderr, "The distributed mode requires a matrix file\n");
+		goto help;
+	}
+	if (commandLineOptions.dist > 1 && commandLineOptions.batch != NULL)
+	{
+		if (my_rank == 0)
+			fprintf(stderr, "The batch mode solves each matrix on one process\n");
+		goto help;
+	}
+	if (commandLineOptions.warmStart != NULL && commandLineOptions.batch != NULL)
+	{
+		if (my_rank == 0)
+			fprintf(stderr, "The warm start needs a single matrix, not a batch\n");
+		goto help;
+	}
 }
@@ -1,107 +1,118 @@
 /** 
  * \author Daumen Anton and Nicolas Derumigny
  * \file gram_schmidt.c
- * \brief Gram-Schmidt process on GPU using clSPARSE library
+ * \brief Orthonormalization of a block of vectors on GPU
  *
  */
 
 #include "gram_schmidt.h"
 
-void gram_schmidt(
-		cldenseVector   *eigenVectors,
-		unsigned        numberOfVectors,
-		cl_context      *context,
-		clsparseControl control)
-{
-	cl_int         cl_status;
-	clsparseEnableAsync(control, CL_TRUE);
-
-
-	clsparseScalar norm;
-	clsparseInitScalar(&norm);
-	norm.value = clCreateBuffer(*context, CL_MEM_READ_WRITE, sizeof(real_t),
-            NULL, &cl_status);
+/// \brief Largest condition number estimate for which CholQR2 is accurate, above it TSQR is used
+#define CHOLQR_MAX_COND (0.5 / sqrt(REAL_EPSILON))
 
-	for (int i = 0; i<numberOfVectors; ++i)
+/**
+ * \brief Orthonormalize the block on host with TSQR, fallback for ill-conditioned blocks
+ */
+static void gram_schmidt_tsqr(
+		cldenseMatrix    *V,
+		cl_command_queue queue)
+{
+	int     m = V->num_rows, n = V->num_cols, ld = V->lead_dim;
+	real_t  *host = malloc(ld * n * sizeof(real_t));
+	double  *work = malloc(ld * n * sizeof(double));
+
+	double waited = MPI_Wtime();
+	clEnqueueReadBuffer(queue, V->values, CL_TRUE, V->off_values * sizeof(real_t),
+			ld * n * sizeof(real_t), host, 0, NULL, NULL);
+	timing_trace("read block", TRACE_WAITS, waited, MPI_Wtime());
+	for (int i = 0; i < ld * n; ++i)
 	{
-#ifdef DOUBLE_PRECISION
-		for(int j = 0; j<i; ++j)
-		{
-			cldenseDdot(&norm, &eigenVectors[j], &eigenVectors[i], control);
-            clsparseScalarDopos(&norm, control);
-			cldenseDaxpy(&eigenVectors[i], &norm, &eigenVectors[j], &eigenVectors[i], control);
+		work[i] = host[i];
+	}
 
-		}
-		cldenseDnrm2(&norm, &eigenVectors[i], control);
-		clsparseScalarDinv(&norm, control);
-		cldenseDscale(&eigenVectors[i], &norm, &eigenVectors[i], control);
-#else
-		for(int j = 0; j<i; ++j)
-		{
-			cldenseSdot(&norm, &eigenVectors[j], &eigenVectors[i], control);
-            clsparseScalarSopos(&norm, control);
-			cldenseSaxpy(&eigenVectors[i], &norm, &eigenVectors[j], &eigenVectors[i], control);
+	dense_tsqr(work, m, n, ld);
 
-		}
-		cldenseSnrm2(&norm, &eigenVectors[i], control);
-		clsparseScalarSinv(&norm, control);
-		cldenseSscale(&eigenVectors[i], &norm, &eigenVectors[i], control);
-#endif
-    }
+	for (int i = 0; i < ld * n; ++i)
+	{
+		host[i] = work[i];
+	}
+	clEnqueueWriteBuffer(queue, V->values, CL_TRUE, V->off_values * sizeof(real_t),
+			ld * n * sizeof(real_t), host, 0, NULL, NULL);
 
-	clReleaseMemObject(norm.value);
+	free(work);
+	free(host);
 }
 
-clsparseStatus clsparseScalarSopos(
-		clsparseScalar *scalar,
-		clsparseControl control)
+cl_int gram_schmidt_init_work(
+		gramSchmidtWork  *work,
+		cl_context       context,
+		int              n)
 {
-	cldenseVector  vector, minusOne_V;
-	vector.num_values = 1u;
-	vector.values = scalar->value;
-	vector.off_values = scalar->off_value;
-	minusOne_V.num_values = 1u;
-	minusOne_V.values = minusOne_S.value;
-	minusOne_V.off_values = minusOne_S.off_value;
-
-	return cldenseSmul(&vector, &minusOne_V, &vector, control);
+	cl_int cl_status;
+	work->n = n;
+	work->G = clCreateBuffer(context, CL_MEM_READ_WRITE, n * n * sizeof(real_t), NULL, &cl_status);
+	work->R = NULL;
+	if (cl_status == CL_SUCCESS)
+	{
+		work->R = clCreateBuffer(context, CL_MEM_READ_ONLY, n * n * sizeof(real_t), NULL, &cl_status);
+	}
+	work->host = malloc(n * n * sizeof(real_t));
+	work->Gd   = malloc(n * n * sizeof(double));
+	work->Rd   = malloc(n * n * sizeof(double));
+	return cl_status;
 }
 
-clsparseStatus clsparseScalarDopos(
-		clsparseScalar *scalar,
-		clsparseControl control)
-{
-	cldenseVector  vector, minusOne_V;
-	vector.num_values = 1u;
-	vector.values = scalar->value;
-	vector.off_values = scalar->off_value;
-	minusOne_V.num_values = 1u;
-	minusOne_V.values = minusOne_S.value;
-	minusOne_V.off_values = minusOne_S.off_value;
-
-	return cldenseDmul(&vector, &minusOne_V, &vector, control);
-}
-clsparseStatus clsparseScalarSinv(
-		clsparseScalar *scalar,
-		clsparseControl control)
+void gram_schmidt_free_work(
+		gramSchmidtWork  *work)
 {
-	cldenseVector  vector;
-	vector.num_values = 1u;
-	vector.values = scalar->value;
-	vector.off_values = scalar->off_value;
-
-	return cldenseSdiv(&vector, &one_V, &vector, control);
+	if (work->n == 0)
+	{
+		return;
+	}
+	if (work->G != NULL) clReleaseMemObject(work->G);
+	if (work->R != NULL) clReleaseMemObject(work->R);
+	free(work->host);
+	free(work->Gd);
+	free(work->Rd);
+	work->n = 0;
 }
 
-
-clsparseStatus clsparseScalarDinv(
-		clsparseScalar *scalar,
-		clsparseControl control)
+void gram_schmidt(
+		cldenseMatrix    *V,
+		gramSchmidtWork  *work,
+		cl_command_queue queue)
 {
-	cldenseVector  vector;
-	vector.num_values = 1u;
-	vector.values = scalar->value;
-	vector.off_values = scalar->off_value;
+	int     n     = V->num_cols;
+	cl_mem  G     = work->G;
+	cl_mem  R     = work->R;
+	real_t  *host = work->host;
+	double  *Gd   = work->Gd;
+	double  *Rd   = work->Rd;
+
+	// CholQR2: the second pass restores the orthogonality lost by the first one
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		cl_kernel_gram(queue, V, G);
+		double waited = MPI_Wtime();
+		clEnqueueReadBuffer(queue, G, CL_TRUE, 0, n * n * sizeof(real_t), host, 0, NULL, NULL);
+		timing_trace("read Gram matrix", TRACE_WAITS, waited, MPI_Wtime());
+		for (int i = 0; i < n * n; ++i)
+		{
+			Gd[i] = host[i];
+		}
 
-	return cldenseDdiv(&vector, &one_V, &vector, control);
+		if (dense_cholesky(Gd, Rd, n) != EXIT_SUCCESS
+				|| (pass == 0 && dense_triangular_cond(Rd, n) > CHOLQR_MAX_COND))
+		{
+			gram_schmidt_tsqr(V, queue);
+			break;
+		}
+
+		for (int i = 0; i < n * n; ++i)
+		{
+			host[i] = Rd[i];
+		}
+		clEnqueueWriteBuffer(queue, R, CL_TRUE, 0, n * n * sizeof(real_t), host, 0, NULL, NULL);
+		cl_kernel_trsm(queue, V, R);
+	}
 }
@@ -0,0 +1,262 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file matrix_gen.c
+ * \brief Test matrices generated in memory, for the benchmarks
+ *
+ */
+
+#include "matrix_gen.h"
+#include "matrix_reader.h"
+
+/// \brief Shape of the Pareto distribution of the row lengths of MATRIX_POWER_LAW, its mean is 3 times its minimum
+#define POWER_LAW_SHAPE 1.5
+
+static const char *const kind_names[MATRIX_KINDS] = {
+    "laplace2d", "laplace3d", "random", "banded", "powerlaw"
+};
+
+const char *matrix_kind_name(
+        matrixKind_t kind)
+{
+    return kind_names[kind];
+}
+
+/**
+ * \brief Next value of the splitmix64 generator of state \a s, independent of rand()
+ */
+static unsigned long long next_random(
+        unsigned long long *s)
+{
+    unsigned long long z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * \brief Uniform value in [0, 1)
+ */
+static double next_uniform(
+        unsigned long long *s)
+{
+    return (next_random(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * \brief Ascending order of the column indices
+ */
+static int compare_int(
+        const void *a,
+        const void *b)
+{
+    const int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * \brief Number of entries of row \a i before removing the duplicates
+ */
+static long long row_length(
+        matrixKind_t       kind,
+        int                i,
+        int                n,
+        int                side,
+        int                nnzPerRow,
+        unsigned long long *s)
+{
+    switch (kind)
+    {
+        case MATRIX_LAPLACE_2D:
+        return 1 + (i % side > 0) + (i % side < side - 1) + (i >= side) + (i < n - side);
+
+        case MATRIX_LAPLACE_3D:
+        {
+            const int x = i % side, y = (i / side) % side, z = i / (side * side);
+            return 1 + (x > 0) + (x < side - 1) + (y > 0) + (y < side - 1) + (z > 0) + (z < side - 1);
+        }
+
+        case MATRIX_BANDED:
+        {
+            const int h = (nnzPerRow - 1) / 2;
+            return ((i + h < n) ? i + h : n - 1) - ((i - h > 0) ? i - h : 0) + 1;
+        }
+
+        case MATRIX_POWER_LAW:
+        {
+            const double xmin = nnzPerRow * (POWER_LAW_SHAPE - 1.0) / POWER_LAW_SHAPE;
+            const double l = xmin * pow(1.0 - next_uniform(s), -1.0 / POWER_LAW_SHAPE);
+            return (l < 1.0) ? 1 : (l > n) ? n : (long long) l;
+        }
+
+        default:
+        return (nnzPerRow < n) ? nnzPerRow : n;
+    }
+}
+
+/**
+ * \brief Write the columns and values of row \a i from \a cols and \a vals, return their number
+ *
+ * The random rows may lose some entries to duplicated columns.
+ */
+static int fill_row(
+        matrixKind_t       kind,
+        int                i,
+        int                n,
+        int                side,
+        int                nnzPerRow,
+        int                length,
+        int                *cols,
+        double             *vals,
+        unsigned long long *s)
+{
+    int l = 0;
+    switch (kind)
+    {
+        case MATRIX_LAPLACE_2D:
+        if (i >= side)            { cols[l] = i - side; vals[l++] = -1.0; }
+        if (i % side > 0)         { cols[l] = i - 1;    vals[l++] = -1.0; }
+        cols[l] = i; vals[l++] = 4.0;
+        if (i % side < side - 1)  { cols[l] = i + 1;    vals[l++] = -1.0; }
+        if (i < n - side)         { cols[l] = i + side; vals[l++] = -1.0; }
+        return l;
+
+        case MATRIX_LAPLACE_3D:
+        {
+            const int plane = side * side;
+            const int x = i % side, y = (i / side) % side, z = i / plane;
+            if (z > 0)            { cols[l] = i - plane; vals[l++] = -1.0; }
+            if (y > 0)            { cols[l] = i - side;  vals[l++] = -1.0; }
+            if (x > 0)            { cols[l] = i - 1;     vals[l++] = -1.0; }
+            cols[l] = i; vals[l++] = 6.0;
+            if (x < side - 1)     { cols[l] = i + 1;     vals[l++] = -1.0; }
+            if (y < side - 1)     { cols[l] = i + side;  vals[l++] = -1.0; }
+            if (z < side - 1)     { cols[l] = i + plane; vals[l++] = -1.0; }
+            return l;
+        }
+
+        case MATRIX_BANDED:
+        {
+            const int first = (i - (nnzPerRow - 1) / 2 > 0) ? i - (nnzPerRow - 1) / 2 : 0;
+            for (int j = first; j < first + length; ++j)
+            {
+                cols[l] = j;
+                vals[l++] = 1.0 / (1.0 + abs(i - j));
+            }
+            return l;
+        }
+
+        default:
+        // The diagonal, then random columns sorted and deduplicated
+        cols[0] = i;
+        for (int k = 1; k < length; ++k)
+        {
+            cols[k] = (int) (next_random(s) % (unsigned long long) n);
+        }
+        qsort(cols, length, sizeof(int), compare_int);
+        for (int k = 0; k < length; ++k)
+        {
+            if (l > 0 && cols[l - 1] == cols[k]) continue;
+            cols[l] = cols[k];
+            vals[l++] = (cols[k] == i) ? 1.0 : 1.0 - next_uniform(s);
+        }
+        return l;
+    }
+}
+
+int generate_matrix(
+        csrMatrix    *mat,
+        matrixKind_t kind,
+        int          n,
+        int          nnzPerRow,
+        unsigned     seed,
+        int          precisions)
+{
+    memset(mat, 0, sizeof(*mat));
+    if (n < 1 || nnzPerRow < 1 || kind < 0 || kind >= MATRIX_KINDS)
+    {
+        fprintf(stderr, "[ERROR]: matrix_gen.c: invalid parameters\n");
+        return EXIT_FAILURE;
+    }
+
+    int side = 0;
+    if (kind == MATRIX_LAPLACE_2D)
+    {
+        side = (int) lround(sqrt((double) n));
+        if (side < 1) side = 1;
+        n = side * side;
+    }
+    else if (kind == MATRIX_LAPLACE_3D)
+    {
+        side = (int) lround(cbrt((double) n));
+        if (side < 1) side = 1;
+        n = side * side * side;
+    }
+
+    // Lengths of the rows before deduplication, the power law draws them first
+    unsigned long long s = seed;
+    int *lengths = malloc((size_t) n * sizeof(int));
+    mat->rows    = malloc(((size_t) n + 1) * sizeof(int));
+    if (lengths == NULL || mat->rows == NULL)
+    {
+        fprintf(stderr, "[ERROR]: matrix_gen.c: out of memory\n");
+        goto fail;
+    }
+    long long capacity = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        lengths[i] = (int) row_length(kind, i, n, side, nnzPerRow, &s);
+        capacity += lengths[i];
+    }
+    if (capacity > INT_MAX)
+    {
+        fprintf(stderr, "[ERROR]: matrix_gen.c: %lld non-zeros do not fit in an int\n", capacity);
+        goto fail;
+    }
+
+    double *vals = malloc((size_t) capacity * sizeof(double));
+    mat->cols    = malloc((size_t) capacity * sizeof(int));
+    if (vals == NULL || mat->cols == NULL)
+    {
+        fprintf(stderr, "[ERROR]: matrix_gen.c: out of memory\n");
+        free(vals);
+        goto fail;
+    }
+    mat->rows[0] = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const int start = mat->rows[i];
+        mat->rows[i + 1] = start + fill_row(kind, i, n, side, nnzPerRow, lengths[i], mat->cols + start, vals + start, &s);
+    }
+    free(lengths);
+    lengths = NULL;
+
+    mat->nRow = n;
+    mat->nCol = n;
+    mat->nNz  = mat->rows[n];
+    if (precisions & MATRIX_SINGLE)
+    {
+        mat->svals = malloc((size_t) mat->nNz * sizeof(float));
+        if (mat->svals == NULL)
+        {
+            fprintf(stderr, "[ERROR]: matrix_gen.c: out of memory\n");
+            free(vals);
+            goto fail;
+        }
+        for (int k = 0; k < mat->nNz; ++k) mat->svals[k] = (float) vals[k];
+    }
+    if (precisions & MATRIX_DOUBLE)
+    {
+        mat->dvals = vals;
+    }
+    else
+    {
+        free(vals);
+    }
+    return EXIT_SUCCESS;
+
+fail:
+    free(lengths);
+    MPI_Win win = MPI_WIN_NULL;
+    free_Matrix(mat, &win);
+    return EXIT_FAILURE;
+}
@@ -7,82 +7,227 @@
 
 #include "matrix_reader.h"
 
-int read_Matrix(
+/**
+ * \brief Open the file, read the banner and the sizes into \a mat, leave \a f on the first entry
+ *
+ * \a pattern is set if the file has no values.
+ */
+static int open_matrix(
         const char* filename,
-        csrMatrix* mat)
+        FILE**      f,
+        csrMatrix*  mat,
+        int*        pattern)
 {
     MM_typecode matcode;
-    FILE *f;
-    int nNz, nCol, nRow;
     int my_rank; MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
     // Opening File
-    if ((f = fopen(filename, "r")) == NULL)
+    if ((*f = fopen(filename, "r")) == NULL)
     {
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: FILE NOT FOUND\n");
         return(EXIT_FAILURE);
     }
 
     // Processing Matrix Market banner
-    if (mm_read_banner(f, &matcode) != 0)
+    if (mm_read_banner(*f, &matcode) != 0)
     {
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: Could not process Matrix Market banner.\n");
+        fclose(*f);
         return(EXIT_FAILURE);
     }
 
     // Getting dimension of matrix
-    if (mm_read_mtx_crd_size(f, &(mat->nRow), &(mat->nCol), &(mat->nNz)) != 0)
+    if (mm_read_mtx_crd_size(*f, &(mat->nRow), &(mat->nCol), &(mat->nNz)) != 0)
     {
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: Could not process Matrix size\n");
+        fclose(*f);
         return(EXIT_FAILURE);
     }
 
-    mat->rows = malloc(sizeof(int) * (mat->nRow+1));
-    mat->cols = malloc(sizeof(int) * mat->nNz);
-
-    memset(mat->rows, 0, sizeof(int) * (mat->nRow+1));
-
     if(mm_is_pattern(matcode))
     {
-        mat->vals = NULL;
+        *pattern = 1;
     }
     else if(mm_is_real(matcode) || mm_is_integer(matcode))
     {
-        mat->vals = malloc(sizeof(real_t) * mat->nNz);
+        *pattern = 0;
     }
     else if(mm_is_complex(matcode))
     {
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: Complex Matrix not supported\n");
+        fclose(*f);
         return(EXIT_FAILURE);
     }
     else
     {
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: Matrix type not recognised\n");
+        fclose(*f);
         return(EXIT_FAILURE);
     }
 
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Read the entries into the arrays of \a mat, already allocated, and close \a f
+ */
+static int read_entries(
+        FILE*      f,
+        csrMatrix* mat)
+{
+    memset(mat->rows, 0, sizeof(int) * (mat->nRow+1));
+
     for(int i=0; i<mat->nNz; ++i)
     {
-        if(get_line(f, i, mat->rows, mat->cols, mat->vals) != EXIT_SUCCESS)
+        if(get_line(f, i, mat->rows, mat->cols, mat->svals, mat->dvals) != EXIT_SUCCESS)
+        {
+            fclose(f);
             return(EXIT_FAILURE);
+        }
     }
+    fclose(f);
 
     for(int i=1; i < mat->nRow + 1; ++i)
     {
         mat->rows[i] += mat->rows[i-1];
     }
 
+    return EXIT_SUCCESS;
+}
+
+int read_Matrix(
+        const char* filename,
+        csrMatrix* mat,
+        int        precisions)
+{
+    FILE *f;
+    int pattern;
+
+    if (open_matrix(filename, &f, mat, &pattern) != EXIT_SUCCESS)
+    {
+        return(EXIT_FAILURE);
+    }
+
+    mat->rows = malloc(sizeof(int) * (mat->nRow+1));
+    mat->cols = malloc(sizeof(int) * mat->nNz);
+    mat->svals = (!pattern && (precisions & MATRIX_SINGLE)) ? malloc(sizeof(float) * mat->nNz) : NULL;
+    mat->dvals = (!pattern && (precisions & MATRIX_DOUBLE)) ? malloc(sizeof(double) * mat->nNz) : NULL;
+    mat->stencil = NULL;
+
+    return read_entries(f, mat);
+}
+
+int read_Matrix_size(
+        const char* filename,
+        csrMatrix*  mat)
+{
+    FILE *f;
+    int pattern;
+
+    if (open_matrix(filename, &f, mat, &pattern) != EXIT_SUCCESS)
+    {
+        return(EXIT_FAILURE);
+    }
+    fclose(f);
+    return EXIT_SUCCESS;
+}
+
+int read_Matrix_shared(
+        const char* filename,
+        csrMatrix*  mat,
+        MPI_Comm    node_comm,
+        MPI_Win*    win,
+        int         precisions)
+{
+    FILE *f = NULL;
+    int pattern = 0;
+    int node_rank; MPI_Comm_rank(node_comm, &node_rank);
 
+    // Status, sizes and pattern flag read by the node leader
+    long long header[5] = {EXIT_SUCCESS, 0, 0, 0, 0};
+    if (node_rank == 0)
+    {
+        header[0] = open_matrix(filename, &f, mat, &pattern);
+        header[1] = mat->nRow;
+        header[2] = mat->nCol;
+        header[3] = mat->nNz;
+        header[4] = pattern;
+    }
+    MPI_Bcast(header, 5, MPI_LONG_LONG, 0, node_comm);
+    if (header[0] != EXIT_SUCCESS)
+    {
+        return(EXIT_FAILURE);
+    }
+    mat->nRow = (int) header[1];
+    mat->nCol = (int) header[2];
+    mat->nNz  = (int) header[3];
+    pattern   = (int) header[4];
+
+    // Values first, they have the strictest alignment
+    MPI_Aint dvalsBytes = (pattern || !(precisions & MATRIX_DOUBLE)) ? 0 : (MPI_Aint) sizeof(double) * mat->nNz;
+    MPI_Aint svalsBytes = (pattern || !(precisions & MATRIX_SINGLE)) ? 0 : (MPI_Aint) sizeof(float) * mat->nNz;
+    MPI_Aint intsBytes = (MPI_Aint) sizeof(int) * ((MPI_Aint) mat->nRow + 1 + mat->nNz);
+    char *base;
+    MPI_Win_allocate_shared((node_rank == 0) ? dvalsBytes + svalsBytes + intsBytes : 0, 1, MPI_INFO_NULL,
+            node_comm, &base, win);
+    if (node_rank != 0)
+    {
+        MPI_Aint size;
+        int      disp;
+        MPI_Win_shared_query(*win, 0, &size, &disp, &base);
+    }
+    mat->dvals = (dvalsBytes > 0) ? (double*) base : NULL;
+    mat->svals = (svalsBytes > 0) ? (float*) (base + dvalsBytes) : NULL;
+    mat->stencil = NULL;
+    mat->rows = (int*) (base + dvalsBytes + svalsBytes);
+    mat->cols = mat->rows + mat->nRow + 1;
+
+    int status = EXIT_SUCCESS;
+    MPI_Win_fence(0, *win);
+    if (node_rank == 0)
+    {
+        status = read_entries(f, mat);
+    }
+    MPI_Win_fence(0, *win);
+
+    MPI_Bcast(&status, 1, MPI_INT, 0, node_comm);
+    if (status != EXIT_SUCCESS)
+    {
+        MPI_Win_free(win);
+        return(EXIT_FAILURE);
+    }
     return EXIT_SUCCESS;
 }
 
+void free_Matrix(
+        csrMatrix* mat,
+        MPI_Win*   win)
+{
+    if (*win != MPI_WIN_NULL)
+    {
+        MPI_Win_free(win);
+    }
+    else
+    {
+        free(mat->rows);
+        free(mat->cols);
+        free(mat->svals);
+        free(mat->dvals);
+    }
+    mat->svals = NULL;
+    mat->dvals = NULL;
+    mat->rows = NULL;
+    mat->cols = NULL;
+}
+
 
 int get_line(
         FILE *f,
         int i,
         int* rows,
         int* cols,
-        real_t* vals)
+        float*  svals,
+        double* dvals)
 {
     int row;
     int my_rank; MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -96,7 +241,7 @@ int get_line(
         if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: error in 'get_line()' arguments\n");
         return(EXIT_FAILURE);
     }
-    else if(vals == NULL) // Matrix is binary
+    else if(svals == NULL && dvals == NULL) // Matrix is binary
     {
         if (fscanf(f, "%d %d", &row, &cols[i]) != 2)
         {
@@ -106,16 +251,17 @@ int get_line(
     }
     else // Reading integer as double
     {
-#ifdef DOUBLE_PRECISION
-        if (fscanf(f, "%d %d %lg\n", &row, &cols[i], &vals[i]) != 3)
-#else
-        if (fscanf(f, "%d %d %f\n", &row, &cols[i], &vals[i]) != 3)
-#endif
+        double val;
+        if (fscanf(f, "%d %d %lg\n", &row, &cols[i], &val) != 3)
         {
             if(my_rank==0) fprintf(stderr, "[ERROR]: matrix_reader.c: Problem while reading line, expected 3 element\n");
             return(EXIT_FAILURE);
         }
+        if (svals != NULL) svals[i] = (float) val;
+        if (dvals != NULL) dvals[i] = val;
     }
+    // Matrix Market indices start at 1
+    cols[i]--;
     rows[row]++;
 
     return EXIT_SUCCESS;
@@ -127,7 +273,7 @@ void print_mat(
     printf("Values: ");
     for(int i=0; i < mat->nNz; ++i)
     {
-        printf("%f ", mat->vals[i]);
+        printf("%f ", (mat->dvals != NULL) ? mat->dvals[i] : mat->svals[i]);
     }
     printf("\n");
     printf("Columns: ");
@@ -0,0 +1,171 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file mpi_profile.c
+ * \brief Time of the blocking MPI calls, through the PMPI profiling interface
+ *
+ * Linked in the executables, these definitions replace the ones of the MPI
+ * library, which stay reachable as PMPI_*. When the timings are enabled,
+ * each call is timed and accounted to the phase in progress with
+ * \a timing_add_mpi(). Only the calls which may wait for other ranks are
+ * wrapped; the signatures are the ones of MPI 3, whose shared memory
+ * windows the solver already needs.
+ */
+
+#include <mpi.h>
+
+#include "timing.h"
+
+/// \brief Return PMPI_\a name \a args, timed as \a label when the timings are enabled
+#define PROFILE_AS(name, label, args)                    \
+    do {                                                 \
+        if (!timing_enabled()) return PMPI_##name args;  \
+        double start = PMPI_Wtime();                     \
+        int    ret   = PMPI_##name args;                 \
+        timing_add_mpi(label, start, PMPI_Wtime());      \
+        return ret;                                      \
+    } while (0)
+#define PROFILE(name, args) PROFILE_AS(name, "MPI_" #name, args)
+
+int MPI_Barrier(
+        MPI_Comm comm)
+{
+    PROFILE(Barrier, (comm));
+}
+
+int MPI_Bcast(
+        void         *buffer,
+        int          count,
+        MPI_Datatype datatype,
+        int          root,
+        MPI_Comm     comm)
+{
+    PROFILE(Bcast, (buffer, count, datatype, root, comm));
+}
+
+int MPI_Reduce(
+        const void   *sendbuf,
+        void         *recvbuf,
+        int          count,
+        MPI_Datatype datatype,
+        MPI_Op       op,
+        int          root,
+        MPI_Comm     comm)
+{
+    PROFILE(Reduce, (sendbuf, recvbuf, count, datatype, op, root, comm));
+}
+
+int MPI_Allreduce(
+        const void   *sendbuf,
+        void         *recvbuf,
+        int          count,
+        MPI_Datatype datatype,
+        MPI_Op       op,
+        MPI_Comm     comm)
+{
+    PROFILE(Allreduce, (sendbuf, recvbuf, count, datatype, op, comm));
+}
+
+int MPI_Gather(
+        const void   *sendbuf,
+        int          sendcount,
+        MPI_Datatype sendtype,
+        void         *recvbuf,
+        int          recvcount,
+        MPI_Datatype recvtype,
+        int          root,
+        MPI_Comm     comm)
+{
+    PROFILE(Gather, (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm));
+}
+
+int MPI_Scatter(
+        const void   *sendbuf,
+        int          sendcount,
+        MPI_Datatype sendtype,
+        void         *recvbuf,
+        int          recvcount,
+        MPI_Datatype recvtype,
+        int          root,
+        MPI_Comm     comm)
+{
+    PROFILE(Scatter, (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm));
+}
+
+int MPI_Allgatherv(
+        const void   *sendbuf,
+        int          sendcount,
+        MPI_Datatype sendtype,
+        void         *recvbuf,
+        const int    recvcounts[],
+        const int    displs[],
+        MPI_Datatype recvtype,
+        MPI_Comm     comm)
+{
+    PROFILE(Allgatherv, (sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm));
+}
+
+int MPI_Alltoall(
+        const void   *sendbuf,
+        int          sendcount,
+        MPI_Datatype sendtype,
+        void         *recvbuf,
+        int          recvcount,
+        MPI_Datatype recvtype,
+        MPI_Comm     comm)
+{
+    PROFILE(Alltoall, (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm));
+}
+
+int MPI_Alltoallv(
+        const void   *sendbuf,
+        const int    sendcounts[],
+        const int    sdispls[],
+        MPI_Datatype sendtype,
+        void         *recvbuf,
+        const int    recvcounts[],
+        const int    rdispls[],
+        MPI_Datatype recvtype,
+        MPI_Comm     comm)
+{
+    PROFILE(Alltoallv, (sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm));
+}
+
+int MPI_Win_fence(
+        int     assert,
+        MPI_Win win)
+{
+    PROFILE(Win_fence, (assert, win));
+}
+
+int MPI_Wait(
+        MPI_Request *request,
+        MPI_Status  *status)
+{
+    PROFILE(Wait, (request, status));
+}
+
+int MPI_Waitall(
+        int         count,
+        MPI_Request array_of_requests[],
+        MPI_Status  array_of_statuses[])
+{
+    PROFILE(Waitall, (count, array_of_requests, array_of_statuses));
+}
+
+// The halo exchanges and the ensemble monitor poll: the time spent polling is the time waited, too many calls to trace
+int MPI_Test(
+        MPI_Request *request,
+        int         *flag,
+        MPI_Status  *status)
+{
+    PROFILE_AS(Test, NULL, (request, flag, status));
+}
+
+int MPI_Testall(
+        int         count,
+        MPI_Request array_of_requests[],
+        int         *flag,
+        MPI_Status  array_of_statuses[])
+{
+    PROFILE_AS(Testall, NULL, (count, array_of_requests, flag, array_of_statuses));
+}
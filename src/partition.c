@@ -0,0 +1,782 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file partition.c
+ * \brief Graph partitioning of the rows of a matrix distributed over several ranks
+ *
+ */
+
+#include "partition.h"
+
+#ifdef HAVE_METIS
+#include <metis.h>
+#endif
+#ifdef HAVE_SCOTCH
+#include <stdint.h>
+#include <scotch.h>
+#endif
+
+/// \brief Number of vertices under which a graph is not coarsened any more
+#define COARSEN_TO 64
+/// \brief Coarsening stops when a level removes less than this fraction of the vertices
+#define COARSEN_MIN_SHRINK 0.9
+/// \brief Maximal number of refinement passes at each level
+#define REFINE_PASSES 8
+/// \brief Number of starting vertices tried by the initial bisection
+#define INITIAL_TRIES 4
+/// \brief Tolerated relative imbalance of a bisection
+#define IMBALANCE 0.03
+
+/// \brief Undirected weighted graph in compressed adjacency format
+typedef struct graph_t{
+    /// Number of vertices
+    int       n;
+    /// Start of the adjacency of each vertex in \a adjncy (n + 1 values)
+    int       *xadj;
+    /// Neighbours
+    int       *adjncy;
+    /// Weight of each edge
+    int       *adjwgt;
+    /// Weight of each vertex
+    int       *vwgt;
+    /// Sum of \a vwgt
+    long long totalVwgt;
+}graph_t;
+
+/**
+ * \brief Deterministic pseudo-random generator, so every run gives the same partition
+ */
+static unsigned next_random(
+        unsigned *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 8);
+}
+
+static graph_t* graph_alloc(
+        int n,
+        int nEdges)
+{
+    graph_t *g = malloc(sizeof(graph_t));
+    g->n = n;
+    g->xadj   = malloc((n + 1) * sizeof(int));
+    g->adjncy = malloc((nEdges > 0 ? nEdges : 1) * sizeof(int));
+    g->adjwgt = malloc((nEdges > 0 ? nEdges : 1) * sizeof(int));
+    g->vwgt   = malloc((n > 0 ? n : 1) * sizeof(int));
+    g->totalVwgt = 0;
+    return g;
+}
+
+static void graph_free(
+        graph_t *g)
+{
+    free(g->xadj);
+    free(g->adjncy);
+    free(g->adjwgt);
+    free(g->vwgt);
+    free(g);
+}
+
+/**
+ * \brief Symmetrized sparsity graph of a square matrix, without self loops
+ *
+ * An edge has weight 2 when both a_ij and a_ji are stored, since both
+ * products then need the remote value.
+ */
+static graph_t* graph_from_csr(
+        csrMatrix *mat)
+{
+    int n = mat->nRow;
+    int *start = calloc(n + 1, sizeof(int));
+
+    for (int i = 0; i < n; ++i)
+    {
+        for (int k = mat->rows[i]; k < mat->rows[i+1]; ++k)
+        {
+            int c = mat->cols[k];
+            if (c != i && c >= 0 && c < n)
+            {
+                start[i+1]++;
+                start[c+1]++;
+            }
+        }
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        start[i+1] += start[i];
+    }
+
+    int *fill = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *adj  = malloc((start[n] > 0 ? start[n] : 1) * sizeof(int));
+    memcpy(fill, start, n * sizeof(int));
+    for (int i = 0; i < n; ++i)
+    {
+        for (int k = mat->rows[i]; k < mat->rows[i+1]; ++k)
+        {
+            int c = mat->cols[k];
+            if (c != i && c >= 0 && c < n)
+            {
+                adj[fill[i]++] = c;
+                adj[fill[c]++] = i;
+            }
+        }
+    }
+
+    // Merge the duplicated edges into weights
+    graph_t *g = graph_alloc(n, start[n]);
+    int *pos = fill;
+    for (int i = 0; i < n; ++i)
+    {
+        pos[i] = -1;
+    }
+    int e = 0;
+    g->xadj[0] = 0;
+    for (int v = 0; v < n; ++v)
+    {
+        int rowStart = e;
+        for (int k = start[v]; k < start[v+1]; ++k)
+        {
+            int u = adj[k];
+            if (pos[u] >= rowStart)
+            {
+                g->adjwgt[pos[u]]++;
+            }
+            else
+            {
+                pos[u] = e;
+                g->adjncy[e] = u;
+                g->adjwgt[e] = 1;
+                ++e;
+            }
+        }
+        g->xadj[v+1] = e;
+        g->vwgt[v] = 1;
+    }
+    g->totalVwgt = n;
+
+    free(adj);
+    free(fill);
+    free(start);
+    return g;
+}
+
+static long long edge_cut(
+        const graph_t *g,
+        const int     *part)
+{
+    long long cut = 0;
+    for (int v = 0; v < g->n; ++v)
+    {
+        for (int e = g->xadj[v]; e < g->xadj[v+1]; ++e)
+        {
+            if (part[g->adjncy[e]] != part[v])
+            {
+                cut += g->adjwgt[e];
+            }
+        }
+    }
+    return cut / 2;
+}
+
+/**
+ * \brief Heavy edge matching, the matched pairs become the vertices of the coarse graph
+ *
+ * \a cmap receives the coarse vertex of each fine vertex.
+ */
+static graph_t* coarsen(
+        const graph_t *g,
+        int           *cmap,
+        unsigned      *seed)
+{
+    int n = g->n;
+    int *match = malloc(n * sizeof(int));
+    int *order = malloc(n * sizeof(int));
+    int *fine  = malloc(n * sizeof(int));
+
+    for (int v = 0; v < n; ++v)
+    {
+        match[v] = -1;
+        order[v] = v;
+    }
+    for (int v = n - 1; v > 0; --v)
+    {
+        int u = next_random(seed) % (v + 1);
+        int tmp = order[v]; order[v] = order[u]; order[u] = tmp;
+    }
+
+    int nc = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        int v = order[k];
+        if (match[v] != -1) continue;
+
+        int best = -1, bestWgt = 0;
+        for (int e = g->xadj[v]; e < g->xadj[v+1]; ++e)
+        {
+            int u = g->adjncy[e];
+            if (match[u] == -1 && g->adjwgt[e] > bestWgt)
+            {
+                best = u;
+                bestWgt = g->adjwgt[e];
+            }
+        }
+        match[v] = (best == -1) ? v : best;
+        if (best != -1) match[best] = v;
+        cmap[v] = nc;
+        if (best != -1) cmap[best] = nc;
+        fine[nc++] = v;
+    }
+
+    graph_t *cg = graph_alloc(nc, g->xadj[n]);
+    int *pos = order;
+    for (int c = 0; c < nc; ++c)
+    {
+        pos[c] = -1;
+    }
+    int e = 0;
+    cg->xadj[0] = 0;
+    for (int c = 0; c < nc; ++c)
+    {
+        int rowStart = e;
+        int v = fine[c];
+        cg->vwgt[c] = g->vwgt[v] + ((match[v] != v) ? g->vwgt[match[v]] : 0);
+        for (int m = 0; m < ((match[v] != v) ? 2 : 1); ++m)
+        {
+            int w = (m == 0) ? v : match[v];
+            for (int f = g->xadj[w]; f < g->xadj[w+1]; ++f)
+            {
+                int cu = cmap[g->adjncy[f]];
+                if (cu == c) continue;
+                if (pos[cu] >= rowStart)
+                {
+                    cg->adjwgt[pos[cu]] += g->adjwgt[f];
+                }
+                else
+                {
+                    pos[cu] = e;
+                    cg->adjncy[e] = cu;
+                    cg->adjwgt[e] = g->adjwgt[f];
+                    ++e;
+                }
+            }
+        }
+        cg->xadj[c+1] = e;
+    }
+    cg->totalVwgt = g->totalVwgt;
+
+    free(fine);
+    free(order);
+    free(match);
+    return cg;
+}
+
+/**
+ * \brief Greedy boundary refinement of a bisection, then rebalancing if needed
+ *
+ * A vertex moves to the other side when it reduces the edge-cut (or keeps it
+ * and improves the balance) without exceeding the tolerated weight.
+ */
+static void refine(
+        const graph_t *g,
+        int           *part,
+        long long     target0)
+{
+    long long target[2] = {target0, g->totalVwgt - target0};
+    long long weight[2] = {0, 0};
+    int maxVwgt = 0;
+    for (int v = 0; v < g->n; ++v)
+    {
+        weight[part[v]] += g->vwgt[v];
+        if (g->vwgt[v] > maxVwgt) maxVwgt = g->vwgt[v];
+    }
+    long long maxWeight[2] = {target[0] + IMBALANCE * target[0] + maxVwgt,
+                              target[1] + IMBALANCE * target[1] + maxVwgt};
+
+    for (int pass = 0; pass < REFINE_PASSES; ++pass)
+    {
+        int moved = 0;
+        for (int v = 0; v < g->n; ++v)
+        {
+            int from = part[v], to = 1 - from;
+            long long gain = 0;
+            int boundary = 0;
+            for (int e = g->xadj[v]; e < g->xadj[v+1]; ++e)
+            {
+                if (part[g->adjncy[e]] != from)
+                {
+                    gain += g->adjwgt[e];
+                    boundary = 1;
+                }
+                else
+                {
+                    gain -= g->adjwgt[e];
+                }
+            }
+            if (!boundary || weight[to] + g->vwgt[v] > maxWeight[to]) continue;
+
+            int balances = (weight[from] - target[from]) > (weight[to] + g->vwgt[v] - target[to]);
+            int overweight = weight[from] > maxWeight[from];
+            if (gain > 0 || (gain == 0 && balances) || overweight)
+            {
+                part[v] = to;
+                weight[from] -= g->vwgt[v];
+                weight[to]   += g->vwgt[v];
+                ++moved;
+            }
+        }
+        if (!moved) break;
+    }
+
+    // Last resort for disconnected graphs: move any vertex out of an overweight side
+    for (int side = 0; side < 2; ++side)
+    {
+        for (int v = 0; v < g->n && weight[side] > maxWeight[side]; ++v)
+        {
+            if (part[v] == side)
+            {
+                part[v] = 1 - side;
+                weight[side] -= g->vwgt[v];
+                weight[1 - side] += g->vwgt[v];
+            }
+        }
+    }
+}
+
+/**
+ * \brief Initial bisection by breadth-first growing of side 0 until it weighs \a target0
+ */
+static void grow_bisection(
+        const graph_t *g,
+        long long     target0,
+        int           *part,
+        unsigned      *seed)
+{
+    int *trial = malloc((g->n > 0 ? g->n : 1) * sizeof(int));
+    int *queue = malloc((g->n > 0 ? g->n : 1) * sizeof(int));
+    long long bestCut = -1;
+
+    for (int t = 0; t < INITIAL_TRIES && g->n > 0; ++t)
+    {
+        for (int v = 0; v < g->n; ++v)
+        {
+            trial[v] = 1;
+        }
+
+        long long weight0 = 0;
+        int head = 0, tail = 0, scan = 0;
+        queue[tail++] = next_random(seed) % g->n;
+        trial[queue[0]] = -1;
+        while (weight0 < target0)
+        {
+            if (head == tail)
+            {
+                // Disconnected graph: restart from any vertex still on side 1
+                while (scan < g->n && trial[scan] != 1) ++scan;
+                if (scan == g->n) break;
+                queue[tail++] = scan;
+                trial[scan] = -1;
+            }
+            int v = queue[head++];
+            trial[v] = 0;
+            weight0 += g->vwgt[v];
+            for (int e = g->xadj[v]; e < g->xadj[v+1]; ++e)
+            {
+                int u = g->adjncy[e];
+                if (trial[u] == 1)
+                {
+                    trial[u] = -1;
+                    queue[tail++] = u;
+                }
+            }
+        }
+        // Vertices left in the queue stay on side 1
+        for (int k = head; k < tail; ++k)
+        {
+            trial[queue[k]] = 1;
+        }
+
+        refine(g, trial, target0);
+        long long cut = edge_cut(g, trial);
+        if (bestCut < 0 || cut < bestCut)
+        {
+            bestCut = cut;
+            memcpy(part, trial, g->n * sizeof(int));
+        }
+    }
+
+    free(queue);
+    free(trial);
+}
+
+/**
+ * \brief Multilevel bisection: coarsen, bisect the coarsest graph, project back and refine
+ */
+static void multilevel_bisection(
+        const graph_t *g,
+        long long     target0,
+        int           *part,
+        unsigned      *seed)
+{
+    if (g->n <= COARSEN_TO)
+    {
+        grow_bisection(g, target0, part, seed);
+        return;
+    }
+
+    int *cmap = malloc(g->n * sizeof(int));
+    graph_t *cg = coarsen(g, cmap, seed);
+    if (cg->n > COARSEN_MIN_SHRINK * g->n)
+    {
+        graph_free(cg);
+        free(cmap);
+        grow_bisection(g, target0, part, seed);
+        return;
+    }
+
+    int *cpart = malloc(cg->n * sizeof(int));
+    multilevel_bisection(cg, target0, cpart, seed);
+    for (int v = 0; v < g->n; ++v)
+    {
+        part[v] = cpart[cmap[v]];
+    }
+    refine(g, part, target0);
+
+    free(cpart);
+    graph_free(cg);
+    free(cmap);
+}
+
+/**
+ * \brief Subgraph induced by the vertices of one side, \a ids maps its vertices to the original graph
+ */
+static graph_t* induced_subgraph(
+        const graph_t *g,
+        const int     *part,
+        int           side,
+        const int     *ids,
+        int           **subIds)
+{
+    int *local = malloc((g->n > 0 ? g->n : 1) * sizeof(int));
+    int n = 0, nEdges = 0;
+    for (int v = 0; v < g->n; ++v)
+    {
+        local[v] = (part[v] == side) ? n++ : -1;
+        if (part[v] == side) nEdges += g->xadj[v+1] - g->xadj[v];
+    }
+
+    graph_t *sg = graph_alloc(n, nEdges);
+    *subIds = malloc((n > 0 ? n : 1) * sizeof(int));
+    int e = 0;
+    sg->xadj[0] = 0;
+    for (int v = 0; v < g->n; ++v)
+    {
+        if (local[v] < 0) continue;
+        int sv = local[v];
+        (*subIds)[sv] = ids[v];
+        sg->vwgt[sv] = g->vwgt[v];
+        sg->totalVwgt += g->vwgt[v];
+        for (int f = g->xadj[v]; f < g->xadj[v+1]; ++f)
+        {
+            int u = g->adjncy[f];
+            if (local[u] >= 0)
+            {
+                sg->adjncy[e] = local[u];
+                sg->adjwgt[e] = g->adjwgt[f];
+                ++e;
+            }
+        }
+        sg->xadj[sv+1] = e;
+    }
+
+    free(local);
+    return sg;
+}
+
+/**
+ * \brief k-way partitioning by recursive multilevel bisection
+ */
+static void recursive_bisection(
+        const graph_t *g,
+        const int     *ids,
+        int           nParts,
+        int           firstPart,
+        int           *globalPart,
+        unsigned      *seed)
+{
+    if (nParts == 1 || g->n == 0)
+    {
+        for (int v = 0; v < g->n; ++v)
+        {
+            globalPart[ids[v]] = firstPart;
+        }
+        return;
+    }
+
+    int nParts0 = nParts / 2;
+    long long target0 = (g->totalVwgt * nParts0) / nParts;
+    int *part = malloc(g->n * sizeof(int));
+    multilevel_bisection(g, target0, part, seed);
+
+    for (int side = 0; side < 2; ++side)
+    {
+        int *subIds;
+        graph_t *sg = induced_subgraph(g, part, side, ids, &subIds);
+        if (side == 0)
+        {
+            recursive_bisection(sg, subIds, nParts0, firstPart, globalPart, seed);
+        }
+        else
+        {
+            recursive_bisection(sg, subIds, nParts - nParts0, firstPart + nParts0, globalPart, seed);
+        }
+        free(subIds);
+        graph_free(sg);
+    }
+    free(part);
+}
+
+#ifdef HAVE_METIS
+static int partition_metis(
+        const graph_t *g,
+        int           nParts,
+        int           *part)
+{
+    idx_t nvtxs = g->n, ncon = 1, np = nParts, objval;
+    idx_t nEdges = g->xadj[g->n];
+    idx_t *xadj   = malloc((g->n + 1) * sizeof(idx_t));
+    idx_t *adjncy = malloc((nEdges > 0 ? nEdges : 1) * sizeof(idx_t));
+    idx_t *adjwgt = malloc((nEdges > 0 ? nEdges : 1) * sizeof(idx_t));
+    idx_t *vwgt   = malloc((g->n > 0 ? g->n : 1) * sizeof(idx_t));
+    idx_t *mpart  = malloc((g->n > 0 ? g->n : 1) * sizeof(idx_t));
+    idx_t options[METIS_NOPTIONS];
+
+    for (int v = 0; v <= g->n; ++v) xadj[v] = g->xadj[v];
+    for (idx_t e = 0; e < nEdges; ++e)
+    {
+        adjncy[e] = g->adjncy[e];
+        adjwgt[e] = g->adjwgt[e];
+    }
+    for (int v = 0; v < g->n; ++v) vwgt[v] = g->vwgt[v];
+    METIS_SetDefaultOptions(options);
+
+    int status = METIS_PartGraphKway(&nvtxs, &ncon, xadj, adjncy, vwgt, NULL, adjwgt,
+            &np, NULL, NULL, options, &objval, mpart);
+    for (int v = 0; v < g->n; ++v) part[v] = mpart[v];
+
+    free(mpart);
+    free(vwgt);
+    free(adjwgt);
+    free(adjncy);
+    free(xadj);
+    return (status == METIS_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+#ifdef HAVE_SCOTCH
+static int partition_scotch(
+        const graph_t *g,
+        int           nParts,
+        int           *part)
+{
+    SCOTCH_Graph graph;
+    SCOTCH_Strat strat;
+    SCOTCH_Num   nEdges = g->xadj[g->n];
+    SCOTCH_Num   *verttab = malloc((g->n + 1) * sizeof(SCOTCH_Num));
+    SCOTCH_Num   *edgetab = malloc((nEdges > 0 ? nEdges : 1) * sizeof(SCOTCH_Num));
+    SCOTCH_Num   *edlotab = malloc((nEdges > 0 ? nEdges : 1) * sizeof(SCOTCH_Num));
+    SCOTCH_Num   *velotab = malloc((g->n > 0 ? g->n : 1) * sizeof(SCOTCH_Num));
+    SCOTCH_Num   *parttab = malloc((g->n > 0 ? g->n : 1) * sizeof(SCOTCH_Num));
+
+    for (int v = 0; v <= g->n; ++v) verttab[v] = g->xadj[v];
+    for (SCOTCH_Num e = 0; e < nEdges; ++e)
+    {
+        edgetab[e] = g->adjncy[e];
+        edlotab[e] = g->adjwgt[e];
+    }
+    for (int v = 0; v < g->n; ++v) velotab[v] = g->vwgt[v];
+
+    int status = SCOTCH_graphInit(&graph);
+    status = status || SCOTCH_graphBuild(&graph, 0, g->n, verttab, NULL, velotab, NULL,
+            nEdges, edgetab, edlotab);
+    status = status || SCOTCH_stratInit(&strat);
+    status = status || SCOTCH_graphPart(&graph, nParts, &strat, parttab);
+    for (int v = 0; v < g->n; ++v) part[v] = parttab[v];
+    SCOTCH_stratExit(&strat);
+    SCOTCH_graphExit(&graph);
+
+    free(parttab);
+    free(velotab);
+    free(edlotab);
+    free(edgetab);
+    free(verttab);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+/**
+ * \brief Symmetric permutation of the rows and columns of \a mat, row i moves to perm[i]
+ *
+ * The result is copied back into the arrays of \a mat, which may live in a
+ * shared-memory window.
+ */
+static void permute_matrix(
+        csrMatrix *mat,
+        const int *perm)
+{
+    int n = mat->nRow;
+    int *iperm   = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *rows    = malloc((n + 1) * sizeof(int));
+    int *cols    = malloc((mat->nNz > 0 ? mat->nNz : 1) * sizeof(int));
+    float  *svals = (mat->svals != NULL) ? malloc((mat->nNz > 0 ? mat->nNz : 1) * sizeof(float)) : NULL;
+    double *dvals = (mat->dvals != NULL) ? malloc((mat->nNz > 0 ? mat->nNz : 1) * sizeof(double)) : NULL;
+
+    for (int i = 0; i < n; ++i)
+    {
+        iperm[perm[i]] = i;
+    }
+    rows[0] = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        int old = iperm[i];
+        int len = mat->rows[old+1] - mat->rows[old];
+        for (int k = 0; k < len; ++k)
+        {
+            int c = mat->cols[mat->rows[old] + k];
+            cols[rows[i] + k] = (c < n) ? perm[c] : c;
+            if (svals != NULL) svals[rows[i] + k] = mat->svals[mat->rows[old] + k];
+            if (dvals != NULL) dvals[rows[i] + k] = mat->dvals[mat->rows[old] + k];
+        }
+        rows[i+1] = rows[i] + len;
+    }
+
+    memcpy(mat->rows, rows, (n + 1) * sizeof(int));
+    memcpy(mat->cols, cols, mat->nNz * sizeof(int));
+    if (svals != NULL) memcpy(mat->svals, svals, mat->nNz * sizeof(float));
+    if (dvals != NULL) memcpy(mat->dvals, dvals, mat->nNz * sizeof(double));
+    free(rows);
+    free(cols);
+    free(svals);
+    free(dvals);
+    free(iperm);
+}
+
+int partition_method_from_name(
+        const char        *name,
+        partitionMethod_t *method)
+{
+    if (strcmp(name, "auto") == 0) *method = PARTITION_AUTO;
+    else if (strcmp(name, "block") == 0) *method = PARTITION_BLOCK;
+    else if (strcmp(name, "multilevel") == 0) *method = PARTITION_MULTILEVEL;
+#ifdef HAVE_METIS
+    else if (strcmp(name, "metis") == 0) *method = PARTITION_METIS;
+#endif
+#ifdef HAVE_SCOTCH
+    else if (strcmp(name, "scotch") == 0) *method = PARTITION_SCOTCH;
+#endif
+    else return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+long long partition_matrix(
+        csrMatrix         *mat,
+        int               nParts,
+        partitionMethod_t method,
+        MPI_Comm          comm,
+        int               *perm,
+        int               *rowOffsets,
+        MPI_Win           win)
+{
+    int       n = mat->nRow;
+    int       rank;
+    long long cut = 0;
+    MPI_Comm_rank(comm, &rank);
+
+    if (rank == 0)
+    {
+        graph_t *g = graph_from_csr(mat);
+        int *part = malloc((n > 0 ? n : 1) * sizeof(int));
+        int done = 0;
+
+        if (method == PARTITION_AUTO)
+        {
+#if defined(HAVE_METIS)
+            method = PARTITION_METIS;
+#elif defined(HAVE_SCOTCH)
+            method = PARTITION_SCOTCH;
+#else
+            method = PARTITION_MULTILEVEL;
+#endif
+        }
+        if (method == PARTITION_BLOCK)
+        {
+            for (int p = 0; p < nParts; ++p)
+            {
+                int start = (int) (((long long) p * n) / nParts);
+                int end   = (int) (((long long) (p + 1) * n) / nParts);
+                for (int v = start; v < end; ++v) part[v] = p;
+            }
+            done = 1;
+        }
+#ifdef HAVE_METIS
+        if (method == PARTITION_METIS && nParts > 1)
+        {
+            done = (partition_metis(g, nParts, part) == EXIT_SUCCESS);
+            if (!done) fprintf(stderr, "[WARNING]: partition.c: METIS failed, using the built-in partitioner\n");
+        }
+#endif
+#ifdef HAVE_SCOTCH
+        if (method == PARTITION_SCOTCH && nParts > 1)
+        {
+            done = (partition_scotch(g, nParts, part) == EXIT_SUCCESS);
+            if (!done) fprintf(stderr, "[WARNING]: partition.c: Scotch failed, using the built-in partitioner\n");
+        }
+#endif
+        if (!done)
+        {
+            int *ids = malloc((n > 0 ? n : 1) * sizeof(int));
+            unsigned seed = SEED;
+            for (int v = 0; v < n; ++v) ids[v] = v;
+            recursive_bisection(g, ids, nParts, 0, part, &seed);
+            free(ids);
+        }
+        cut = edge_cut(g, part);
+
+        // Rows of part p become contiguous, in their original order
+        memset(rowOffsets, 0, (nParts + 1) * sizeof(int));
+        for (int v = 0; v < n; ++v) rowOffsets[part[v] + 1]++;
+        for (int p = 0; p < nParts; ++p) rowOffsets[p + 1] += rowOffsets[p];
+        int *next = malloc(nParts * sizeof(int));
+        memcpy(next, rowOffsets, nParts * sizeof(int));
+        for (int v = 0; v < n; ++v) perm[v] = next[part[v]]++;
+
+        free(next);
+        free(part);
+        graph_free(g);
+    }
+
+    MPI_Bcast(perm, n, MPI_INT, 0, comm);
+    MPI_Bcast(rowOffsets, nParts + 1, MPI_INT, 0, comm);
+    MPI_Bcast(&cut, 1, MPI_LONG_LONG, 0, comm);
+
+    if (win == MPI_WIN_NULL)
+    {
+        permute_matrix(mat, perm);
+    }
+    else
+    {
+        // Every group computes the same permutation, the node leader applies it once
+        MPI_Group group;
+        int       node_rank;
+        MPI_Win_get_group(win, &group);
+        MPI_Group_rank(group, &node_rank);
+        MPI_Group_free(&group);
+
+        MPI_Win_fence(0, win);
+        if (node_rank == 0)
+        {
+            permute_matrix(mat, perm);
+        }
+        MPI_Win_fence(0, win);
+    }
+
+    return cut;
+}
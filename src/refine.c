@@ -0,0 +1,380 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file refine.c
+ * \brief Refinement in double precision of the eigenpairs found by the solver
+ *
+ */
+
+#include "refine.h"
+
+/// \brief Number of inverse iterations on the Hessenberg matrix of a step shifted by theta, to aim at the nearest Ritz value
+#define REFINE_SHIFT_ITER 10
+/// \brief Number of inverse iterations on (Hbar - theta I)^T (Hbar - theta I) for the refined vector of a step
+#define REFINE_REFINED_ITER 30
+/// \brief Distance in starting residuals the Rayleigh quotient may move from the starting Ritz value, above
+///        one as the bound only holds for a normal matrix
+#define REFINE_DRIFT 2.0
+/// \brief Number of Rayleigh quotient iterations on the Hessenberg matrix of a step
+#define REFINE_INVERSE_ITER 3
+
+void refine_init(
+        refineMatrix    *rm,
+        const csrMatrix *mat,
+        const int       *rowOffsets,
+        MPI_Comm        comm)
+{
+    int num_ranks; MPI_Comm_size(comm, &num_ranks);
+    int rank;      MPI_Comm_rank(comm, &rank);
+
+    rm->comm    = comm;
+    rm->nGlobal = mat->nRow;
+    rm->counts  = malloc(num_ranks * sizeof(int));
+    rm->displs  = malloc(num_ranks * sizeof(int));
+    for (int r = 0; r < num_ranks; ++r)
+    {
+        // Same blocks as dist_row_start() without a partition
+        int first = (rowOffsets != NULL) ? rowOffsets[r]     : (int) (((long long) r * mat->nRow) / num_ranks);
+        int next  = (rowOffsets != NULL) ? rowOffsets[r + 1] : (int) (((long long) (r + 1) * mat->nRow) / num_ranks);
+        rm->displs[r] = first;
+        rm->counts[r] = next - first;
+    }
+    rm->rowStart = rm->displs[rank];
+    rm->nLocal   = rm->counts[rank];
+    rm->full     = (num_ranks > 1) ? malloc(rm->nGlobal * sizeof(double)) : NULL;
+    rm->stencil  = mat->stencil;
+    if (rm->stencil != NULL)
+    {
+        rm->rows = rm->cols = NULL;
+        rm->vals = NULL;
+        return;
+    }
+
+    int first = mat->rows[rm->rowStart];
+    int nNz   = mat->rows[rm->rowStart + rm->nLocal] - first;
+    rm->rows = malloc((rm->nLocal + 1) * sizeof(int));
+    rm->cols = malloc((nNz > 0 ? nNz : 1) * sizeof(int));
+    rm->vals = malloc((nNz > 0 ? nNz : 1) * sizeof(double));
+    for (int i = 0; i <= rm->nLocal; ++i)
+    {
+        rm->rows[i] = mat->rows[rm->rowStart + i] - first;
+    }
+    memcpy(rm->cols, mat->cols + first, nNz * sizeof(int));
+    for (int k = 0; k < nNz; ++k)
+    {
+        if (mat->dvals != NULL)      rm->vals[k] = mat->dvals[first + k];
+        else if (mat->svals != NULL) rm->vals[k] = mat->svals[first + k];
+        else                         rm->vals[k] = 1.0;
+    }
+}
+
+/**
+ * \brief y := A x for the local parts of \a x and \a y
+ */
+static void refine_spmv(
+        refineMatrix *rm,
+        const double *x,
+        double       *y)
+{
+    const double *full = x;
+    if (rm->full != NULL)
+    {
+        MPI_Allgatherv(x, rm->nLocal, MPI_DOUBLE, rm->full, rm->counts, rm->displs, MPI_DOUBLE, rm->comm);
+        full = rm->full;
+    }
+    if (rm->stencil != NULL)
+    {
+        stencil_apply(rm->stencil, rm->rowStart, rm->nLocal, full, y);
+        return;
+    }
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rm->nLocal; ++i)
+    {
+        double sum = 0.0;
+        for (int k = rm->rows[i]; k < rm->rows[i + 1]; ++k)
+        {
+            sum += rm->vals[k] * full[rm->cols[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+/**
+ * \brief Global dot product of two local parts
+ */
+static double refine_dot(
+        refineMatrix *rm,
+        const double *x,
+        const double *y)
+{
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum) schedule(static)
+    for (int i = 0; i < rm->nLocal; ++i)
+    {
+        sum += x[i] * y[i];
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, rm->comm);
+    return sum;
+}
+
+/**
+ * \brief Normalize \a x, return its former norm
+ */
+static double refine_normalize(
+        refineMatrix *rm,
+        double       *x)
+{
+    double nrm = sqrt(refine_dot(rm, x, x));
+    if (nrm > 0.0)
+    {
+        for (int i = 0; i < rm->nLocal; ++i)
+        {
+            x[i] /= nrm;
+        }
+    }
+    return nrm;
+}
+
+/**
+ * \brief Rayleigh quotient of the unit vector \a x and ||A x - theta x||, \a ax receives A x
+ */
+static double refine_residual(
+        refineMatrix *rm,
+        const double *x,
+        double       *ax,
+        double       *theta)
+{
+    refine_spmv(rm, x, ax);
+    *theta = refine_dot(rm, x, ax);
+    double sum = 0.0;
+    for (int i = 0; i < rm->nLocal; ++i)
+    {
+        double r = ax[i] - *theta * x[i];
+        sum += r * r;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, rm->comm);
+    return sqrt(sum);
+}
+
+/**
+ * \brief Rayleigh quotient z^T H z of the unit vector \a z for the leading \a k x \a k block of \a H
+ */
+static double rayleigh_small(
+        const double *H,
+        int          ldh,
+        int          k,
+        const double *z)
+{
+    double rq = 0.0;
+    for (int i = 0; i < k; ++i)
+    {
+        for (int j = 0; j < k; ++j)
+        {
+            rq += z[i] * H[i*ldh + j] * z[j];
+        }
+    }
+    return rq;
+}
+
+/**
+ * \brief ||A V z - theta V z|| of the unit coordinates \a z in the Arnoldi basis, from the
+ *        (k+1) x k leading block of \a H, \a theta receiving the Rayleigh quotient
+ */
+static double residual_small(
+        const double *H,
+        int          ldh,
+        int          k,
+        const double *z,
+        double       *theta)
+{
+    *theta = rayleigh_small(H, ldh, k, z);
+    double sum = 0.0;
+    for (int i = 0; i <= k; ++i)
+    {
+        double r = (i < k) ? -*theta * z[i] : 0.0;
+        for (int j = 0; j < k; ++j)
+        {
+            r += H[i*ldh + j] * z[j];
+        }
+        sum += r * r;
+    }
+    return sqrt(sum);
+}
+
+/**
+ * \brief Unit \a y minimizing ||(Hbar - shift I) y|| for the (k+1) x k leading block Hbar of \a H
+ *
+ * Inverse iterations from e_1 on the normal matrix, \a S receives its factors. With \a shift
+ * the Rayleigh quotient of the first Arnoldi vector, the residual of V y is at most the one
+ * of that vector.
+ */
+static void refined_small(
+        const double *H,
+        int          ldh,
+        int          k,
+        double       shift,
+        double       tiny,
+        double       *S,
+        double       *y)
+{
+    memset(y, 0, k * sizeof(double));
+    y[0] = 1.0;
+    for (int it = 0; it < REFINE_REFINED_ITER; ++it)
+    {
+        for (int i = 0; i < k; ++i)
+        {
+            for (int j = 0; j < k; ++j)
+            {
+                double sum = 0.0;
+                for (int l = 0; l <= k; ++l)
+                {
+                    sum += (H[l*ldh + i] - ((l == i) ? shift : 0.0)) * (H[l*ldh + j] - ((l == j) ? shift : 0.0));
+                }
+                S[i*k + j] = sum;
+            }
+        }
+        dense_lu_solve(S, y, k, tiny);
+        double nrm = 0.0;
+        for (int i = 0; i < k; ++i) nrm += y[i] * y[i];
+        nrm = sqrt(nrm);
+        for (int i = 0; i < k; ++i) y[i] /= nrm;
+    }
+}
+
+refineResult refine_pair(
+        refineMatrix *rm,
+        double       *x,
+        int          maxSteps)
+{
+    const int n = rm->nLocal;
+    const int m = REFINE_KRYLOV;
+    double *V    = malloc((size_t) (m + 1) * (n > 0 ? n : 1) * sizeof(double));
+    double *H    = malloc((m + 1) * m * sizeof(double));
+    double *S    = malloc(m * m * sizeof(double));
+    double *z    = malloc(m * sizeof(double));
+    double *y    = malloc(m * sizeof(double));
+    double *ax   = malloc((n > 0 ? n : 1) * sizeof(double));
+    double *best = malloc((n > 0 ? n : 1) * sizeof(double));
+
+    refineResult res;
+    refine_normalize(rm, x);
+    res.initialResidual = refine_residual(rm, x, ax, &res.eigenvalue);
+    res.residual        = res.initialResidual;
+    res.steps           = 0;
+    // The eigenvalue of the pair is about within the starting residual of the starting Ritz value
+    const double ritz   = res.eigenvalue;
+    const double radius = REFINE_DRIFT * res.initialResidual;
+
+    while (res.steps < maxSteps && res.residual > MAX_TOL * fabs(res.eigenvalue))
+    {
+        // Arnoldi basis started from x, reorthogonalized once
+        memset(H, 0, (m + 1) * m * sizeof(double));
+        memcpy(V, x, n * sizeof(double));
+        int k = m;
+        for (int j = 0; j < m; ++j)
+        {
+            double *w = V + (size_t) (j + 1) * n;
+            if (j == 0) memcpy(w, ax, n * sizeof(double));
+            else        refine_spmv(rm, V + (size_t) j * n, w);
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (int i = 0; i <= j; ++i)
+                {
+                    double h = refine_dot(rm, V + (size_t) i * n, w);
+                    for (int l = 0; l < n; ++l)
+                    {
+                        w[l] -= h * V[(size_t) i * n + l];
+                    }
+                    H[i*m + j] += h;
+                }
+            }
+            H[(j+1)*m + j] = refine_normalize(rm, w);
+            // Invariant subspace, the Ritz vectors are exact
+            if (H[(j+1)*m + j] <= DBL_EPSILON * fabs(res.eigenvalue))
+            {
+                k = j + 1;
+                break;
+            }
+        }
+
+        // Inverse iterations on the k x k Hessenberg matrix shifted by the starting Ritz
+        // value from the coordinates of x, which aim at the Ritz value nearest it and not
+        // at another eigenpair, then Rayleigh quotient iterations from that Ritz value
+        const double tiny = DBL_EPSILON * ((ritz != 0.0) ? fabs(ritz) : 1.0);
+        double shift = ritz;
+        memset(z, 0, k * sizeof(double));
+        z[0] = 1.0;
+        for (int it = 0; it < REFINE_SHIFT_ITER + REFINE_INVERSE_ITER; ++it)
+        {
+            for (int i = 0; i < k; ++i)
+            {
+                for (int j = 0; j < k; ++j)
+                {
+                    S[i*k + j] = H[i*m + j] - ((i == j) ? shift : 0.0);
+                }
+            }
+            dense_lu_solve(S, z, k, tiny);
+            double nrm = 0.0;
+            for (int i = 0; i < k; ++i) nrm += z[i] * z[i];
+            nrm = sqrt(nrm);
+            for (int i = 0; i < k; ++i) z[i] /= nrm;
+            if (it >= REFINE_SHIFT_ITER - 1)
+            {
+                shift = rayleigh_small(H, m, k, z);
+            }
+        }
+
+        // The refined vector for the starting Ritz value when its residual is lower,
+        // clustered eigenvalues slow the Ritz vector down
+        double theta;
+        double ritzResidual = residual_small(H, m, k, z, &theta);
+        refined_small(H, m, k, ritz, tiny * tiny, S, y);
+        if (residual_small(H, m, k, y, &theta) < ritzResidual)
+        {
+            memcpy(z, y, k * sizeof(double));
+        }
+
+        // x := V z, the step is undone and the refinement stops if it does not lower
+        // the residual, the next one would be the same, or if it left the pair
+        memcpy(best, x, n * sizeof(double));
+        for (int l = 0; l < n; ++l)
+        {
+            double sum = 0.0;
+            for (int i = 0; i < k; ++i)
+            {
+                sum += V[(size_t) i * n + l] * z[i];
+            }
+            x[l] = sum;
+        }
+        refine_normalize(rm, x);
+        double residual = refine_residual(rm, x, ax, &theta);
+        res.steps++;
+        if (!(residual < res.residual) || fabs(theta - ritz) > radius)
+        {
+            memcpy(x, best, n * sizeof(double));
+            break;
+        }
+        res.residual   = residual;
+        res.eigenvalue = theta;
+    }
+
+    free(V);
+    free(H);
+    free(S);
+    free(z);
+    free(y);
+    free(ax);
+    free(best);
+    res.converged = (res.residual <= MAX_TOL * fabs(res.eigenvalue));
+    return res;
+}
+
+void refine_free(
+        refineMatrix *rm)
+{
+    free(rm->rows);
+    free(rm->cols);
+    free(rm->vals);
+    free(rm->counts);
+    free(rm->displs);
+    free(rm->full);
+}
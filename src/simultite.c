@@ -0,0 +1,592 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file simultite.c
+ * \brief C API of libsimultite, see \a simultite.h
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "simultite.h"
+#include "matrix_reader.h"
+#include "partition.h"
+#include "solver.h"
+#include "stencil.h"
+#include "timing.h"
+
+struct simultiteSolver{
+    simultiteOptions options;
+    /// Duplicate of the communicator of the handle
+    MPI_Comm         comm;
+    int              rank;
+    int              size;
+    MPI_Comm         solver_comm;
+    MPI_Comm         ensemble_comm;
+    MPI_Comm         node_comm;
+    int              solver_rank;
+    int              ensemble_rank;
+    /// Whether \a mat holds a matrix to solve
+    int              loaded;
+    csrMatrix        mat;
+    MPI_Win          matWin;
+    stencilOperator  stencil;
+    /// Renumbering of the rows of \a mat and first row of each rank, NULL if not partitioned
+    int              *perm;
+    int              *rowOffsets;
+    /// Number of matrices packed in \a mat by \a simultite_load_files() and the first row of each, 0 for a single matrix
+    int              count;
+    int              *offsets;
+    /// Vectors the next solve starts from, in the numbering of \a mat, NULL for random starts
+    double           *start;
+    int              startCount;
+    /// SpMV kernel of the last solve, kept for the small matrices of the next ones
+    int              spmvVariant;
+    solverResult     result;
+    /// Whether the start of this rank was the best one of the last solve
+    int              isBest;
+};
+
+/** \brief Release the matrix of \a s, its renumbering and the eigenpairs of its last solve
+ */
+static void unload(
+        simultiteSolver *s)
+{
+    if (s->loaded && s->mat.stencil == NULL)
+    {
+        free_Matrix(&s->mat, &s->matWin);
+    }
+    s->loaded = 0;
+    free(s->perm);
+    free(s->rowOffsets);
+    free(s->offsets);
+    s->perm       = NULL;
+    s->rowOffsets = NULL;
+    s->offsets    = NULL;
+    s->count      = 0;
+    free(s->start);
+    s->start      = NULL;
+    s->startCount = 0;
+    free(s->result.values);
+    free(s->result.vectors);
+    free(s->result.errors);
+    memset(&s->result, 0, sizeof(solverResult));
+}
+
+/** \brief Renumber the rows of the matrix loaded so that each rank owns a well separated part of the graph
+ */
+static void partition_loaded(
+        simultiteSolver *s)
+{
+    if (s->options.dist == 1 || s->options.partition == PARTITION_BLOCK)
+    {
+        return;
+    }
+    s->perm       = malloc(s->mat.nRow * sizeof(int));
+    s->rowOffsets = malloc((s->options.dist + 1) * sizeof(int));
+    timing_begin(TIMING_PARTITION);
+    long long edgeCut = partition_matrix(&s->mat, s->options.dist, s->options.partition,
+            s->solver_comm, s->perm, s->rowOffsets, s->matWin);
+    timing_end(TIMING_PARTITION);
+    if (s->rank == 0) printf("Partition edge-cut: %lld\n", edgeCut);
+}
+
+/** \brief Values in the precisions the solver may run in, the refinement needs double
+ */
+static int matrix_precisions(
+        const simultiteOptions *options)
+{
+    int precisions = 0;
+    if (options->precision != PRECISION_DOUBLE) precisions |= MATRIX_SINGLE;
+    if (options->precision != PRECISION_SINGLE || options->refine > 0) precisions |= MATRIX_DOUBLE;
+    return precisions;
+}
+
+void simultite_default_options(
+        simultiteOptions *options)
+{
+    memset(options, 0, sizeof(simultiteOptions));
+    options->dist       = 1;
+    options->partition  = PARTITION_AUTO;
+    options->precision  = PRECISION_SINGLE;
+    options->devices    = getenv("SIMULTITE_DEVICES");
+#ifdef HAVE_OPENCL
+    options->backend    = BACKEND_OPENCL;
+#else
+    options->backend    = BACKEND_CPU;
+#endif
+}
+
+simultiteSolver *simultite_create(
+        MPI_Comm               comm,
+        const simultiteOptions *options)
+{
+    int rank; MPI_Comm_rank(comm, &rank);
+    int size; MPI_Comm_size(comm, &size);
+    const char *invalid = NULL;
+    if (options->num < 1 || options->kryl < options->num)
+    {
+        invalid = "the Krylov subspace must hold at least one and the number of eigenpairs";
+    }
+    else if (options->dist < 1 || size % options->dist != 0)
+    {
+        invalid = "the number of processes must be a multiple of the number of ranks per matrix";
+    }
+    else if (options->dist > 1 && options->backend == BACKEND_CPU)
+    {
+        invalid = "the distributed mode requires the OpenCL backend";
+    }
+    else if (options->dist > 1 && options->batch)
+    {
+        invalid = "the batch mode solves each matrix on one rank";
+    }
+    if (invalid != NULL)
+    {
+        if (rank == 0) fprintf(stderr, "[ERROR]: simultite.c: Invalid options, %s\n", invalid);
+        return NULL;
+    }
+
+    simultiteSolver *s = calloc(1, sizeof(simultiteSolver));
+    s->options = *options;
+    s->matWin  = MPI_WIN_NULL;
+    s->spmvVariant = -1;
+    MPI_Comm_dup(comm, &s->comm);
+    s->rank = rank;
+    s->size = size;
+
+    // Ranks sharing one matrix form a group, the groups form the ensemble, of one rank in batch mode
+    const int group = rank / options->dist;
+    MPI_Comm_split(s->comm, group, rank, &s->solver_comm);
+    MPI_Comm_split(s->comm, options->batch ? rank : rank % options->dist, rank, &s->ensemble_comm);
+    MPI_Comm_rank(s->solver_comm, &s->solver_rank);
+    MPI_Comm_rank(s->ensemble_comm, &s->ensemble_rank);
+
+    // Ranks sharing the memory of a node share one copy of the host matrix, and its devices; only the devices in batch mode
+    MPI_Comm_split_type(s->comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &s->node_comm);
+    solver_acquire_s();
+    solver_acquire_d();
+    return s;
+}
+
+int simultite_load_file(
+        simultiteSolver *s,
+        const char      *path)
+{
+    unload(s);
+    const int precisions = matrix_precisions(&s->options);
+    timing_begin(TIMING_PARSE);
+    int err = s->options.batch ? read_Matrix(path, &s->mat, precisions)
+                               : read_Matrix_shared(path, &s->mat, s->node_comm, &s->matWin, precisions);
+    timing_end(TIMING_PARSE);
+    if (err == EXIT_FAILURE)
+    {
+        return EXIT_FAILURE;
+    }
+    s->loaded = 1;
+    partition_loaded(s);
+    return EXIT_SUCCESS;
+}
+
+int simultite_load_files(
+        simultiteSolver   *s,
+        int               count,
+        const char *const *paths,
+        int               *consumed,
+        int               *loaded)
+{
+    unload(s);
+    *consumed = 0;
+    if (!s->options.batch)
+    {
+        if (s->rank == 0) fprintf(stderr, "[ERROR]: simultite.c: Only the handles in batch mode pack matrices\n");
+        return EXIT_FAILURE;
+    }
+
+    // The sizes first, so that a file that would overflow the pack is left for the next one unread
+    const int precisions = matrix_precisions(&s->options);
+    csrMatrix *mats = malloc((count > 0 ? count : 1) * sizeof(csrMatrix));
+    int       nMats = 0, nRow = 0, nNz = 0, i;
+    timing_begin(TIMING_PARSE);
+    for (i = 0; i < count; ++i)
+    {
+        csrMatrix size;
+        loaded[i] = 0;
+        if (read_Matrix_size(paths[i], &size) == EXIT_FAILURE || size.nRow != size.nCol)
+        {
+            continue;
+        }
+        if (nMats > 0 && (long long) nRow + size.nRow > BATCH_PACK_ROWS)
+        {
+            break;
+        }
+        if (read_Matrix(paths[i], mats + nMats, precisions) == EXIT_FAILURE)
+        {
+            continue;
+        }
+        loaded[i] = 1;
+        nRow     += mats[nMats].nRow;
+        nNz      += mats[nMats].nNz;
+        nMats++;
+    }
+    *consumed = i;
+    if (nMats == 0)
+    {
+        timing_end(TIMING_PARSE);
+        free(mats);
+        return EXIT_FAILURE;
+    }
+
+    // Block-diagonal matrix of the matrices read, a pattern having values of 1
+    memset(&s->mat, 0, sizeof(csrMatrix));
+    s->mat.nRow  = nRow;
+    s->mat.nCol  = nRow;
+    s->mat.nNz   = nNz;
+    s->mat.rows  = malloc((nRow + 1) * sizeof(int));
+    s->mat.cols  = malloc((nNz > 0 ? nNz : 1) * sizeof(int));
+    s->mat.svals = (precisions & MATRIX_SINGLE) ? malloc((nNz > 0 ? nNz : 1) * sizeof(float)) : NULL;
+    s->mat.dvals = (precisions & MATRIX_DOUBLE) ? malloc((nNz > 0 ? nNz : 1) * sizeof(double)) : NULL;
+    s->count     = nMats;
+    s->offsets   = malloc((nMats + 1) * sizeof(int));
+    s->offsets[0]   = 0;
+    s->mat.rows[0]  = 0;
+    for (int g = 0, first = 0, base = 0; g < nMats; ++g)
+    {
+        csrMatrix *m = mats + g;
+        for (int r = 0; r < m->nRow; ++r) s->mat.rows[first + r + 1] = base + m->rows[r + 1];
+        for (int j = 0; j < m->nNz; ++j)
+        {
+            s->mat.cols[base + j] = first + m->cols[j];
+            if (s->mat.svals != NULL) s->mat.svals[base + j] = (m->svals != NULL) ? m->svals[j] : 1.0f;
+            if (s->mat.dvals != NULL) s->mat.dvals[base + j] = (m->dvals != NULL) ? m->dvals[j] : 1.0;
+        }
+        first += m->nRow;
+        base  += m->nNz;
+        s->offsets[g + 1] = first;
+        MPI_Win win = MPI_WIN_NULL;
+        free_Matrix(m, &win);
+    }
+    free(mats);
+    timing_end(TIMING_PARSE);
+    s->loaded = 1;
+    return EXIT_SUCCESS;
+}
+
+int simultite_load_csr(
+        simultiteSolver *s,
+        int             nRow,
+        const int       *rows,
+        const int       *cols,
+        const double    *values)
+{
+    unload(s);
+    int valid = (nRow > 0 && rows[0] == 0);
+    for (int i = 0; valid && i < nRow; ++i)
+    {
+        valid = (rows[i + 1] >= rows[i]);
+        for (int j = rows[i]; valid && j < rows[i + 1]; ++j)
+        {
+            valid = (cols[j] >= 0 && cols[j] < nRow && (j == rows[i] || cols[j] > cols[j - 1]));
+        }
+    }
+    if (!valid)
+    {
+        if (s->rank == 0) fprintf(stderr, "[ERROR]: simultite.c: The CSR arrays are not a valid square matrix\n");
+        return EXIT_FAILURE;
+    }
+
+    const int nNz        = rows[nRow];
+    const int precisions = matrix_precisions(&s->options);
+    memset(&s->mat, 0, sizeof(csrMatrix));
+    s->mat.nRow = nRow;
+    s->mat.nCol = nRow;
+    s->mat.nNz  = nNz;
+    s->mat.rows = malloc((nRow + 1) * sizeof(int));
+    s->mat.cols = malloc(nNz * sizeof(int));
+    memcpy(s->mat.rows, rows, (nRow + 1) * sizeof(int));
+    memcpy(s->mat.cols, cols, nNz * sizeof(int));
+    if (precisions & MATRIX_SINGLE)
+    {
+        s->mat.svals = malloc(nNz * sizeof(float));
+        for (int j = 0; j < nNz; ++j) s->mat.svals[j] = (float) values[j];
+    }
+    if (precisions & MATRIX_DOUBLE)
+    {
+        s->mat.dvals = malloc(nNz * sizeof(double));
+        memcpy(s->mat.dvals, values, nNz * sizeof(double));
+    }
+    s->loaded = 1;
+    partition_loaded(s);
+    return EXIT_SUCCESS;
+}
+
+int simultite_load_stencil(
+        simultiteSolver       *s,
+        const stencilOperator *op)
+{
+    unload(s);
+    if (s->options.dist > 1)
+    {
+        if (s->rank == 0) fprintf(stderr, "[ERROR]: simultite.c: The distributed mode requires a stored matrix\n");
+        return EXIT_FAILURE;
+    }
+    // Matrix-free: nothing to read, the backends apply the stencil
+    s->stencil = *op;
+    stencil_matrix(&s->stencil, &s->mat);
+    if (s->rank == 0) printf("Matrix-free %d x %d x %d stencil, %d rows\n", op->nx, op->ny, op->nz, s->mat.nRow);
+    s->loaded = 1;
+    return EXIT_SUCCESS;
+}
+
+int simultite_solve(
+        simultiteSolver *s,
+        simultiteStatus *status)
+{
+    if (!s->loaded)
+    {
+        if (s->rank == 0) fprintf(stderr, "[ERROR]: simultite.c: No matrix to solve\n");
+        return EXIT_FAILURE;
+    }
+    free(s->result.values);
+    free(s->result.vectors);
+    free(s->result.errors);
+    memset(&s->result, 0, sizeof(solverResult));
+
+    const precision_t precision = s->options.precision;
+    const int         keep      = s->options.keepMatrix || s->mat.stencil != NULL;
+    solverContext ctx;
+    ctx.my_rank       = s->rank;
+    ctx.seedQ         = SEED + s->rank;
+    ctx.seedY         = SEED + s->size + s->rank / s->options.dist;
+    ctx.solver_comm   = s->solver_comm;
+    ctx.solver_rank   = s->solver_rank;
+    ctx.ensemble_comm = s->ensemble_comm;
+    ctx.node_comm     = s->node_comm;
+    ctx.keepMatrix    = keep || (precision == PRECISION_AUTO);
+    ctx.stallPeriods  = (precision == PRECISION_AUTO) ? PRECISION_STALL_PERIODS : 0;
+    ctx.result        = &s->result;
+    ctx.start         = s->start;
+    ctx.startCount    = s->startCount;
+    ctx.spmvVariant   = &s->spmvVariant;
+    ctx.num           = s->options.num;
+    ctx.kryl          = s->options.kryl;
+    ctx.refine        = s->options.refine;
+    ctx.backend       = s->options.backend;
+    ctx.devices       = s->options.devices;
+
+    int    stalled = 0;
+    double error;
+    status->solvedDouble = (precision == PRECISION_DOUBLE);
+    if (s->count > 0)
+    {
+        // The reduced problems are solved in double precision on the host, single precision has no stall to detect
+        ctx.keepMatrix   = keep;
+        ctx.stallPeriods = 0;
+        error = (precision == PRECISION_DOUBLE) ? solve_packed_d(&s->mat, &s->matWin, s->offsets, s->count, &ctx)
+                                                : solve_packed_s(&s->mat, &s->matWin, s->offsets, s->count, &ctx);
+    }
+    else if (precision == PRECISION_DOUBLE)
+    {
+        error = solve_d(&s->mat, &s->matWin, s->rowOffsets, &ctx, &stalled);
+    }
+    else
+    {
+        error = solve_s(&s->mat, &s->matWin, s->rowOffsets, &ctx, &stalled);
+        // The same on every rank, decided on the reduced error of the ensemble
+        MPI_Allreduce(MPI_IN_PLACE, &stalled, 1, MPI_INT, MPI_MAX, s->options.batch ? MPI_COMM_SELF : s->comm);
+        if (stalled)
+        {
+            if (s->rank == 0) printf("Single precision stalled above %g, solving again in double precision\n", MAX_TOL);
+            free(s->result.values);
+            free(s->result.vectors);
+            ctx.keepMatrix       = keep;
+            ctx.stallPeriods     = 0;
+            status->solvedDouble = 1;
+            error = solve_d(&s->mat, &s->matWin, s->rowOffsets, &ctx, &stalled);
+        }
+    }
+    status->nRow = s->mat.nRow;
+    status->nNz  = s->mat.nNz;
+    if (!keep)
+    {
+        free_Matrix(&s->mat, &s->matWin);
+        s->loaded = 0;
+    }
+
+    // The error is identical on the ranks of a group, the first group with the least one is the best
+    struct { double error; int rank; } local = {error, s->ensemble_rank}, best;
+    timing_begin(TIMING_REDUCTION);
+    MPI_Allreduce(&local, &best, 1, MPI_DOUBLE_INT, MPI_MINLOC, s->ensemble_comm);
+    timing_end(TIMING_REDUCTION);
+    status->error      = error;
+    status->bestError  = best.error;
+    status->isBest     = (best.rank == s->ensemble_rank);
+    status->solverRank = s->solver_rank;
+    s->isBest          = status->isBest;
+    return EXIT_SUCCESS;
+}
+
+int simultite_set_start(
+        simultiteSolver *s,
+        int             count,
+        const double    *vectors)
+{
+    if (!s->loaded || count < 1 || s->count > 0)
+    {
+        return EXIT_FAILURE;
+    }
+    const int nRow = s->mat.nRow;
+    free(s->start);
+    s->start      = malloc((size_t) count * nRow * sizeof(double));
+    s->startCount = count;
+    for (int k = 0; k < count; ++k)
+    {
+        double       *to   = s->start + (size_t) k * nRow;
+        const double *from = vectors + (size_t) k * nRow;
+        for (int i = 0; i < nRow; ++i)
+        {
+            to[(s->perm != NULL) ? s->perm[i] : i] = from[i];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int simultite_read_start(
+        simultiteSolver *s,
+        const char      *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    int    header[2];
+    double *vectors = NULL;
+    int    valid    = (fread(header, sizeof(int), 2, f) == 2 && header[0] == s->mat.nRow && header[1] > 0);
+    if (valid)
+    {
+        const size_t size = (size_t) header[0] * header[1];
+        vectors = malloc(size * sizeof(double));
+        valid   = (fread(vectors, sizeof(double), size, f) == size);
+    }
+    fclose(f);
+    int err = valid ? simultite_set_start(s, header[1], vectors) : EXIT_FAILURE;
+    free(vectors);
+    return err;
+}
+
+int simultite_write_vectors(
+        const simultiteSolver *s,
+        const char            *path)
+{
+    if (s->count > 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!s->isBest)
+    {
+        return EXIT_SUCCESS;
+    }
+    // The ranks of the best start gather their rows on their first rank
+    const solverResult *r    = &s->result;
+    const int          nRow  = s->mat.nRow;
+    int                size; MPI_Comm_size(s->solver_comm, &size);
+    int                *counts = NULL, *displs = NULL;
+    double             *all    = NULL;
+    if (s->solver_rank == 0)
+    {
+        counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+        all    = malloc((size_t) r->num * nRow * sizeof(double));
+    }
+    MPI_Gather(&r->n, 1, MPI_INT, counts, 1, MPI_INT, 0, s->solver_comm);
+    MPI_Gather(&r->rowStart, 1, MPI_INT, displs, 1, MPI_INT, 0, s->solver_comm);
+    for (int k = 0; k < r->num; ++k)
+    {
+        MPI_Gatherv(r->vectors + (size_t) k * r->n, r->n, MPI_DOUBLE,
+                all + (s->solver_rank == 0 ? (size_t) k * nRow : 0), counts, displs, MPI_DOUBLE, 0, s->solver_comm);
+    }
+
+    int err = EXIT_SUCCESS;
+    if (s->solver_rank == 0)
+    {
+        // Back to the row order of the matrix loaded
+        double *row = malloc(nRow * sizeof(double));
+        FILE   *f   = fopen(path, "wb");
+        const int header[2] = {nRow, r->num};
+        err = (f == NULL || fwrite(header, sizeof(int), 2, f) != 2);
+        for (int k = 0; !err && k < r->num; ++k)
+        {
+            for (int i = 0; i < nRow; ++i)
+            {
+                row[i] = all[(size_t) k * nRow + ((s->perm != NULL) ? s->perm[i] : i)];
+            }
+            err = (fwrite(row, sizeof(double), nRow, f) != (size_t) nRow);
+        }
+        if (f != NULL) fclose(f);
+        free(row);
+        free(all);
+        free(counts);
+        free(displs);
+    }
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int simultite_eigenpairs(
+        const simultiteSolver *s,
+        const double          **values,
+        const double          **vectors,
+        int                   *rowStart,
+        int                   *nRows)
+{
+    *values   = s->result.values;
+    *vectors  = s->result.vectors;
+    *rowStart = s->result.rowStart;
+    *nRows    = s->result.n;
+    return (s->result.count > 0) ? 0 : s->result.num;
+}
+
+int simultite_matrix_eigenpairs(
+        const simultiteSolver *s,
+        int                   index,
+        const double          **values,
+        const double          **vectors,
+        int                   *nRows,
+        double                *error)
+{
+    const solverResult *r = &s->result;
+    if (index < 0 || index >= r->count)
+    {
+        return 0;
+    }
+    *values  = r->values + (size_t) index * r->num;
+    *vectors = r->vectors + (size_t) r->num * s->offsets[index];
+    *nRows   = s->offsets[index + 1] - s->offsets[index];
+    *error   = r->errors[index];
+    return r->num;
+}
+
+const int *simultite_permutation(
+        const simultiteSolver *s)
+{
+    return s->perm;
+}
+
+void simultite_free(
+        simultiteSolver *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    unload(s);
+    solver_release_s();
+    solver_release_d();
+    MPI_Comm_free(&s->solver_comm);
+    MPI_Comm_free(&s->ensemble_comm);
+    MPI_Comm_free(&s->node_comm);
+    MPI_Comm_free(&s->comm);
+    free(s);
+}
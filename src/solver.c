@@ -0,0 +1,817 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file solver.c
+ * \brief Eigensolver running on the backend selected by the options
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#include "solver.h"
+#include "backend.h"
+#include "executable_options.h"
+#include "ensemble.h"
+#include "spmv_tune.h"
+#include "refine.h"
+#include "timing.h"
+#include "cpu_backend.h"
+#ifdef HAVE_OPENCL
+#include "cl_backend.h"
+#endif
+
+/// \brief Least bytes moved by an operation reading or writing \a vectors vectors of \a length values
+#define VECTOR_BYTES(vectors, length) ((double) (vectors) * (length) * sizeof(real_t))
+
+/**
+ * \brief End \a phase, once the device work enqueued in it is done if the timings are enabled
+ */
+static void phase_end(
+        solverBackend *b,
+        timingPhase_t phase)
+{
+    if (timing_enabled())
+    {
+        b->finish(b->state);
+    }
+    timing_end(phase);
+}
+
+/**
+ * \brief Upload \a mat to the backend of \a ctx, select its SpMV kernel and measure the bandwidth peak once per process
+ */
+static void open_backend(
+        solverBackend       *b,
+        csrMatrix           *mat,
+        MPI_Win             *matWin,
+        const int           *rowOffsets,
+        const solverContext *ctx)
+{
+    timing_begin(TIMING_UPLOAD);
+#ifdef HAVE_OPENCL
+    if (ctx->backend == BACKEND_OPENCL)
+    {
+        cl_backend_init(b, mat, matWin, rowOffsets, ctx);
+    }
+    else
+#endif
+    {
+        (void) matWin;
+        (void) rowOffsets;
+        cpu_backend_init(b, mat);
+    }
+    phase_end(b, TIMING_UPLOAD);
+    timing_begin(TIMING_TUNE);
+    const int variant = spmv_autotune(b, ctx->solver_comm, ctx->my_rank == 0,
+            (ctx->spmvVariant != NULL) ? *ctx->spmvVariant : -1);
+    if (ctx->spmvVariant != NULL) *ctx->spmvVariant = variant;
+    if (timing_enabled() && timing_peak() == 0.0)
+    {
+        // Ceiling of the roofline summary, each rank sharing the device with the others as during the solve
+        timing_set_peak(stream_bandwidth(b, ctx->solver_comm));
+    }
+    phase_end(b, TIMING_TUNE);
+}
+
+/**
+ * \brief Sum over k of ||HV_k - V V^T HV_k|| / ||HV_k||, the residual of the subspace of the orthonormal columns of \a V
+ *
+ * \a V and \a HV hold \a num columns of \a M values one after the other,
+ * \a HV the image by H of \a V. It vanishes once the subspace is invariant,
+ * whether H is normal or not. \a r is a scratch vector of \a M values.
+ */
+static double reduced_residual(
+        const double *V,
+        const double *HV,
+        int          M,
+        int          num,
+        double       *r)
+{
+    double sum = 0.0;
+    for (int k = 0; k < num; ++k)
+    {
+        const double *h = HV + (size_t) k * M;
+        double       hNorm = 0.0;
+        for (int i = 0; i < M; ++i)
+        {
+            r[i]   = h[i];
+            hNorm += h[i] * h[i];
+        }
+        for (int j = 0; j < num; ++j)
+        {
+            const double *vj  = V + (size_t) j * M;
+            double       dot = 0.0;
+            for (int i = 0; i < M; ++i) dot += vj[i] * r[i];
+            for (int i = 0; i < M; ++i) r[i] -= dot * vj[i];
+        }
+        double rNorm = 0.0;
+        for (int i = 0; i < M; ++i) rNorm += r[i] * r[i];
+        sum += (hNorm > 0.0) ? sqrt(rNorm / hNorm) : 0.0;
+    }
+    return sum;
+}
+
+/**
+ * \brief \a reduced_residual() of the blocks \a V and \a HV of the backend
+ *
+ * \a v and \a hv receive the columns through \a buffer, of \a M values.
+ */
+static double subspace_residual(
+        solverBackend *b,
+        void          *V,
+        void          *HV,
+        int           M,
+        int           num,
+        real_t        *buffer,
+        double        *v,
+        double        *hv,
+        double        *r)
+{
+    for (int k = 0; k < num; ++k)
+    {
+        b->read_vector(b->state, (backendVec) {V, k}, buffer);
+        for (int i = 0; i < M; ++i) v[(size_t) k * M + i] = buffer[i];
+        b->read_vector(b->state, (backendVec) {HV, k}, buffer);
+        for (int i = 0; i < M; ++i) hv[(size_t) k * M + i] = buffer[i];
+    }
+    return reduced_residual(v, hv, M, num, r);
+}
+
+/**
+ * \brief Arnoldi start vector \a init of a warm start from the \a count vectors of \a nGlobal values of \a start
+ *
+ * A start vector x is an eigenvector if ||A x - theta x|| <= WARM_START_TOL
+ * |theta| ||x||, theta being its Rayleigh quotient, and then \a converged.
+ * The start is the random vector \a init normalized plus the normalized
+ * eigenvectors: the Krylov space holds them, and the random part as much
+ * of the other directions as a random start, so that a warm start from
+ * eigenvectors finds them again and the starts of the ensemble stay apart.
+ * The other start vectors are left out, they would only move the Krylov
+ * space away from the one of their own solve. \a X and \a W receive the
+ * start vectors and their images.
+ */
+static void warm_start(
+        solverBackend *b,
+        void          *X,
+        void          *W,
+        const double  *start,
+        int           nGlobal,
+        int           count,
+        MPI_Comm      comm,
+        real_t        *init,
+        int           *converged)
+{
+    const int n  = b->n;
+    double    *q = malloc((n > 0 ? n : 1) * sizeof(double));
+    double    rr = 0.0;
+    for (int i = 0; i < n; ++i) rr += (double) init[i] * init[i];
+    MPI_Allreduce(MPI_IN_PLACE, &rr, 1, MPI_DOUBLE, MPI_SUM, comm);
+    for (int i = 0; i < n; ++i) q[i] = init[i] / sqrt(rr);
+
+    for (int k = 0; k < count; ++k)
+    {
+        const double *x = start + (size_t) k * nGlobal + b->rowStart;
+        for (int i = 0; i < n; ++i) init[i] = (real_t) x[i];
+        b->write_vector(b->state, (backendVec) {X, k}, init);
+        b->spmv(b->state, (backendVec) {X, k}, (backendVec) {W, k});
+        b->read_vector(b->state, (backendVec) {W, k}, init);
+        // x.x, x.Ax and Ax.Ax, so that ||A x - theta x||^2 = Ax.Ax - theta x.Ax
+        double dots[3] = {0.0, 0.0, 0.0};
+        for (int i = 0; i < n; ++i)
+        {
+            dots[0] += x[i] * x[i];
+            dots[1] += x[i] * init[i];
+            dots[2] += (double) init[i] * init[i];
+        }
+        MPI_Allreduce(MPI_IN_PLACE, dots, 3, MPI_DOUBLE, MPI_SUM, comm);
+        const double theta    = (dots[0] > 0.0) ? dots[1] / dots[0] : 0.0;
+        const double residual = sqrt(fmax(dots[2] - theta * dots[1], 0.0));
+        converged[k] = (dots[0] > 0.0 && residual <= WARM_START_TOL * fabs(theta) * sqrt(dots[0]));
+        for (int i = 0; converged[k] && i < n; ++i) q[i] += x[i] / sqrt(dots[0]);
+    }
+    for (int i = 0; i < n; ++i) init[i] = (real_t) q[i];
+    free(q);
+}
+
+double solve(
+        csrMatrix           *mat,
+        MPI_Win             *matWin,
+        const int           *rowOffsets,
+        const solverContext *ctx,
+        int                 *stalled)
+{
+    const int M   = ctx->kryl;
+    const int num = ctx->num;
+
+    // The OpenCL backend releases the host matrix once uploaded
+    refineMatrix rm;
+    if (ctx->refine > 0)
+    {
+        refine_init(&rm, mat, rowOffsets, ctx->solver_comm);
+    }
+
+    solverBackend b;
+    open_backend(&b, mat, matWin, rowOffsets, ctx);
+    // Number of rows of the matrix and of the vectors held by this rank
+    const int n = b.n;
+
+    // The Arnoldi vectors are allocated last, with the device memory left
+    void *H = b.create_block(b.state, M + 1, M);   // Hessenberg matrix, column k - 1 built at step k
+    void *Y = b.create_block(b.state, M, num);     // reduced vectors
+    void *T = b.create_block(b.state, M, num);     // H Y, swapped with Y
+    void *X = b.create_block(b.state, n, num);     // eigenvectors
+    void *W = b.create_block(b.state, n, num);     // residuals
+    void *S = b.create_block(b.state, 2, num);     // norms of the eigenvectors and of the residuals
+    void *Q = (b.create_basis != NULL) ? b.create_basis(b.state, n, M + 1)
+                                       : b.create_block(b.state, n, M + 1);   // Arnoldi vectors
+
+    real_t *init = malloc(((n > M) ? n : M) * sizeof(real_t));
+    srand(ctx->seedQ);
+    for (int j = 0; j < n; ++j)
+    {
+        init[j] = ((real_t) rand())/RAND_MAX;
+    }
+    // Warm start from the first start vectors, one per eigenpair, of which only the eigenvectors are used
+    const int count     = (ctx->start != NULL) ? ((ctx->startCount < num) ? ctx->startCount : num) : 0;
+    int       *converged = calloc((count > 0) ? count : 1, sizeof(int));
+    if (count > 0)
+    {
+        warm_start(&b, X, W, ctx->start, mat->nRow, count, ctx->solver_comm, init, converged);
+    }
+    b.write_vector(b.state, (backendVec) {Q, 0}, init);
+    // The reduced problem is replicated, all the ranks of a group start from the same y
+    srand(ctx->seedY);
+    for (int k = 0; k < num; ++k)
+    {
+        for (int j = 0; j < M; ++j)
+        {
+            init[j] = ((real_t) rand())/RAND_MAX;
+        }
+        b.write_vector(b.state, (backendVec) {Y, k}, init);
+    }
+    b.orthonormalize(b.state, Y);
+
+/**** Arnodli Projection *****/
+    timing_begin(TIMING_ARNOLDI_ORTHO);
+    b.normalize(b.state, (backendScalar) {S, 0, 0}, (backendVec) {Q, 0});
+    timing_add_work(VECTOR_BYTES(2, n), 3.0 * n);
+    phase_end(&b, TIMING_ARNOLDI_ORTHO);
+    for (int k = 1; k <= M; ++k)
+    {
+        timing_begin(TIMING_ARNOLDI_SPMV);
+        b.spmv(b.state, (backendVec) {Q, k - 1}, (backendVec) {Q, k});
+        timing_add_work(b.spmvBytes, b.spmvFlops);
+        phase_end(&b, TIMING_ARNOLDI_SPMV);
+        timing_begin(TIMING_ARNOLDI_ORTHO);
+        for (int j = 0; j < k; ++j)
+        {
+            b.dot_axpy(b.state, (backendScalar) {H, k - 1, j}, (backendVec) {Q, j}, (backendVec) {Q, k});
+        }
+        b.normalize(b.state, (backendScalar) {H, k - 1, k}, (backendVec) {Q, k});
+        // Each projection reads q and w and writes w
+        timing_add_work(VECTOR_BYTES(3 * k + 2, n), (4.0 * k + 3.0) * n);
+        phase_end(&b, TIMING_ARNOLDI_ORTHO);
+
+        if (b.report != NULL)
+        {
+            char label[32];
+            snprintf(label, sizeof(label), "Arnoldi step %d", k);
+            b.report(b.state, label, 0);
+        }
+    }
+
+    if (count > 0)
+    {
+        // Reduced vectors of the converged start vectors: their coordinates in the Arnoldi basis, the others stay random
+        double       *coord = calloc((size_t) M * count, sizeof(double));
+        const double *start = ctx->start + b.rowStart;
+        for (int j = 0; j < M; ++j)
+        {
+            b.read_vector(b.state, (backendVec) {Q, j}, init);
+            for (int k = 0; k < count; ++k)
+            {
+                const double *x = start + (size_t) k * mat->nRow;
+                for (int i = 0; i < n; ++i)
+                {
+                    coord[k * M + j] += init[i] * x[i];
+                }
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, coord, M * count, MPI_DOUBLE, MPI_SUM, ctx->solver_comm);
+        for (int k = 0; k < count; ++k)
+        {
+            if (!converged[k])
+            {
+                continue;
+            }
+            for (int j = 0; j < M; ++j)
+            {
+                init[j] = (real_t) coord[k * M + j];
+            }
+            b.write_vector(b.state, (backendVec) {Y, k}, init);
+        }
+        b.orthonormalize(b.state, Y);
+        free(coord);
+    }
+    free(converged);
+
+/**** Simultaneous Iteration Method on the matrix H computed with the Arnoldi factorization ****/
+    unsigned nb_iter = NB_ITER;
+    ensembleMonitor ensemble;
+    ensemble_init(&ensemble, ctx->ensemble_comm, ENSEMBLE_PERIOD, ENSEMBLE_LAG_RATIO);
+    // The subspace residual of each vector bottoms out within a hundred roundings of the precision
+    ensemble_stop_on_stall(&ensemble, ctx->stallPeriods, PRECISION_STALL_ROUNDINGS * num * REAL_EPSILON);
+    ensembleState_t state = ENSEMBLE_RUNNING;
+
+    double *subV   = malloc((size_t) M * num * sizeof(double));
+    double *subHV  = malloc((size_t) M * num * sizeof(double));
+    double *subRes = malloc(M * sizeof(double));
+    double shift   = 0.0;
+    while (nb_iter--)
+    {
+        timing_begin(TIMING_ITERATION);
+        // A lagging start only keeps up with the reductions of the ensemble
+        if (state == ENSEMBLE_LAGGING)
+        {
+            timing_begin(TIMING_REDUCTION);
+            state = ensemble_update(&ensemble, 0.0);
+            timing_end(TIMING_REDUCTION);
+            timing_end(TIMING_ITERATION);
+            if (state == ENSEMBLE_STOP) break;
+            continue;
+        }
+
+        b.gemm(b.state, H, Y, T);
+        void *tmpBlock = Y; Y = T; T = tmpBlock;
+        // Tolerance check, before the orthonormalization: T holds the orthonormal Y and Y its image H Y
+        shift = subspace_residual(&b, T, Y, M, num, init, subV, subHV, subRes);
+        if (ctx->solver_rank == 0) printf("P%d: Partial Error : %g\n", ctx->my_rank, shift);
+        b.orthonormalize(b.state, Y);
+        // H Y, then the two passes of Gram matrix and triangular solve of CholQR2
+        timing_add_work(VECTOR_BYTES(M + 2 * num, M) + VECTOR_BYTES(6 * num, M),
+                2.0 * M * M * num + 6.0 * M * num * num);
+
+        timing_begin(TIMING_REDUCTION);
+        state = ensemble_update(&ensemble, shift);
+        timing_end(TIMING_REDUCTION);
+        if (state == ENSEMBLE_LAGGING && ctx->solver_rank == 0)
+        {
+            printf("P%d: lagging behind start %d (%g), stopping\n", ctx->my_rank, ensemble.best.rank, ensemble.best.value);
+        }
+        // The vectors read back above already waited for the device
+        timing_end(TIMING_ITERATION);
+        if (state == ENSEMBLE_STOP) break;
+    }
+    timing_begin(TIMING_REDUCTION);
+    ensemble_finish(&ensemble);
+    timing_end(TIMING_REDUCTION);
+    *stalled = ensemble.stalled;
+    if (ensemble.stalled && ctx->my_rank == 0)
+    {
+        printf("P%d: error stalled at %g\n", ctx->my_rank, ensemble.best.value);
+    }
+
+    // A lagging start is never the best one, a stalled run is solved again: skip their recovery and residuals
+    double       error = 0.0;
+    solverResult *res  = ctx->result;
+    if (res != NULL)
+    {
+        memset(res, 0, sizeof(solverResult));
+    }
+    if (ensemble.lagged || ensemble.stalled)
+    {
+        error = HUGE_VAL;
+    }
+    else
+    {
+        if (res != NULL)
+        {
+            res->num      = num;
+            res->rowStart = b.rowStart;
+            res->n        = n;
+            res->values   = malloc(num * sizeof(double));
+            res->vectors  = malloc((size_t) num * (n > 0 ? n : 1) * sizeof(double));
+        }
+
+        // Recover the eigenvectors in the big space by computing x_i = Q_m y_i
+        timing_begin(TIMING_RECOVERY);
+        b.gemm(b.state, Q, Y, X);
+        timing_add_work(VECTOR_BYTES(M + num, n) + VECTOR_BYTES(num, M), 2.0 * n * M * num);
+        phase_end(&b, TIMING_RECOVERY);
+
+        // Residual ||A x - ||x|| x||, independent for each eigenvector
+        timing_begin(TIMING_RESIDUAL);
+        for (int k = 0; k < num; ++k)
+        {
+            if (b.set_stream != NULL) b.set_stream(b.state, k);
+            b.spmv(b.state, (backendVec) {X, k}, (backendVec) {W, k});
+            b.nrm2(b.state, (backendScalar) {S, k, 0}, (backendVec) {X, k});
+            b.axpy(b.state, (backendScalar) {S, k, 0}, -1.0, (backendVec) {X, k}, (backendVec) {W, k});
+            b.nrm2(b.state, (backendScalar) {S, k, 1}, (backendVec) {W, k});
+            timing_add_work(b.spmvBytes + VECTOR_BYTES(5, n), b.spmvFlops + 6.0 * n);
+        }
+        if (b.set_stream != NULL) b.set_stream(b.state, BACKEND_MAIN_STREAM);
+        double *residuals = malloc(num * sizeof(double));
+        for (int k = 0; k < num; ++k)
+        {
+            residuals[k] = b.read_scalar(b.state, (backendScalar) {S, k, 1});
+            error       += residuals[k];
+        }
+        // Eigenpairs: x and its Rayleigh quotient x.Ax / x.x = ||x|| + x.w / x.x, w being A x - ||x|| x
+        for (int k = 0; res != NULL && k < num; ++k)
+        {
+            double *x      = res->vectors + (size_t) k * n;
+            double dots[2] = {0.0, 0.0};
+            b.read_vector(b.state, (backendVec) {X, k}, init);
+            for (int i = 0; i < n; ++i) x[i] = init[i];
+            b.read_vector(b.state, (backendVec) {W, k}, init);
+            for (int i = 0; i < n; ++i)
+            {
+                dots[0] += x[i] * init[i];
+                dots[1] += x[i] * x[i];
+            }
+            MPI_Allreduce(MPI_IN_PLACE, dots, 2, MPI_DOUBLE, MPI_SUM, ctx->solver_comm);
+            res->values[k] = b.read_scalar(b.state, (backendScalar) {S, k, 0}) + dots[0] / dots[1];
+        }
+        phase_end(&b, TIMING_RESIDUAL);
+
+        // Double precision refinement, the residual of each converged pair replaces its own in the
+        // error; the pairs that did not converge are kept as the solver found them
+        if (ctx->refine > 0)
+        {
+            timing_begin(TIMING_REFINE);
+            double *x       = malloc((n > 0 ? n : 1) * sizeof(double));
+            double start    = MPI_Wtime();
+            int    steps    = 0;
+            for (int k = 0; k < num; ++k)
+            {
+                b.read_vector(b.state, (backendVec) {X, k}, init);
+                for (int i = 0; i < n; ++i) x[i] = init[i];
+                refineResult r = refine_pair(&rm, x, ctx->refine);
+                steps += r.steps;
+                if (ctx->solver_rank == 0 && r.converged)
+                {
+                    printf("P%d: eigenpair %d refined in %d steps: eigenvalue %.15g, residual %g -> %g\n",
+                            ctx->my_rank, k, r.steps, r.eigenvalue, r.initialResidual, r.residual);
+                }
+                else if (ctx->solver_rank == 0)
+                {
+                    printf("P%d: eigenpair %d not converged in %d steps (residual %g -> %g), kept unrefined\n",
+                            ctx->my_rank, k, r.steps, r.initialResidual, r.residual);
+                }
+                if (!r.converged)
+                {
+                    continue;
+                }
+                for (int i = 0; i < n; ++i) init[i] = (real_t) x[i];
+                b.write_vector(b.state, (backendVec) {X, k}, init);
+                if (res != NULL)
+                {
+                    res->values[k] = r.eigenvalue;
+                    memcpy(res->vectors + (size_t) k * n, x, n * sizeof(double));
+                }
+                error += r.residual - residuals[k];
+            }
+            if (ctx->solver_rank == 0)
+            {
+                printf("P%d: refinement: %d steps in %.3f s\n", ctx->my_rank, steps, MPI_Wtime() - start);
+            }
+            free(x);
+            timing_end(TIMING_REFINE);
+        }
+        free(residuals);
+    }
+    if (b.report != NULL)
+    {
+        b.report(b.state, "Whole run", 1);
+    }
+
+    free(subV);
+    free(subHV);
+    free(subRes);
+    free(init);
+    void *blocks[7] = {Q, H, Y, T, X, W, S};
+    for (int i = 0; i < 7; ++i)
+    {
+        b.free_block(b.state, blocks[i]);
+    }
+    b.free(b.state);
+    if (ctx->refine > 0)
+    {
+        refine_free(&rm);
+    }
+    return error;
+}
+
+/**
+ * \brief Simultaneous iteration on the \a M x \a M Hessenberg matrix \a H of leading dimension \a ldh
+ *
+ * \a Y holds \a num orthonormal columns of \a M values, replaced by the
+ * reduced vectors; \a T holds as many and \a r \a M values of scratch. Stops
+ * once \a reduced_residual() is below MAX_TOL, which it reaches in double
+ * precision.
+ *
+ * \return the number of iterations
+ */
+static int reduced_iteration(
+        const double *H,
+        int          ldh,
+        int          M,
+        int          num,
+        double       *Y,
+        double       *T,
+        double       *r)
+{
+    for (int iter = 1; ; ++iter)
+    {
+        for (int k = 0; k < num; ++k)
+        {
+            const double *y = Y + (size_t) k * M;
+            double       *t = T + (size_t) k * M;
+            for (int i = 0; i < M; ++i) t[i] = 0.0;
+            for (int j = 0; j < M; ++j)
+            {
+                for (int i = 0; i < M; ++i) t[i] += H[(size_t) j * ldh + i] * y[j];
+            }
+        }
+        const double residual = reduced_residual(Y, T, M, num, r);
+        dense_tsqr(T, M, num, M);
+        memcpy(Y, T, (size_t) M * num * sizeof(double));
+        if (residual < MAX_TOL || iter == NB_ITER)
+        {
+            return iter;
+        }
+    }
+}
+
+/**
+ * \brief \a refine_init() of the diagonal block of the rows [\a first, \a last) of \a mat, on this rank alone
+ */
+static void refine_block(
+        refineMatrix    *rm,
+        const csrMatrix *mat,
+        int             first,
+        int             last)
+{
+    const int base  = mat->rows[first];
+    csrMatrix block;
+    memset(&block, 0, sizeof(csrMatrix));
+    block.nRow  = last - first;
+    block.nCol  = block.nRow;
+    block.nNz   = mat->rows[last] - base;
+    block.rows  = malloc((block.nRow + 1) * sizeof(int));
+    block.cols  = malloc((block.nNz > 0 ? block.nNz : 1) * sizeof(int));
+    block.svals = (mat->svals != NULL) ? mat->svals + base : NULL;
+    block.dvals = (mat->dvals != NULL) ? mat->dvals + base : NULL;
+    for (int i = 0; i <= block.nRow; ++i) block.rows[i] = mat->rows[first + i] - base;
+    for (int j = 0; j < block.nNz; ++j)   block.cols[j] = mat->cols[base + j] - first;
+    refine_init(rm, &block, NULL, MPI_COMM_SELF);
+    free(block.rows);
+    free(block.cols);
+}
+
+double solve_packed(
+        csrMatrix           *mat,
+        MPI_Win             *matWin,
+        const int           *offsets,
+        int                 count,
+        const solverContext *ctx)
+{
+    const int M   = ctx->kryl;
+    const int num = ctx->num;
+    const int ldh = count * (M + 1);
+
+    // The OpenCL backend releases the host matrix once uploaded
+    refineMatrix *rm = NULL;
+    if (ctx->refine > 0)
+    {
+        rm = malloc(count * sizeof(refineMatrix));
+        for (int g = 0; g < count; ++g)
+        {
+            refine_block(rm + g, mat, offsets[g], offsets[g + 1]);
+        }
+    }
+
+    solverBackend b;
+    open_backend(&b, mat, matWin, NULL, ctx);
+    const int n = b.n;
+    b.set_segments(b.state, count, offsets);
+
+    void *H = b.create_block(b.state, ldh, M);         // Hessenberg matrices one below the other
+    void *Y = b.create_block(b.state, count * M, num); // reduced vectors, likewise
+    void *X = b.create_block(b.state, n, num);         // eigenvectors
+    void *W = b.create_block(b.state, n, num);         // their images
+    void *S = b.create_block(b.state, count, 1);       // norms of the start vectors
+    void *Q = (b.create_basis != NULL) ? b.create_basis(b.state, n, M + 1)
+                                       : b.create_block(b.state, n, M + 1);   // Arnoldi vectors
+
+    // Each matrix starts from the vector of its own solve
+    real_t *init = malloc(((n > ldh) ? n : ldh) * sizeof(real_t));
+    for (int g = 0; g < count; ++g)
+    {
+        srand(ctx->seedQ);
+        for (int j = offsets[g]; j < offsets[g + 1]; ++j)
+        {
+            init[j] = ((real_t) rand())/RAND_MAX;
+        }
+    }
+    b.write_vector(b.state, (backendVec) {Q, 0}, init);
+
+/**** Arnoldi Projection of all the matrices, one launch per operation ****/
+    timing_begin(TIMING_ARNOLDI_ORTHO);
+    b.seg_normalize(b.state, (backendScalar) {S, 0, 0}, 1, (backendVec) {Q, 0});
+    timing_add_work(VECTOR_BYTES(2, n), 3.0 * n);
+    phase_end(&b, TIMING_ARNOLDI_ORTHO);
+    for (int k = 1; k <= M; ++k)
+    {
+        timing_begin(TIMING_ARNOLDI_SPMV);
+        b.spmv(b.state, (backendVec) {Q, k - 1}, (backendVec) {Q, k});
+        timing_add_work(b.spmvBytes, b.spmvFlops);
+        phase_end(&b, TIMING_ARNOLDI_SPMV);
+        timing_begin(TIMING_ARNOLDI_ORTHO);
+        for (int j = 0; j < k; ++j)
+        {
+            b.seg_dot_axpy(b.state, (backendScalar) {H, k - 1, j}, M + 1, (backendVec) {Q, j}, (backendVec) {Q, k});
+        }
+        b.seg_normalize(b.state, (backendScalar) {H, k - 1, k}, M + 1, (backendVec) {Q, k});
+        timing_add_work(VECTOR_BYTES(3 * k + 2, n), (4.0 * k + 3.0) * n);
+        phase_end(&b, TIMING_ARNOLDI_ORTHO);
+    }
+
+/**** Simultaneous Iteration Method on each Hessenberg matrix, on the host in double precision ****/
+    timing_begin(TIMING_ITERATION);
+    double *h = malloc((size_t) ldh * M * sizeof(double));
+    double *y = malloc((size_t) count * M * num * sizeof(double));
+    double *t = malloc((size_t) M * num * sizeof(double));
+    double *r = malloc(M * sizeof(double));
+    for (int j = 0; j < M; ++j)
+    {
+        b.read_vector(b.state, (backendVec) {H, j}, init);
+        for (int i = 0; i < ldh; ++i) h[(size_t) j * ldh + i] = init[i];
+    }
+    int most = 0;
+    for (int g = 0; g < count; ++g)
+    {
+        // The reduced vectors start as in the solve of the matrix alone
+        double *yg = y + (size_t) g * M * num;
+        srand(ctx->seedY);
+        for (int i = 0; i < M * num; ++i)
+        {
+            yg[i] = ((real_t) rand())/RAND_MAX;
+        }
+        dense_tsqr(yg, M, num, M);
+        const int iter = reduced_iteration(h + (size_t) g * (M + 1), ldh, M, num, yg, t, r);
+        if (iter > most) most = iter;
+    }
+    for (int k = 0; k < num; ++k)
+    {
+        for (int g = 0; g < count; ++g)
+        {
+            for (int i = 0; i < M; ++i) init[g * M + i] = (real_t) y[((size_t) g * num + k) * M + i];
+        }
+        b.write_vector(b.state, (backendVec) {Y, k}, init);
+    }
+    timing_add_work(VECTOR_BYTES(M + 1, ldh), 2.0 * count * M * M * num * most);
+    timing_end(TIMING_ITERATION);
+    if (ctx->my_rank == 0)
+    {
+        printf("P%d: %d matrices of %d rows in all, reduced problems solved in at most %d iterations\n",
+                ctx->my_rank, count, n, most);
+    }
+
+    // Recover the eigenvectors x_i = Q_m y_i of all the matrices at once
+    timing_begin(TIMING_RECOVERY);
+    b.seg_gemm(b.state, Q, Y, X);
+    timing_add_work(VECTOR_BYTES(M + num, n) + VECTOR_BYTES(num, count * M), 2.0 * n * M * num);
+    phase_end(&b, TIMING_RECOVERY);
+
+    // Residual ||A x - ||x|| x|| and Rayleigh quotient of each eigenvector, on the host per matrix
+    timing_begin(TIMING_RESIDUAL);
+    for (int k = 0; k < num; ++k)
+    {
+        if (b.set_stream != NULL) b.set_stream(b.state, k);
+        b.spmv(b.state, (backendVec) {X, k}, (backendVec) {W, k});
+        timing_add_work(b.spmvBytes + VECTOR_BYTES(2, n), b.spmvFlops + 6.0 * n);
+    }
+    if (b.set_stream != NULL) b.set_stream(b.state, BACKEND_MAIN_STREAM);
+    solverResult *res      = ctx->result;
+    double       *values   = malloc((size_t) count * num * sizeof(double));
+    double       *vectors  = malloc((size_t) num * (n > 0 ? n : 1) * sizeof(double));
+    double       *errors   = calloc(count, sizeof(double));
+    double       *residual = malloc((size_t) count * num * sizeof(double));
+    double       *ax       = malloc((n > 0 ? n : 1) * sizeof(double));
+    for (int k = 0; k < num; ++k)
+    {
+        b.read_vector(b.state, (backendVec) {W, k}, init);
+        for (int i = 0; i < n; ++i) ax[i] = init[i];
+        b.read_vector(b.state, (backendVec) {X, k}, init);
+        for (int g = 0; g < count; ++g)
+        {
+            const int first = offsets[g], rows = offsets[g + 1] - first;
+            double    *x    = vectors + (size_t) num * first + (size_t) k * rows;
+            double    xx    = 0.0, xAx = 0.0, rr = 0.0;
+            for (int i = 0; i < rows; ++i)
+            {
+                x[i] = init[first + i];
+                xx  += x[i] * x[i];
+                xAx += x[i] * ax[first + i];
+            }
+            const double norm = sqrt(xx);
+            for (int i = 0; i < rows; ++i)
+            {
+                const double w = ax[first + i] - norm * x[i];
+                rr += w * w;
+            }
+            values[g * num + k]   = (xx > 0.0) ? xAx / xx : 0.0;
+            residual[g * num + k] = sqrt(rr);
+            errors[g]            += residual[g * num + k];
+        }
+    }
+    phase_end(&b, TIMING_RESIDUAL);
+
+    // Double precision refinement of each matrix against its own rows, as in solve()
+    if (ctx->refine > 0)
+    {
+        timing_begin(TIMING_REFINE);
+        double start = MPI_Wtime();
+        int    steps = 0, refined = 0;
+        for (int g = 0; g < count; ++g)
+        {
+            const int rows = offsets[g + 1] - offsets[g];
+            for (int k = 0; k < num; ++k)
+            {
+                double *x = vectors + (size_t) num * offsets[g] + (size_t) k * rows;
+                memcpy(ax, x, rows * sizeof(double));
+                refineResult rr = refine_pair(rm + g, ax, ctx->refine);
+                steps += rr.steps;
+                if (!rr.converged)
+                {
+                    continue;
+                }
+                refined++;
+                memcpy(x, ax, rows * sizeof(double));
+                values[g * num + k] = rr.eigenvalue;
+                errors[g]          += rr.residual - residual[g * num + k];
+            }
+            refine_free(rm + g);
+        }
+        if (ctx->my_rank == 0)
+        {
+            printf("P%d: refinement: %d of %d eigenpairs converged in %d steps in %.3f s\n", ctx->my_rank,
+                    refined, count * num, steps, MPI_Wtime() - start);
+        }
+        free(rm);
+        timing_end(TIMING_REFINE);
+    }
+
+    double error = 0.0;
+    for (int g = 0; g < count; ++g) error += errors[g];
+    if (res != NULL)
+    {
+        res->num      = num;
+        res->rowStart = 0;
+        res->n        = n;
+        res->count    = count;
+        res->values   = values;
+        res->vectors  = vectors;
+        res->errors   = errors;
+    }
+    else
+    {
+        free(values);
+        free(vectors);
+        free(errors);
+    }
+
+    free(residual);
+    free(ax);
+    free(h);
+    free(y);
+    free(t);
+    free(r);
+    free(init);
+    void *blocks[6] = {Q, H, Y, X, W, S};
+    for (int i = 0; i < 6; ++i)
+    {
+        b.free_block(b.state, blocks[i]);
+    }
+    b.free(b.state);
+    return error;
+}
+
+void solver_acquire()
+{
+#ifdef HAVE_OPENCL
+    cl_backend_acquire();
+#endif
+}
+
+void solver_release()
+{
+#ifdef HAVE_OPENCL
+    cl_backend_release();
+#endif
+}
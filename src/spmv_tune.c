@@ -0,0 +1,320 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file spmv_tune.c
+ * \brief Selection of the fastest SpMV kernel of a backend for the loaded matrix
+ *
+ */
+
+#include "spmv_tune.h"
+
+#define FNV_PRIME  1099511628211ULL
+
+unsigned long long fnv1a(
+        unsigned long long h,
+        const void         *data,
+        size_t             size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h = (h ^ bytes[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+unsigned long long matrix_fingerprint(
+        const csrMatrix *mat,
+        int             firstRow,
+        int             nRows,
+        const char      *salt)
+{
+    unsigned long long h = FNV_OFFSET;
+    // The timings also depend on the precision of the copy
+    const int header[4] = {mat->nRow, firstRow, nRows, (int) sizeof(real_t)};
+    h = fnv1a(h, header, sizeof(header));
+    if (mat->stencil != NULL)
+    {
+        const int grid[3] = {mat->stencil->nx, mat->stencil->ny, mat->stencil->nz};
+        h = fnv1a(h, grid, sizeof(grid));
+        return fnv1a(h, salt, strlen(salt));
+    }
+    for (int i = firstRow; i < firstRow + nRows; ++i)
+    {
+        const int length = mat->rows[i+1] - mat->rows[i];
+        h = fnv1a(h, &length, sizeof(int));
+    }
+    h = fnv1a(h, mat->cols + mat->rows[firstRow],
+            (size_t) (mat->rows[firstRow + nRows] - mat->rows[firstRow]) * sizeof(int));
+    return fnv1a(h, salt, strlen(salt));
+}
+
+/**
+ * \brief Path of the cache file into \a path
+ */
+static int cache_path(
+        char   *path,
+        size_t size)
+{
+    const char *file = getenv("SIMULTITE_TUNE_CACHE");
+    if (file != NULL)
+    {
+        snprintf(path, size, "%s", file);
+        return EXIT_SUCCESS;
+    }
+    const char *home = getenv("HOME");
+    if (home == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    snprintf(path, size, "%s/.simultite_spmv_cache", home);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Index of the kernel called \a name, -1 if the backend has none
+ */
+static int variant_index(
+        const solverBackend *backend,
+        const char          *name)
+{
+    for (int v = 0; v < backend->num_variants; ++v)
+    {
+        if (strcmp(backend->variant_names[v], name) == 0)
+        {
+            return v;
+        }
+    }
+    return -1;
+}
+
+/**
+ * \brief Kernel cached for \a key on the backend of \a backend, the last entry wins, -1 if none
+ */
+static int cache_lookup(
+        const solverBackend *backend,
+        unsigned long long  key)
+{
+    char path[4096];
+    if (cache_path(path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return -1;
+    }
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    int                found = -1;
+    unsigned long long entry;
+    char               name[64], variant[64];
+    while (fscanf(f, "%llx %63s %63s", &entry, name, variant) == 3)
+    {
+        if (entry == key && strcmp(name, backend->name) == 0)
+        {
+            found = variant_index(backend, variant);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/**
+ * \brief Append the choice of a kernel for the fingerprints of the ranks of \a comm missing from the cache
+ *
+ * Rank 0 of \a comm writes the entries, once per fingerprint and only if no
+ * other group stored the same choice in the meantime, so the file only grows
+ * with new matrices.
+ */
+static void cache_store(
+        const solverBackend *backend,
+        int                 variant,
+        int                 missing,
+        MPI_Comm            comm)
+{
+    int rank; MPI_Comm_rank(comm, &rank);
+    int size; MPI_Comm_size(comm, &size);
+    unsigned long long key = missing ? backend->fingerprint : 0, *keys = NULL;
+    if (rank == 0)
+    {
+        keys = malloc(size * sizeof(unsigned long long));
+    }
+    MPI_Gather(&key, 1, MPI_UNSIGNED_LONG_LONG, keys, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+    if (rank != 0)
+    {
+        return;
+    }
+
+    char path[4096];
+    FILE *f     = NULL;
+    int  usable = (cache_path(path, sizeof(path)) == EXIT_SUCCESS);
+    for (int r = 0; r < size && usable; ++r)
+    {
+        // Also replaces an entry whose kernel did not suit the rows
+        int seen = (keys[r] == 0 || cache_lookup(backend, keys[r]) == variant);
+        for (int q = 0; q < r && !seen; ++q)
+        {
+            seen = (keys[q] == keys[r]);
+        }
+        if (!seen && (f != NULL || (f = fopen(path, "a")) != NULL))
+        {
+            fprintf(f, "%016llx %s %s\n", keys[r], backend->name, backend->variant_names[variant]);
+        }
+    }
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+    free(keys);
+}
+
+/**
+ * \brief Time of one product with the selected kernel on the slowest rank of \a comm
+ */
+static double time_spmv(
+        solverBackend *backend,
+        backendVec    x,
+        backendVec    y,
+        MPI_Comm      comm)
+{
+    backend->spmv(backend->state, x, y);
+    backend->finish(backend->state);
+    MPI_Barrier(comm);
+
+    double start = MPI_Wtime();
+    for (int r = 0; r < SPMV_TUNE_REPS; ++r)
+    {
+        backend->spmv(backend->state, x, y);
+    }
+    backend->finish(backend->state);
+    double elapsed = (MPI_Wtime() - start) / SPMV_TUNE_REPS;
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return elapsed;
+}
+
+int spmv_autotune(
+        solverBackend *backend,
+        MPI_Comm      comm,
+        int           verbose,
+        int           previous)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    verbose = verbose && (rank == 0);
+
+    // A matrix-free operator has a single kernel, nothing to choose
+    if (backend->num_variants == 1)
+    {
+        backend->set_spmv_variant(backend->state, 0);
+        if (verbose) printf("SpMV kernel: %s\n", backend->variant_names[0]);
+        return 0;
+    }
+
+    // Forced by the user, no timing
+    const char *forced = getenv("SIMULTITE_SPMV");
+    if (forced != NULL && forced[0] != '\0')
+    {
+        int v = variant_index(backend, forced);
+        if (v < 0 || backend->set_spmv_variant(backend->state, v) != EXIT_SUCCESS)
+        {
+            if (rank == 0) printf("[ERROR]: spmv_tune.c: SpMV kernel %s unavailable on the %s backend\n",
+                    forced, backend->name);
+            return 0;
+        }
+        return v;
+    }
+
+    // Small matrices, as in a batch, keep the kernel of the last one without timing or cache
+    long long rows = backend->n;
+    MPI_Allreduce(MPI_IN_PLACE, &rows, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rows < SPMV_TUNE_MIN_ROWS)
+    {
+        int kept = (previous >= 0 && previous < backend->num_variants
+                && backend->set_spmv_variant(backend->state, previous) == EXIT_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &kept, 1, MPI_INT, MPI_MIN, comm);
+        const int v = kept ? previous : 0;
+        if (!kept) backend->set_spmv_variant(backend->state, v);
+        if (verbose) printf("SpMV kernel: %s (small matrix, not timed)\n", backend->variant_names[v]);
+        return v;
+    }
+
+    // A rank whose cached kernel does not suit its rows times them all with the others
+    const int cached  = cache_lookup(backend, backend->fingerprint);
+    const int missing = (cached < 0 || backend->set_spmv_variant(backend->state, cached) != EXIT_SUCCESS);
+    int       anyMissing = missing;
+    MPI_Allreduce(MPI_IN_PLACE, &anyMissing, 1, MPI_INT, MPI_MAX, comm);
+    if (!anyMissing)
+    {
+        if (verbose) printf("SpMV kernel: %s (cached)\n", backend->variant_names[cached]);
+        return cached;
+    }
+
+    void   *block = backend->create_block(backend->state, backend->n, 2);
+    real_t *ones  = malloc((backend->n > 0 ? backend->n : 1) * sizeof(real_t));
+    for (int i = 0; i < backend->n; ++i)
+    {
+        ones[i] = 1.0;
+    }
+    backendVec x = {block, 0}, y = {block, 1};
+    backend->write_vector(backend->state, x, ones);
+    free(ones);
+
+    int    best     = 0;
+    double bestTime = DBL_MAX;
+    for (int v = 0; v < backend->num_variants; ++v)
+    {
+        // Every rank must run the same kernels for the exchanges to match
+        int available = (backend->set_spmv_variant(backend->state, v) == EXIT_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_MIN, comm);
+        if (!available)
+        {
+            if (verbose) printf("SpMV kernel %-12s unavailable\n", backend->variant_names[v]);
+            continue;
+        }
+        double elapsed = time_spmv(backend, x, y, comm);
+        if (verbose) printf("SpMV kernel %-12s %10.3f us\n", backend->variant_names[v], 1e6 * elapsed);
+        if (elapsed < bestTime)
+        {
+            bestTime = elapsed;
+            best     = v;
+        }
+    }
+    backend->free_block(backend->state, block);
+
+    backend->set_spmv_variant(backend->state, best);
+    if (verbose) printf("SpMV kernel: %s\n", backend->variant_names[best]);
+    cache_store(backend, best, missing, comm);
+    return best;
+}
+
+double stream_bandwidth(
+        solverBackend *backend,
+        MPI_Comm      comm)
+{
+    void   *block  = backend->create_block(backend->state, STREAM_LENGTH, 2);
+    void   *alpha  = backend->create_block(backend->state, 1, 1);
+    real_t *values = malloc(STREAM_LENGTH * sizeof(real_t));
+    for (int i = 0; i < STREAM_LENGTH; ++i)
+    {
+        values[i] = 1.0;
+    }
+    backendVec    x = {block, 0}, y = {block, 1};
+    backendScalar a = {alpha, 0, 0};
+    backend->write_vector(backend->state, x, values);
+    backend->write_vector(backend->state, (backendVec) {alpha, 0}, values);
+    free(values);
+
+    backend->axpy(backend->state, a, 1.0, x, y);
+    backend->finish(backend->state);
+    MPI_Barrier(comm);
+    double start = MPI_Wtime();
+    for (int r = 0; r < STREAM_REPS; ++r)
+    {
+        backend->axpy(backend->state, a, 1.0, x, y);
+    }
+    backend->finish(backend->state);
+    double elapsed = MPI_Wtime() - start;
+
+    backend->free_block(backend->state, alpha);
+    backend->free_block(backend->state, block);
+    return 3.0 * STREAM_LENGTH * sizeof(real_t) * STREAM_REPS / elapsed * 1e-9;
+}
@@ -0,0 +1,90 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file stencil.c
+ * \brief Matrix-free operators: constant coefficient stencils on structured grids
+ *
+ */
+
+#include "stencil.h"
+
+const char *const stencil_variant_names[1] = {"stencil"};
+
+int stencil_from_string(
+        const char      *spec,
+        stencilOperator *op)
+{
+    int commas = 0;
+    for (const char *c = spec; *c != '\0'; ++c)
+    {
+        commas += (*c == ',');
+    }
+    char tail;
+    int  read;
+    if (commas == 2)
+    {
+        read = sscanf(spec, "%d,%d,%d%c", &op->nx, &op->ny, &op->nz, &tail);
+    }
+    else if (commas == 6)
+    {
+        read = sscanf(spec, "%d,%d,%d,%lf,%lf,%lf,%lf%c", &op->nx, &op->ny, &op->nz,
+                &op->center, &op->coeffs[0], &op->coeffs[1], &op->coeffs[2], &tail);
+    }
+    else
+    {
+        return EXIT_FAILURE;
+    }
+    if (read != commas + 1 || op->nx < 1 || op->ny < 1 || op->nz < 1
+            || (long long) op->nx * op->ny * op->nz > INT_MAX / 7)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (commas == 2)
+    {
+        const int n[3] = {op->nx, op->ny, op->nz};
+        op->center = 0.0;
+        for (int d = 0; d < 3; ++d)
+        {
+            op->coeffs[d] = (n[d] > 1) ? -1.0 : 0.0;
+            op->center   += (n[d] > 1) ? 2.0 : 0.0;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+void stencil_matrix(
+        const stencilOperator *op,
+        csrMatrix             *mat)
+{
+    memset(mat, 0, sizeof(*mat));
+    mat->nRow    = op->nx * op->ny * op->nz;
+    mat->nCol    = mat->nRow;
+    // Each pair of neighbours along an axis gives two entries
+    mat->nNz     = mat->nRow + 2 * ((op->nx - 1) * op->ny * op->nz
+                                  + op->nx * (op->ny - 1) * op->nz
+                                  + op->nx * op->ny * (op->nz - 1));
+    mat->stencil = op;
+}
+
+void stencil_apply(
+        const stencilOperator *op,
+        int                   first,
+        int                   count,
+        const double          *x,
+        double                *y)
+{
+    const int plane = op->nx * op->ny;
+    #pragma omp parallel for schedule(static)
+    for (int r = first; r < first + count; ++r)
+    {
+        const int i = r % op->nx, j = (r / op->nx) % op->ny, k = r / plane;
+        double s = op->center * x[r];
+        if (i > 0)          s += op->coeffs[0] * x[r - 1];
+        if (i < op->nx - 1) s += op->coeffs[0] * x[r + 1];
+        if (j > 0)          s += op->coeffs[1] * x[r - op->nx];
+        if (j < op->ny - 1) s += op->coeffs[1] * x[r + op->nx];
+        if (k > 0)          s += op->coeffs[2] * x[r - plane];
+        if (k < op->nz - 1) s += op->coeffs[2] * x[r + plane];
+        y[r - first] = s;
+    }
+}
@@ -0,0 +1,469 @@
+/**
+ * \author Daumen Anton and Nicolas Derumigny
+ * \file timing.c
+ * \brief Wall clock and device time of the phases of a run, written as JSON
+ *
+ */
+
+#include "timing.h"
+
+/// \brief Deepest nesting of the phases
+#define TIMING_DEPTH 8
+/// \brief Most events kept in the trace, the later ones are dropped
+#define TRACE_MAX_EVENTS (1 << 21)
+
+/// \brief Names of the phases in the JSON report
+static const char *const phase_names[TIMING_PHASES] = {
+    "parse", "partition", "upload", "tune", "arnoldi_spmv", "arnoldi_ortho",
+    "iteration", "recovery", "residual", "refine", "reduction"
+};
+
+/// \brief Accumulated times of one phase
+typedef struct timingAccount{
+    double    wall;
+    double    kernel;
+    long long kernels;
+    long long calls;
+    /// Least traffic and floating point operations of the work done, see \a timing_add_work()
+    double    bytes;
+    double    flops;
+    /// Time spent in the blocking MPI calls, see \a timing_add_mpi()
+    double    mpi;
+    long long mpiCalls;
+}timingAccount;
+
+/// \brief Event of the trace
+typedef struct traceEvent{
+    char   name[TRACE_NAME_LENGTH];
+    int    track;
+    /// On the device clock for the kernels, see \a timing_trace_clock()
+    double start;
+    double end;
+}traceEvent;
+
+/// \brief Names of the rows of the trace, then of the queues
+static const char *const track_names[TRACE_DEVICE] = {"phases", "MPI", "host waits"};
+
+static timingAccount accounts[TIMING_PHASES];
+static int           enabled = 0;
+/// Phases in progress and the time the top one was (re)started
+static int           stack[TIMING_DEPTH];
+static double        started[TIMING_DEPTH];
+static int           depth = 0;
+static double        resumed;
+/// Bandwidth measured by \a timing_set_peak(), 0 if none
+static double        peak = 0.0;
+/// Events of the trace, on the host clock from \a origin
+static int           tracing = 0;
+static double        origin;
+static traceEvent    *events   = NULL;
+static int           nEvents   = 0;
+static int           maxEvents = 0;
+static long long     dropped   = 0;
+/// Host minus device clock of the kernel rows, see \a timing_trace_clock()
+static double        clockOffset[TRACE_TRACKS];
+static int           clockKnown[TRACE_TRACKS];
+
+void timing_enable()
+{
+    enabled = 1;
+}
+
+int timing_enabled()
+{
+    return enabled;
+}
+
+void timing_trace_enable()
+{
+    enabled = 1;
+    tracing = 1;
+    origin  = MPI_Wtime();
+}
+
+int timing_tracing()
+{
+    return tracing;
+}
+
+/**
+ * \brief Keep the event \a name of \a track, the times on the clock of the row
+ */
+static void keep_event(
+        const char *name,
+        int        track,
+        double     start,
+        double     end)
+{
+    if (nEvents == maxEvents)
+    {
+        int grown = (maxEvents > 0) ? 2 * maxEvents : 4096;
+        if (grown > TRACE_MAX_EVENTS) grown = TRACE_MAX_EVENTS;
+        traceEvent *more = (grown > maxEvents) ? realloc(events, grown * sizeof(traceEvent)) : NULL;
+        if (more == NULL)
+        {
+            dropped++;
+            return;
+        }
+        events    = more;
+        maxEvents = grown;
+    }
+    traceEvent *e = events + nEvents++;
+    strncpy(e->name, name, TRACE_NAME_LENGTH - 1);
+    e->name[TRACE_NAME_LENGTH - 1] = '\0';
+    e->track = track;
+    e->start = start;
+    e->end   = end;
+}
+
+void timing_trace(
+        const char   *name,
+        traceTrack_t track,
+        double       start,
+        double       end)
+{
+    if (tracing)
+    {
+        keep_event(name, track, start, end);
+    }
+}
+
+void timing_trace_device(
+        const char   *name,
+        traceTrack_t track,
+        double       start,
+        double       end)
+{
+    if (tracing && track >= TRACE_DEVICE && track < TRACE_TRACKS)
+    {
+        keep_event(name, track, start, end);
+    }
+}
+
+void timing_trace_clock(
+        traceTrack_t track,
+        double       offset)
+{
+    if (track < TRACE_TRACKS && (!clockKnown[track] || offset < clockOffset[track]))
+    {
+        clockOffset[track] = offset;
+        clockKnown[track]  = 1;
+    }
+}
+
+void timing_begin(
+        timingPhase_t phase)
+{
+    double now = MPI_Wtime();
+    if (depth > 0)
+    {
+        accounts[stack[depth - 1]].wall += now - resumed;
+    }
+    if (depth < TIMING_DEPTH)
+    {
+        started[depth] = now;
+        stack[depth++] = phase;
+    }
+    accounts[phase].calls++;
+    resumed = now;
+}
+
+void timing_end(
+        timingPhase_t phase)
+{
+    double now = MPI_Wtime();
+    if (depth == 0 || stack[depth - 1] != (int) phase)
+    {
+        fprintf(stderr, "[ERROR]: timing.c: phase %s ended while not the last one started\n", phase_names[phase]);
+        return;
+    }
+    accounts[phase].wall += now - resumed;
+    timing_trace(phase_names[phase], TRACE_PHASES, started[depth - 1], now);
+    depth--;
+    resumed = now;
+}
+
+int timing_current()
+{
+    return (depth > 0) ? stack[depth - 1] : -1;
+}
+
+void timing_add_kernel(
+        int    phase,
+        double seconds)
+{
+    if (phase < 0 || phase >= TIMING_PHASES)
+    {
+        return;
+    }
+    accounts[phase].kernel += seconds;
+    accounts[phase].kernels++;
+}
+
+void timing_add_work(
+        double bytes,
+        double flops)
+{
+    if (depth > 0)
+    {
+        accounts[stack[depth - 1]].bytes += bytes;
+        accounts[stack[depth - 1]].flops += flops;
+    }
+}
+
+void timing_add_mpi(
+        const char *name,
+        double     start,
+        double     end)
+{
+    if (depth > 0)
+    {
+        accounts[stack[depth - 1]].mpi += end - start;
+        accounts[stack[depth - 1]].mpiCalls++;
+    }
+    if (name != NULL)
+    {
+        timing_trace(name, TRACE_MPI, start, end);
+    }
+}
+
+void timing_set_peak(
+        double gbs)
+{
+    peak = gbs;
+}
+
+double timing_peak()
+{
+    return peak;
+}
+
+/**
+ * \brief Time of the work of \a a: its kernels if they were profiled, its wall time else
+ */
+static double work_time(
+        const timingAccount *a)
+{
+    return (a->kernels > 0) ? a->kernel : a->wall;
+}
+
+void timing_print_roofline(
+        FILE *f)
+{
+    fprintf(f, "Roofline, peak bandwidth %.2f GB/s:\n", peak);
+    fprintf(f, "  %-14s %10s %10s %10s %10s %10s\n", "phase", "time (s)", "GB/s", "GFLOP/s", "flop/byte", "% peak");
+    for (int p = 0; p < TIMING_PHASES; ++p)
+    {
+        const timingAccount *a = accounts + p;
+        const double t = work_time(a);
+        if (a->bytes <= 0.0 || t <= 0.0)
+        {
+            continue;
+        }
+        const double gbs = a->bytes / t * 1e-9;
+        fprintf(f, "  %-14s %10.4f %10.2f %10.2f %10.3f %9.1f%%\n", phase_names[p], t, gbs,
+                a->flops / t * 1e-9, a->flops / a->bytes, (peak > 0.0) ? 100.0 * gbs / peak : 0.0);
+    }
+}
+
+void timing_print_imbalance(
+        FILE     *f,
+        MPI_Comm comm)
+{
+    int my_rank;   MPI_Comm_rank(comm, &my_rank);
+    int num_ranks; MPI_Comm_size(comm, &num_ranks);
+
+    // The phases then the whole run, as wall, MPI and compute time: the reductions below are outside any phase
+    double local[3 * (TIMING_PHASES + 1)] = {0.0};
+    for (int p = 0; p < TIMING_PHASES; ++p)
+    {
+        local[3 * p]                  = accounts[p].wall;
+        local[3 * p + 1]              = accounts[p].mpi;
+        local[3 * p + 2]              = accounts[p].wall - accounts[p].mpi;
+        local[3 * TIMING_PHASES]     += accounts[p].wall;
+        local[3 * TIMING_PHASES + 1] += accounts[p].mpi;
+        local[3 * TIMING_PHASES + 2] += accounts[p].wall - accounts[p].mpi;
+    }
+    const int n = 3 * (TIMING_PHASES + 1);
+    double    mins[n], maxs[n], sums[n];
+    struct { double time; int rank; } slow[n], slowest[n];
+    for (int i = 0; i < n; ++i)
+    {
+        slow[i].time = local[i];
+        slow[i].rank = my_rank;
+    }
+    MPI_Reduce(local, mins, n, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local, maxs, n, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(local, sums, n, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(slow, slowest, n, MPI_DOUBLE_INT, MPI_MAXLOC, 0, comm);
+    if (my_rank != 0)
+    {
+        return;
+    }
+
+    fprintf(f, "Load imbalance over %d ranks, wall time in seconds, MPI the time in blocking calls:\n", num_ranks);
+    fprintf(f, "  %-14s %10s %10s %10s %8s %7s %10s %10s\n",
+            "phase", "min", "mean", "max", "imbal.", "slowest", "MPI mean", "MPI max");
+    for (int p = 0; p <= TIMING_PHASES; ++p)
+    {
+        const int    i    = 3 * p;
+        const double mean = sums[i] / num_ranks;
+        if (maxs[i] <= 0.0)
+        {
+            continue;
+        }
+        // Percent imbalance: how much longer the slowest rank took than the average one
+        fprintf(f, "  %-14s %10.4f %10.4f %10.4f %7.1f%% %7d %10.4f %10.4f\n",
+                (p < TIMING_PHASES) ? phase_names[p] : "total", mins[i], mean, maxs[i],
+                100.0 * (maxs[i] / mean - 1.0), slowest[i].rank, sums[i + 1] / num_ranks, maxs[i + 1]);
+    }
+    // The ranks waiting in MPI hide the slow one in the wall times, not in the compute times
+    const int    c    = 3 * TIMING_PHASES + 2;
+    const double mean = sums[c] / num_ranks;
+    if (mean > 0.0)
+    {
+        fprintf(f, "  Compute time outside MPI: min %.4f, mean %.4f, max %.4f on rank %d, %.1f%% above the mean\n",
+                mins[c], mean, maxs[c], slowest[c].rank, 100.0 * (maxs[c] / mean - 1.0));
+    }
+}
+
+double timing_wall(
+        timingPhase_t phase)
+{
+    return accounts[phase].wall;
+}
+
+long long timing_calls(
+        timingPhase_t phase)
+{
+    return accounts[phase].calls;
+}
+
+void timing_reset()
+{
+    memset(accounts, 0, sizeof(accounts));
+    depth   = 0;
+    nEvents = 0;
+    dropped = 0;
+}
+
+/**
+ * \brief Write \a s as a JSON string
+ */
+static void write_string(
+        FILE       *f,
+        const char *s)
+{
+    fputc('"', f);
+    for (; s != NULL && *s != '\0'; ++s)
+    {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char) *s < 0x20) fprintf(f, "\\u%04x", *s);
+        else                           fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+int timing_write_trace(
+        const char *path,
+        int        rank)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "[ERROR]: timing.c: could not write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (dropped > 0)
+    {
+        fprintf(stderr, "[ERROR]: timing.c: %lld events past the first %d were not traced\n", dropped, nEvents);
+    }
+
+    // Name the process and the rows in use, the queues without a known clock are left out
+    int used[TRACE_TRACKS] = {0};
+    for (int i = 0; i < nEvents; ++i)
+    {
+        used[events[i].track] = 1;
+    }
+    fprintf(f, "{\"traceEvents\": [\n  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+            "\"args\": {\"name\": \"rank %d\"}}", rank, rank);
+    for (int t = 0; t < TRACE_TRACKS; ++t)
+    {
+        if (!used[t] || (t >= TRACE_DEVICE && !clockKnown[t]))
+        {
+            continue;
+        }
+        fprintf(f, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": ",
+                rank, t);
+        if (t < TRACE_DEVICE) fprintf(f, "\"%s\"}}", track_names[t]);
+        else                  fprintf(f, "\"device queue %d\"}}", t - TRACE_DEVICE);
+    }
+
+    for (int i = 0; i < nEvents; ++i)
+    {
+        const traceEvent *e = events + i;
+        double shift = -origin;
+        if (e->track >= TRACE_DEVICE)
+        {
+            if (!clockKnown[e->track]) continue;
+            shift += clockOffset[e->track];
+        }
+        fprintf(f, ",\n  {\"name\": ");
+        write_string(f, e->name);
+        fprintf(f, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                (e->track >= TRACE_DEVICE) ? "kernel" : (e->track == TRACE_PHASES) ? "phase"
+                : (e->track == TRACE_MPI) ? "mpi" : "wait",
+                rank, e->track, 1e6 * (e->start + shift), 1e6 * (e->end - e->start));
+    }
+    fprintf(f, "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped_events\": %lld}}\n", dropped);
+    fclose(f);
+    return EXIT_SUCCESS;
+}
+
+int timing_write_json(
+        const char      *path,
+        const timingRun *run)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "[ERROR]: timing.c: could not write %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    double total = 0.0, totalMpi = 0.0;
+    for (int p = 0; p < TIMING_PHASES; ++p)
+    {
+        total    += accounts[p].wall;
+        totalMpi += accounts[p].mpi;
+    }
+
+    fprintf(f, "{\n  \"rank\": %d,\n  \"num_ranks\": %d,\n  \"matrix\": ", run->rank, run->num_ranks);
+    write_string(f, run->matrix);
+    fprintf(f, ",\n  \"rows\": %d,\n  \"nonzeros\": %d,\n  \"num\": %d,\n  \"kryl\": %d,\n  \"backend\": ",
+            run->nRow, run->nNz, run->num, run->kryl);
+    write_string(f, run->backend);
+    fprintf(f, ",\n  \"precision\": ");
+    write_string(f, run->precision);
+    // A dropped start has an infinite error, which JSON cannot hold
+    if (isfinite(run->error)) fprintf(f, ",\n  \"error\": %.17g", run->error);
+    else                      fprintf(f, ",\n  \"error\": null");
+    if (peak > 0.0) fprintf(f, ",\n  \"peak_gbs\": %.6g", peak);
+    else            fprintf(f, ",\n  \"peak_gbs\": null");
+    fprintf(f, ",\n  \"total_s\": %.9f,\n  \"mpi_s\": %.9f,\n  \"phases\": {\n", total, totalMpi);
+    for (int p = 0; p < TIMING_PHASES; ++p)
+    {
+        const timingAccount *a = accounts + p;
+        double overhead = a->wall - a->kernel;
+        double t        = work_time(a);
+        fprintf(f, "    \"%s\": {\"calls\": %lld, \"wall_s\": %.9f, \"kernel_s\": %.9f, \"kernels\": %lld, "
+                "\"overhead_s\": %.9f, \"bytes\": %.6g, \"flops\": %.6g, \"gbs\": %.6g, \"gflops\": %.6g, "
+                "\"mpi_s\": %.9f, \"mpi_calls\": %lld}%s\n",
+                phase_names[p], a->calls, a->wall, a->kernel, a->kernels, (overhead > 0.0) ? overhead : 0.0,
+                a->bytes, a->flops, (t > 0.0) ? a->bytes / t * 1e-9 : 0.0, (t > 0.0) ? a->flops / t * 1e-9 : 0.0,
+                a->mpi, a->mpiCalls, (p + 1 < TIMING_PHASES) ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+    return EXIT_SUCCESS;
+}